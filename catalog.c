@@ -0,0 +1,1242 @@
+/* Mapping the catalog in rather than reading it lets queries over millions
+ * of rows touch only the columns they look at */
+#if defined(__unix__) || defined(__APPLE__)
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+#define CATALOG_MMAP
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef CATALOG_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "portegg.h"
+#include "catalog.h"
+
+#define CATALOG_HEADER_LEN 24
+#define CATALOG_DIR_LEN    40
+
+#define CATALOG_ALIGN(len) (((len) + 7) & ~((uint64_t) 7))
+#define CATALOG_BIT(column) ((uint32_t) 1 << (column))
+
+static const struct
+{
+	const char *name;
+	enum catalogType type;
+} catalog_columns[CATALOG_NUM_COLUMNS] =
+{
+	{"path",     CATALOG_TEXT},
+	{"prompt",   CATALOG_TEXT},
+	{"negative", CATALOG_TEXT},
+	{"steps",    CATALOG_U32},
+	{"cfg",      CATALOG_F32},
+	{"seed",     CATALOG_U64},
+	{"width",    CATALOG_U32},
+	{"height",   CATALOG_U32},
+	{"sampler",  CATALOG_DICT},
+	{"model",    CATALOG_DICT},
+	{"rng",      CATALOG_DICT},
+	{"present",  CATALOG_U32}
+};
+
+/* Text parameter labels and the column each one fills, the numeric ones
+ * are decoded by paramDecode */
+static const struct
+{
+	const char *label;
+	enum catalogColumnId column;
+} catalog_labels[] =
+{
+	{"parameters",      CATALOG_PROMPT},
+	{"Negative prompt", CATALOG_NEGATIVE},
+	{"Sampler",         CATALOG_SAMPLER},
+	{"Model",           CATALOG_MODEL},
+	{"RNG",             CATALOG_RNG}
+};
+
+/* Column each decoded field is stored in */
+static const enum catalogColumnId catalog_fields[PARAM_NUM_FIELDS] =
+{
+	CATALOG_STEPS,
+	CATALOG_CFG,
+	CATALOG_SEED,
+	CATALOG_WIDTH,
+	CATALOG_HEIGHT
+};
+
+#define CATALOG_NUM_LABELS (sizeof(catalog_labels) / sizeof(catalog_labels[0]))
+
+enum catalogOp
+{
+	OP_EQ = 0,
+	OP_NE,
+	OP_LT,
+	OP_LE,
+	OP_GT,
+	OP_GE,
+	OP_HAS /* Substring match, text and dictionary columns only */
+};
+
+struct catalogFilter
+{
+	enum catalogColumnId column;
+	enum catalogOp op;
+	const char *value;
+	size_t value_len;
+	uint64_t integer;
+	float number;
+};
+
+void catalogRecordInit(struct catalogRecord *record, const char *path)
+{
+	memset(record, 0, sizeof(struct catalogRecord));
+
+	if (path != NULL)
+	{
+		record->strings[CATALOG_PATH].str = path;
+		record->strings[CATALOG_PATH].len = strlen(path);
+		record->present |= CATALOG_BIT(CATALOG_PATH);
+	}
+}
+
+/* Stores a labelled value if it's one the catalog keeps, returns 1 if the
+ * value couldn't be parsed, unknown labels are quietly ignored */
+int catalogRecordField(struct catalogRecord *record, const char *label,
+	const char *value, size_t len)
+{
+	size_t i;
+
+	for (i = 0; (i < CATALOG_NUM_LABELS)
+	&& (strcmp(catalog_labels[i].label, label) != 0); i++);
+
+	if (i == CATALOG_NUM_LABELS)
+	{
+		return paramDecode(&record->values, label, value, len);
+	}
+
+	value = paramTrim(value, &len);
+	record->strings[catalog_labels[i].column].str = value;
+	record->strings[catalog_labels[i].column].len = len;
+	record->present |= CATALOG_BIT(catalog_labels[i].column);
+
+	return 0;
+}
+
+void catalogWriterInit(struct catalogWriter *writer, struct internPool *pool)
+{
+	memset(writer, 0, sizeof(struct catalogWriter));
+	writer->pool = pool;
+}
+
+/* Columns are kept in host byte order until they're saved, text is kept
+ * only as ids into the pool so repeated values cost four bytes a row */
+int catalogWriterAdd(struct catalogWriter *writer,
+	const struct catalogRecord *record)
+{
+	const struct paramValues *values = NULL;
+	uint32_t present;
+	size_t i;
+
+	if ((writer == NULL) || (writer->pool == NULL) || (record == NULL))
+	{
+		return 1;
+	}
+
+	values  = &record->values;
+	present = record->present;
+
+	for (i = 0; i < PARAM_NUM_FIELDS; i++)
+	{
+		if ((values->present & PARAM_BIT(i)) != 0)
+		{
+			present |= CATALOG_BIT(catalog_fields[i]);
+		}
+	}
+
+	for (i = 0; i < CATALOG_NUM_COLUMNS; i++)
+	{
+		struct outputBuffer *column = &writer->columns[i];
+		const struct catalogString *str = &record->strings[i];
+		uint32_t u32 = 0;
+		uint64_t u64 = 0;
+
+		switch (i)
+		{
+			case CATALOG_STEPS:
+				u32 = values->steps;
+				break;
+			case CATALOG_WIDTH:
+				u32 = values->width;
+				break;
+			case CATALOG_HEIGHT:
+				u32 = values->height;
+				break;
+			case CATALOG_PRESENT:
+				u32 = present;
+				break;
+			case CATALOG_CFG:
+				memcpy(&u32, &values->cfg, sizeof(uint32_t));
+				break;
+			case CATALOG_SEED:
+				u64 = values->seed;
+				break;
+			default:
+				break;
+		}
+
+		switch (catalog_columns[i].type)
+		{
+			case CATALOG_TEXT: /* fallthrough */
+			case CATALOG_DICT:
+				if (internString(writer->pool,
+					(str->str == NULL) ? "" : str->str,
+					str->len, &u32) != 0)
+				{
+					return 1;
+				}
+				/* fallthrough */
+			case CATALOG_U32: /* fallthrough */
+			case CATALOG_F32:
+				outputAppend(column, (const char *) &u32,
+					sizeof(uint32_t));
+				break;
+			case CATALOG_U64: /* fallthrough */
+			default:
+				outputAppend(column, (const char *) &u64,
+					sizeof(uint64_t));
+				break;
+		}
+
+		if (column->error != 0)
+		{
+			return 1;
+		}
+	}
+
+	writer->num_rows++;
+
+	return 0;
+}
+
+static int catalogWriteU32(FILE *fhandle, uint32_t val)
+{
+	porteggSysToLeCopy(uint32_t, val, val);
+
+	return (fwrite(&val, sizeof(uint32_t), 1, fhandle) != 1);
+}
+
+static int catalogWriteU64(FILE *fhandle, uint64_t val)
+{
+	porteggSysToLeCopy(uint64_t, val, val);
+
+	return (fwrite(&val, sizeof(uint64_t), 1, fhandle) != 1);
+}
+
+/* Host order values written out little endian, as is on most machines */
+static int catalogWriteArray(FILE *fhandle, const char *data,
+	const size_t len, const size_t width)
+{
+	size_t i;
+
+	if (porteggIsLittle() == PORTEGG_TRUE)
+	{
+		return (fwrite(data, sizeof(char), len, fhandle) != len);
+	}
+
+	for (i = 0; i + width <= len; i += width)
+	{
+		char tmp[sizeof(uint64_t)];
+
+		memcpy(tmp, data + i, width);
+		PORTEGG_SYS_TO_LE_RAW(width, tmp);
+
+		if (fwrite(tmp, sizeof(char), width, fhandle) != width)
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int catalogWritePad(FILE *fhandle, const uint64_t len)
+{
+	const char zeros[8] = {0};
+	const size_t pad = (size_t) (CATALOG_ALIGN(len) - len);
+
+	return (fwrite(zeros, sizeof(char), pad, fhandle) != pad);
+}
+
+/* Pool ids are batch wide, each dictionary column is renumbered to just
+ * the values it uses, in the order they first turn up */
+static int catalogPlanColumn(const struct catalogWriter *writer,
+	const size_t column, struct catalogPlan *plan)
+{
+	const uint32_t *ids = (const uint32_t *) writer->columns[column].data;
+	const struct internPool *pool = writer->pool;
+	uint64_t i;
+	size_t len;
+
+	memset(plan, 0, sizeof(struct catalogPlan));
+
+	if (catalog_columns[column].type == CATALOG_TEXT)
+	{
+		for (i = 0; i < writer->num_rows; i++)
+		{
+			internGet(pool, ids[i], &len);
+			plan->blob_len += len;
+		}
+
+		return 0;
+	}
+
+	if (catalog_columns[column].type != CATALOG_DICT)
+	{
+		return 0;
+	}
+
+	if (((plan->local = malloc(sizeof(uint32_t) * (pool->len + 1))) 
+		== NULL)
+	|| ((plan->order = malloc(sizeof(uint32_t) * (pool->len + 1)))
+		== NULL))
+	{
+		free(plan->local);
+
+		return 1;
+	}
+
+	memset(plan->local, 0xFF, sizeof(uint32_t) * pool->len);
+
+	for (i = 0; i < writer->num_rows; i++)
+	{
+		if (plan->local[ids[i]] == INTERN_NONE)
+		{
+			plan->local[ids[i]] = plan->dict_len;
+			plan->order[plan->dict_len++] = ids[i];
+			internGet(pool, ids[i], &len);
+			plan->blob_len += len;
+		}
+	}
+
+	return 0;
+}
+
+static uint64_t catalogSectionLen(const struct catalogWriter *writer,
+	const size_t column, const struct catalogPlan *plan)
+{
+	switch (catalog_columns[column].type)
+	{
+		case CATALOG_TEXT:
+			return (writer->num_rows + 1) * sizeof(uint64_t)
+				+ plan->blob_len;
+		case CATALOG_DICT:
+			return CATALOG_ALIGN(writer->num_rows * sizeof(uint32_t))
+				+ ((uint64_t) plan->dict_len + 1)
+				* sizeof(uint64_t) + plan->blob_len;
+		case CATALOG_U64:
+			return writer->num_rows * sizeof(uint64_t);
+		case CATALOG_U32: /* fallthrough */
+		case CATALOG_F32: /* fallthrough */
+		default:
+			return writer->num_rows * sizeof(uint32_t);
+	}
+}
+
+/* Offsets and then the bytes of a list of pool ids */
+static int catalogWriteStrings(FILE *fhandle, const struct internPool *pool,
+	const uint32_t *ids, const uint64_t count)
+{
+	uint64_t i, end = 0;
+	int ret = catalogWriteU64(fhandle, 0);
+	size_t len;
+
+	for (i = 0; i < count; i++)
+	{
+		internGet(pool, ids[i], &len);
+		end += len;
+		ret |= catalogWriteU64(fhandle, end);
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		const char *str = internGet(pool, ids[i], &len);
+
+		ret |= (fwrite(str, sizeof(char), len, fhandle) != len);
+	}
+
+	return ret;
+}
+
+static int catalogWriteSection(FILE *fhandle,
+	const struct catalogWriter *writer, const size_t column,
+	const struct catalogPlan *plan)
+{
+	const struct outputBuffer *values = &writer->columns[column];
+	const uint32_t *ids = (const uint32_t *) values->data;
+	uint64_t i;
+	int ret = 0;
+
+	switch (catalog_columns[column].type)
+	{
+		case CATALOG_TEXT:
+			ret |= catalogWriteStrings(fhandle, writer->pool, ids,
+				writer->num_rows);
+			break;
+		case CATALOG_DICT:
+			for (i = 0; i < writer->num_rows; i++)
+			{
+				ret |= catalogWriteU32(fhandle, 
+					plan->local[ids[i]]);
+			}
+
+			ret |= catalogWritePad(fhandle, values->len);
+			ret |= catalogWriteStrings(fhandle, writer->pool,
+				plan->order, plan->dict_len);
+			break;
+		case CATALOG_U64:
+			ret |= catalogWriteArray(fhandle, values->data,
+				values->len, sizeof(uint64_t));
+			break;
+		case CATALOG_U32: /* fallthrough */
+		case CATALOG_F32: /* fallthrough */
+		default:
+			ret |= catalogWriteArray(fhandle, values->data,
+				values->len, sizeof(uint32_t));
+			break;
+	}
+
+	return ret | catalogWritePad(fhandle,
+		catalogSectionLen(writer, column, plan));
+}
+
+static int catalogWriteFile(FILE *fhandle,
+	const struct catalogWriter *writer, const struct catalogPlan *plans)
+{
+	uint64_t offset = CATALOG_ALIGN(CATALOG_HEADER_LEN
+		+ CATALOG_NUM_COLUMNS * CATALOG_DIR_LEN);
+	size_t i;
+	int ret = 0;
+
+	ret |= (fwrite(CATALOG_MAGIC, sizeof(char), sizeof(CATALOG_MAGIC),
+		fhandle) != sizeof(CATALOG_MAGIC));
+	ret |= catalogWriteU32(fhandle, CATALOG_VERSION);
+	ret |= catalogWriteU32(fhandle, CATALOG_NUM_COLUMNS);
+	ret |= catalogWriteU64(fhandle, writer->num_rows);
+
+	for (i = 0; i < CATALOG_NUM_COLUMNS; i++)
+	{
+		char name[CATALOG_NAME_MAX] = {0};
+		const uint64_t len = catalogSectionLen(writer, i, &plans[i]);
+
+		strncpy(name, catalog_columns[i].name, CATALOG_NAME_MAX - 1);
+		ret |= (fwrite(name, sizeof(char), CATALOG_NAME_MAX, fhandle)
+			!= CATALOG_NAME_MAX);
+		ret |= catalogWriteU32(fhandle, catalog_columns[i].type);
+		ret |= catalogWriteU32(fhandle, plans[i].dict_len);
+		ret |= catalogWriteU64(fhandle, offset);
+		ret |= catalogWriteU64(fhandle, len);
+		offset += CATALOG_ALIGN(len);
+	}
+
+	ret |= catalogWritePad(fhandle,
+		CATALOG_HEADER_LEN + CATALOG_NUM_COLUMNS * CATALOG_DIR_LEN);
+
+	for (i = 0; i < CATALOG_NUM_COLUMNS; i++)
+	{
+		ret |= catalogWriteSection(fhandle, writer, i, &plans[i]);
+	}
+
+	return ret;
+}
+
+int catalogWriterSave(const struct catalogWriter *writer,
+	const char *file_path)
+{
+	struct catalogPlan plans[CATALOG_NUM_COLUMNS];
+	FILE *fhandle = NULL;
+	size_t i, num_plans;
+	int ret = 0;
+
+	if ((writer == NULL) || (writer->pool == NULL) || (file_path == NULL))
+	{
+		return 1;
+	}
+
+	for (num_plans = 0; (num_plans < CATALOG_NUM_COLUMNS) && (ret == 0);
+		num_plans++)
+	{
+		ret = catalogPlanColumn(writer, num_plans, &plans[num_plans]);
+	}
+
+	if ((ret == 0) && ((fhandle = fopen(file_path, "wb")) == NULL))
+	{
+		fprintf(stderr, "Unable to open %s for writing\n", file_path);
+		ret = 1;
+	}
+	else if (ret == 0)
+	{
+		ret = catalogWriteFile(fhandle, writer, plans);
+		ret |= (fclose(fhandle) != 0);
+
+		if (ret != 0)
+		{
+			fprintf(stderr, "Failed writing catalog %s\n", 
+				file_path);
+		}
+	}
+
+	for (i = 0; i < num_plans; i++)
+	{
+		free(plans[i].local);
+		free(plans[i].order);
+	}
+
+	return ret;
+}
+
+void catalogWriterFree(struct catalogWriter *writer)
+{
+	size_t i;
+
+	if (writer == NULL)
+	{
+		return;
+	}
+
+	for (i = 0; i < CATALOG_NUM_COLUMNS; i++)
+	{
+		outputFree(&writer->columns[i]);
+	}
+
+	writer->num_rows = 0;
+}
+
+static int catalogLoad(struct catalog *cat, const char *file_path)
+{
+	FILE *fhandle = NULL;
+	long int len;
+#ifdef CATALOG_MMAP
+	struct stat info;
+	int fd;
+
+	/* Columns are swapped in place on big endian machines, the private
+	 * mapping keeps that from reaching the file */
+	if ((fd = open(file_path, O_RDONLY)) != -1)
+	{
+		if ((fstat(fd, &info) == 0) && (info.st_size > 0)
+		&& ((cat->data = mmap(NULL, (size_t) info.st_size,
+			(porteggIsLittle() == PORTEGG_TRUE)
+			? PROT_READ : (PROT_READ | PROT_WRITE),
+			MAP_PRIVATE, fd, 0)) != MAP_FAILED))
+		{
+			cat->data_len = (size_t) info.st_size;
+			cat->mapped = 1;
+			posix_madvise(cat->data, cat->data_len,
+				POSIX_MADV_SEQUENTIAL);
+		}
+		else
+		{
+			cat->data = NULL;
+		}
+
+		close(fd);
+
+		if (cat->mapped != 0)
+		{
+			return 0;
+		}
+	}
+#endif
+
+	if ((fhandle = fopen(file_path, "rb")) == NULL)
+	{
+		return 1;
+	}
+
+	if ((fseek(fhandle, 0, SEEK_END) != 0)
+	|| ((len = ftell(fhandle)) <= 0)
+	|| (fseek(fhandle, 0, SEEK_SET) != 0)
+	|| ((cat->data = malloc((size_t) len)) == NULL)
+	|| (fread(cat->data, sizeof(char), (size_t) len, fhandle)
+		!= (size_t) len))
+	{
+		fclose(fhandle);
+
+		return 1;
+	}
+
+	cat->data_len = (size_t) len;
+	fclose(fhandle);
+
+	return 0;
+}
+
+static uint32_t catalogGetU32(const unsigned char *bytes)
+{
+	uint32_t val;
+
+	memcpy(&val, bytes, sizeof(uint32_t));
+	porteggLeToSysCopy(uint32_t, val, val);
+
+	return val;
+}
+
+static uint64_t catalogGetU64(const unsigned char *bytes)
+{
+	uint64_t val;
+
+	memcpy(&val, bytes, sizeof(uint64_t));
+	porteggLeToSysCopy(uint64_t, val, val);
+
+	return val;
+}
+
+static void catalogSwap(const void *data, const uint64_t count,
+	const size_t width)
+{
+	char *bytes = (char *) data;
+	uint64_t i;
+
+	for (i = 0; i < count; i++)
+	{
+		porteggReverseBytes(width, bytes + i * width);
+	}
+}
+
+/* Points a column into the loaded file after checking its section fits */
+static int catalogBindColumn(struct catalog *cat, const size_t column,
+	const unsigned char *entry)
+{
+	struct catalogColumn *col = &cat->columns[column];
+	const uint64_t offset = catalogGetU64(entry + 24);
+	const uint64_t len    = catalogGetU64(entry + 32);
+	const uint64_t rows   = cat->num_rows;
+	const unsigned char *section = cat->data + offset;
+	uint64_t need, ids_len = 0;
+
+	col->type = (enum catalogType) catalogGetU32(entry + 16);
+	col->dict_len = catalogGetU32(entry + 20);
+
+	if ((col->type != catalog_columns[column].type) || (offset % 8 != 0)
+	|| (offset > cat->data_len) || (len > cat->data_len - offset))
+	{
+		return 1;
+	}
+
+	switch (col->type)
+	{
+		case CATALOG_TEXT:
+			need = (rows + 1) * sizeof(uint64_t);
+			break;
+		case CATALOG_DICT:
+			ids_len = CATALOG_ALIGN(rows * sizeof(uint32_t));
+			need = ids_len + ((uint64_t) col->dict_len + 1)
+				* sizeof(uint64_t);
+			break;
+		case CATALOG_U64:
+			need = rows * sizeof(uint64_t);
+			break;
+		case CATALOG_U32: /* fallthrough */
+		case CATALOG_F32: /* fallthrough */
+		default:
+			need = rows * sizeof(uint32_t);
+			break;
+	}
+
+	if (need > len)
+	{
+		return 1;
+	}
+
+	col->values = section;
+
+	if (col->type == CATALOG_TEXT)
+	{
+		col->values  = NULL;
+		col->offsets = (const uint64_t *) section;
+	}
+	else if (col->type == CATALOG_DICT)
+	{
+		col->offsets = (const uint64_t *) (section + ids_len);
+	}
+
+	col->blob     = (const char *) section + need;
+	col->blob_len = len - need;
+
+	if (porteggIsLittle() == PORTEGG_FALSE)
+	{
+		if (col->values != NULL)
+		{
+			catalogSwap(col->values, rows,
+				(col->type == CATALOG_U64)
+				? sizeof(uint64_t) : sizeof(uint32_t));
+		}
+
+		if (col->offsets != NULL)
+		{
+			catalogSwap(col->offsets, (col->type == CATALOG_TEXT)
+				? rows + 1 : (uint64_t) col->dict_len + 1,
+				sizeof(uint64_t));
+		}
+	}
+
+	col->found = 1;
+
+	return 0;
+}
+
+int catalogOpen(struct catalog *cat, const char *file_path)
+{
+	uint32_t num_columns;
+	size_t i, j;
+
+	if ((cat == NULL) || (file_path == NULL))
+	{
+		return 1;
+	}
+
+	memset(cat, 0, sizeof(struct catalog));
+
+	if (catalogLoad(cat, file_path) != 0)
+	{
+		fprintf(stderr, "Unable to read catalog %s\n", file_path);
+
+		return 1;
+	}
+
+	if ((cat->data_len < CATALOG_HEADER_LEN)
+	|| (memcmp(cat->data, CATALOG_MAGIC, sizeof(CATALOG_MAGIC)) != 0)
+	|| (catalogGetU32(cat->data + 8) != CATALOG_VERSION))
+	{
+		fprintf(stderr, "%s is not a catalog this version can read\n",
+			file_path);
+		catalogClose(cat);
+
+		return 1;
+	}
+
+	num_columns   = catalogGetU32(cat->data + 12);
+	cat->num_rows = catalogGetU64(cat->data + 16);
+
+	if ((num_columns > (cat->data_len - CATALOG_HEADER_LEN)
+		/ CATALOG_DIR_LEN)
+	|| (cat->num_rows > cat->data_len / sizeof(uint32_t)))
+	{
+		fprintf(stderr, "Catalog %s is truncated\n", file_path);
+		catalogClose(cat);
+
+		return 1;
+	}
+
+	/* Columns are found by name so ones this version doesn't know of
+	 * are just passed over */
+	for (i = 0; i < num_columns; i++)
+	{
+		const unsigned char *entry = cat->data + CATALOG_HEADER_LEN
+			+ i * CATALOG_DIR_LEN;
+
+		for (j = 0; (j < CATALOG_NUM_COLUMNS)
+		&& (strncmp((const char *) entry, catalog_columns[j].name,
+			CATALOG_NAME_MAX) != 0); j++);
+
+		if ((j == CATALOG_NUM_COLUMNS) || (cat->columns[j].found != 0))
+		{
+			continue;
+		}
+
+		if (catalogBindColumn(cat, j, entry) != 0)
+		{
+			fprintf(stderr, "Catalog %s has a bad %s column\n",
+				file_path, catalog_columns[j].name);
+			catalogClose(cat);
+
+			return 1;
+		}
+	}
+
+	if (cat->columns[CATALOG_PRESENT].found == 0)
+	{
+		fprintf(stderr, "Catalog %s has no present column\n",
+			file_path);
+		catalogClose(cat);
+
+		return 1;
+	}
+
+	return 0;
+}
+
+void catalogClose(struct catalog *cat)
+{
+	if ((cat == NULL) || (cat->data == NULL))
+	{
+		return;
+	}
+
+#ifdef CATALOG_MMAP
+	if (cat->mapped != 0)
+	{
+		munmap(cat->data, cat->data_len);
+	}
+	else
+#endif
+	{
+		free(cat->data);
+	}
+
+	memset(cat, 0, sizeof(struct catalog));
+}
+
+/* The string at index i of a text column or dictionary, NULL if the
+ * offsets are out of bounds */
+static const char* catalogString(const struct catalogColumn *col,
+	const uint64_t i, size_t *len)
+{
+	const uint64_t start = col->offsets[i];
+	const uint64_t end   = col->offsets[i + 1];
+
+	if ((start > end) || (end > col->blob_len))
+	{
+		return NULL;
+	}
+
+	*len = (size_t) (end - start);
+
+	return col->blob + start;
+}
+
+static int catalogContains(const char *hay, const size_t hay_len,
+	const char *needle, const size_t needle_len)
+{
+	size_t i;
+
+	if (needle_len == 0)
+	{
+		return 1;
+	}
+
+	for (i = 0; i + needle_len <= hay_len; i++)
+	{
+		if ((hay[i] == needle[0])
+		&& (memcmp(hay + i, needle, needle_len) == 0))
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int catalogStringMatch(const struct catalogFilter *filter,
+	const char *str, const size_t len)
+{
+	if (str == NULL)
+	{
+		return 0;
+	}
+
+	switch (filter->op)
+	{
+		case OP_EQ:
+			return (len == filter->value_len)
+				&& (memcmp(str, filter->value, len) == 0);
+		case OP_NE:
+			return (len != filter->value_len)
+				|| (memcmp(str, filter->value, len) != 0);
+		case OP_HAS: /* fallthrough */
+		default:
+			return catalogContains(str, len, filter->value,
+				filter->value_len);
+	}
+}
+
+static int catalogParseFilter(const struct catalog *cat, const char *expr,
+	struct catalogFilter *filter)
+{
+	const char *ops[] = {"=", "!=", "<", "<=", ">", ">=", "~"};
+	size_t name_len, op_len, i;
+	enum catalogType type;
+
+	memset(filter, 0, sizeof(struct catalogFilter));
+	name_len = strcspn(expr, "=!<>~");
+
+	for (i = 0; i < CATALOG_PRESENT; i++)
+	{
+		if ((strlen(catalog_columns[i].name) == name_len)
+		&& (strncmp(catalog_columns[i].name, expr, name_len) == 0))
+		{
+			break;
+		}
+	}
+
+	if ((expr[name_len] == '\0') || (i == CATALOG_PRESENT))
+	{
+		fprintf(stderr, "Bad filter \"%s\", expected a column, one of "
+			"= != < <= > >= ~, and a value\n", expr);
+
+		return 1;
+	}
+
+	if (cat->columns[i].found == 0)
+	{
+		fprintf(stderr, "Catalog has no %s column\n",
+			catalog_columns[i].name);
+
+		return 1;
+	}
+
+	filter->column = (enum catalogColumnId) i;
+	type = catalog_columns[i].type;
+	op_len = ((expr[name_len + 1] == '=') && (expr[name_len] != '=')
+		&& (expr[name_len] != '~')) ? 2 : 1;
+
+	for (i = 0; (i < sizeof(ops) / sizeof(ops[0]))
+	&& ((strlen(ops[i]) != op_len)
+	|| (strncmp(ops[i], expr + name_len, op_len) != 0)); i++);
+
+	filter->op = (enum catalogOp) i;
+	filter->value = expr + name_len + op_len;
+	filter->value_len = strlen(filter->value);
+
+	if ((i == sizeof(ops) / sizeof(ops[0]))
+	|| (((type == CATALOG_TEXT) || (type == CATALOG_DICT))
+		&& (filter->op != OP_EQ) && (filter->op != OP_NE)
+		&& (filter->op != OP_HAS))
+	|| ((type != CATALOG_TEXT) && (type != CATALOG_DICT)
+		&& (filter->op == OP_HAS)))
+	{
+		fprintf(stderr, "Bad comparison in filter \"%s\"\n", expr);
+
+		return 1;
+	}
+
+	if ((type == CATALOG_F32)
+		? (paramParseFloat(filter->value, filter->value_len,
+			&filter->number) != 0)
+		: (type == CATALOG_U32) || (type == CATALOG_U64)
+		? (paramParseU64(filter->value, filter->value_len,
+			&filter->integer) != 0)
+		: 0)
+	{
+		fprintf(stderr, "Bad number in filter \"%s\"\n", expr);
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Kept simple enough for the compiler to vectorize */
+#define CATALOG_SCAN(vals, num_rows, op, val, keep)                   \
+do                                                                    \
+{                                                                     \
+	uint64_t scan_i;                                              \
+                                                                      \
+	switch (op)                                                   \
+	{                                                             \
+		case OP_EQ:                                           \
+			for (scan_i = 0; scan_i < (num_rows); scan_i++) \
+				(keep)[scan_i] &= ((vals)[scan_i] == (val)); \
+			break;                                        \
+		case OP_NE:                                           \
+			for (scan_i = 0; scan_i < (num_rows); scan_i++) \
+				(keep)[scan_i] &= ((vals)[scan_i] != (val)); \
+			break;                                        \
+		case OP_LT:                                           \
+			for (scan_i = 0; scan_i < (num_rows); scan_i++) \
+				(keep)[scan_i] &= ((vals)[scan_i] < (val)); \
+			break;                                        \
+		case OP_LE:                                           \
+			for (scan_i = 0; scan_i < (num_rows); scan_i++) \
+				(keep)[scan_i] &= ((vals)[scan_i] <= (val)); \
+			break;                                        \
+		case OP_GT:                                           \
+			for (scan_i = 0; scan_i < (num_rows); scan_i++) \
+				(keep)[scan_i] &= ((vals)[scan_i] > (val)); \
+			break;                                        \
+		case OP_GE:                                           \
+			for (scan_i = 0; scan_i < (num_rows); scan_i++) \
+				(keep)[scan_i] &= ((vals)[scan_i] >= (val)); \
+			break;                                        \
+		case OP_HAS: /* fallthrough */                        \
+		default:                                              \
+			break;                                        \
+	}                                                             \
+} while (0)
+
+static int catalogApplyFilter(const struct catalog *cat,
+	const struct catalogFilter *filter, unsigned char *keep)
+{
+	const struct catalogColumn *col = &cat->columns[filter->column];
+	const uint32_t *present
+		= (const uint32_t *) cat->columns[CATALOG_PRESENT].values;
+	const uint32_t bit = filter->column;
+	const uint64_t rows = cat->num_rows;
+	unsigned char *matches = NULL;
+	uint64_t i;
+	size_t len = 0;
+
+	/* Rows without a value never match */
+	for (i = 0; i < rows; i++)
+	{
+		keep[i] &= (unsigned char) ((present[i] >> bit) & 1);
+	}
+
+	/* A number too big for the column is bigger than all of it rather
+	 * than a truncated version of itself */
+	if ((col->type == CATALOG_U32) && (filter->integer > UINT32_MAX))
+	{
+		if ((filter->op == OP_EQ) || (filter->op == OP_GT)
+		|| (filter->op == OP_GE))
+		{
+			memset(keep, 0, (size_t) rows);
+		}
+
+		return 0;
+	}
+
+	switch (col->type)
+	{
+		case CATALOG_U32:
+			CATALOG_SCAN((const uint32_t *) col->values, rows,
+				filter->op, (uint32_t) filter->integer, keep);
+			break;
+		case CATALOG_U64:
+			CATALOG_SCAN((const uint64_t *) col->values, rows,
+				filter->op, filter->integer, keep);
+			break;
+		case CATALOG_F32:
+			CATALOG_SCAN((const float *) col->values, rows,
+				filter->op, filter->number, keep);
+			break;
+		case CATALOG_TEXT:
+			for (i = 0; i < rows; i++)
+			{
+				const char *str = NULL;
+
+				if (keep[i] != 0)
+				{
+					str = catalogString(col, i, &len);
+					keep[i] = (unsigned char)
+						catalogStringMatch(filter,
+						str, len);
+				}
+			}
+
+			break;
+		case CATALOG_DICT:
+		{
+			const uint32_t *ids = (const uint32_t *) col->values;
+
+			/* Each distinct value is only matched once, after
+			 * that rows are looked up by id */
+			if ((matches = malloc((size_t) col->dict_len + 1))
+				== NULL)
+			{
+				return 1;
+			}
+
+			for (i = 0; i < col->dict_len; i++)
+			{
+				const char *str = catalogString(col, i, &len);
+
+				matches[i] = (unsigned char)
+					catalogStringMatch(filter, str, len);
+			}
+
+			matches[col->dict_len] = 0;
+
+			for (i = 0; i < rows; i++)
+			{
+				keep[i] &= matches[(ids[i] < col->dict_len)
+					? ids[i] : col->dict_len];
+			}
+
+			free(matches);
+			break;
+		}
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+static void catalogPrintNumber(const struct catalog *cat,
+	const enum catalogColumnId column, const unsigned char *keep,
+	FILE *out)
+{
+	const struct catalogColumn *col = &cat->columns[column];
+	const uint32_t *present
+		= (const uint32_t *) cat->columns[CATALOG_PRESENT].values;
+	double min = 0, max = 0, sum = 0;
+	uint64_t i, count = 0;
+
+	if (col->found == 0)
+	{
+		return;
+	}
+
+	for (i = 0; i < cat->num_rows; i++)
+	{
+		double val;
+
+		if ((keep[i] == 0) || (((present[i] >> column) & 1) == 0))
+		{
+			continue;
+		}
+
+		val = (col->type == CATALOG_F32)
+			? ((const float *) col->values)[i]
+			: (col->type == CATALOG_U64)
+			? (double) ((const uint64_t *) col->values)[i]
+			: ((const uint32_t *) col->values)[i];
+		min = ((count == 0) || (val < min)) ? val : min;
+		max = ((count == 0) || (val > max)) ? val : max;
+		sum += val;
+		count++;
+	}
+
+	fprintf(out, "%-8s %llu values", catalog_columns[column].name,
+		(unsigned long long) count);
+
+	if (count != 0)
+	{
+		fprintf(out, ", min %.15g, max %.15g", min, max);
+
+		/* The mean of a set of seeds means nothing */
+		if (column != CATALOG_SEED)
+		{
+			fprintf(out, ", mean %.4g", sum / (double) count);
+		}
+	}
+
+	fputc('\n', out);
+}
+
+static int catalogPrintDict(const struct catalog *cat,
+	const enum catalogColumnId column, const unsigned char *keep,
+	FILE *out)
+{
+	const struct catalogColumn *col = &cat->columns[column];
+	const uint32_t *present
+		= (const uint32_t *) cat->columns[CATALOG_PRESENT].values;
+	const uint32_t *ids = (const uint32_t *) col->values;
+	uint64_t *counts = NULL;
+	uint64_t i;
+	size_t k;
+
+	if (col->found == 0)
+	{
+		return 0;
+	}
+
+	if ((counts = calloc((size_t) col->dict_len + 1, sizeof(uint64_t)))
+		== NULL)
+	{
+		return 1;
+	}
+
+	for (i = 0; i < cat->num_rows; i++)
+	{
+		counts[(ids[i] < col->dict_len) ? ids[i] : col->dict_len]
+			+= keep[i] & ((present[i] >> column) & 1);
+	}
+
+	fprintf(out, "\n%s:\n", catalog_columns[column].name);
+
+	/* Only the top few are wanted so picking them out one at a time
+	 * beats sorting the whole dictionary */
+	for (k = 0; k < CATALOG_TOP_MAX; k++)
+	{
+		uint32_t id, best = 0;
+		const char *str;
+		size_t len;
+
+		for (id = 1; id < col->dict_len; id++)
+		{
+			best = (counts[id] > counts[best]) ? id : best;
+		}
+
+		if ((col->dict_len == 0) || (counts[best] == 0))
+		{
+			break;
+		}
+
+		str = catalogString(col, best, &len);
+		fprintf(out, "%10llu  %.*s\n", (unsigned long long) counts[best],
+			(str == NULL) ? 0 : (int) len, (str == NULL) ? "" : str);
+		counts[best] = 0;
+	}
+
+	free(counts);
+
+	return 0;
+}
+
+/* Filters are column, comparison, value, eg: steps>=20 model~xl, every
+ * filter has to match for a row to be counted */
+int catalogQuery(const struct catalog *cat, const char * const *filters,
+	const size_t num_filters, FILE *out)
+{
+	const enum catalogColumnId numbers[] = {CATALOG_STEPS, CATALOG_CFG,
+		CATALOG_SEED, CATALOG_WIDTH, CATALOG_HEIGHT};
+	const enum catalogColumnId dicts[] = {CATALOG_MODEL,
+		CATALOG_SAMPLER, CATALOG_RNG};
+	struct catalogFilter filter;
+	unsigned char *keep = NULL;
+	uint64_t i, num_kept = 0;
+	int ret = 0;
+
+	if ((cat == NULL) || (out == NULL)
+	|| ((keep = malloc((size_t) cat->num_rows + 1)) == NULL))
+	{
+		return 1;
+	}
+
+	memset(keep, 1, (size_t) cat->num_rows);
+
+	for (i = 0; (i < num_filters) && (ret == 0); i++)
+	{
+		ret = (catalogParseFilter(cat, filters[i], &filter) != 0)
+			|| (catalogApplyFilter(cat, &filter, keep) != 0);
+	}
+
+	if (ret != 0)
+	{
+		free(keep);
+
+		return 1;
+	}
+
+	for (i = 0; i < cat->num_rows; i++)
+	{
+		num_kept += keep[i];
+	}
+
+	fprintf(out, "Rows: %llu of %llu\n\n", (unsigned long long) num_kept,
+		(unsigned long long) cat->num_rows);
+
+	for (i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++)
+	{
+		catalogPrintNumber(cat, numbers[i], keep, out);
+	}
+
+	for (i = 0; (i < sizeof(dicts) / sizeof(dicts[0])) && (ret == 0); i++)
+	{
+		ret = catalogPrintDict(cat, dicts[i], keep, out);
+	}
+
+	free(keep);
+
+	return ret;
+}
@@ -0,0 +1,127 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "outputBuffer.h"
+#include "internPool.h"
+#include "paramValues.h"
+
+/* Columnar catalog of the parameters of many images, so they can be looked
+ * over without going back to the images themselves. All values are little
+ * endian and every section starts on an 8 byte boundary:
+ *
+ *   header     "SDPDCAT\0", u32 version, u32 columns, u64 rows
+ *   directory  per column: char name[16], u32 type, u32 dict entries,
+ *              u64 offset, u64 length
+ *   sections   CATALOG_U32, CATALOG_U64, CATALOG_F32: one value per row
+ *              CATALOG_TEXT: u64 offsets[rows + 1], then the bytes
+ *              CATALOG_DICT: u32 ids[rows], padding,
+ *                            u64 offsets[entries + 1], then the bytes
+ *
+ * A row's "present" bits say which of its columns actually had a value */
+
+#define CATALOG_MAGIC    "SDPDCAT"
+#define CATALOG_VERSION  1
+#define CATALOG_NAME_MAX 16
+/* Dictionary values listed per column by catalogQuery */
+#define CATALOG_TOP_MAX  10
+
+enum catalogType
+{
+	CATALOG_U32 = 0,
+	CATALOG_U64,
+	CATALOG_F32,
+	CATALOG_TEXT,
+	CATALOG_DICT
+};
+
+enum catalogColumnId
+{
+	CATALOG_PATH = 0,
+	CATALOG_PROMPT,
+	CATALOG_NEGATIVE,
+	CATALOG_STEPS,
+	CATALOG_CFG,
+	CATALOG_SEED,
+	CATALOG_WIDTH,
+	CATALOG_HEIGHT,
+	CATALOG_SAMPLER,
+	CATALOG_MODEL,
+	CATALOG_RNG,
+	CATALOG_PRESENT,
+	CATALOG_NUM_COLUMNS
+};
+
+struct catalogString
+{
+	const char *str;
+	size_t len;
+};
+
+/* One image's worth, strings point into the caller's buffer and are interned
+ * when the record is added */
+struct catalogRecord
+{
+	struct catalogString strings[CATALOG_NUM_COLUMNS];
+	struct paramValues values;
+	uint32_t present; /* Text columns, numeric ones go by values.present */
+};
+
+/* Rows as they're added, the pool is shared with the rest of the batch and
+ * isn't freed along with the writer */
+struct catalogWriter
+{
+	/* Fixed width values, or pool ids for text and dictionary columns */
+	struct outputBuffer columns[CATALOG_NUM_COLUMNS];
+	struct internPool *pool;
+	uint64_t num_rows;
+};
+
+/* How a column will be laid out once saved */
+struct catalogPlan
+{
+	uint64_t blob_len;
+	uint32_t dict_len;
+	uint32_t *local; /* Pool id to dictionary id */
+	uint32_t *order; /* Dictionary id to pool id */
+};
+
+/* A catalog opened for reading, mapped into memory where possible */
+struct catalogColumn
+{
+	enum catalogType type;
+	int found;
+	const void *values;      /* Per row values or dictionary ids */
+	const uint64_t *offsets; /* Text offsets or dictionary offsets */
+	const char *blob;
+	uint64_t blob_len;
+	uint32_t dict_len;
+};
+
+struct catalog
+{
+	unsigned char *data;
+	size_t data_len;
+	int mapped;
+	uint64_t num_rows;
+	struct catalogColumn columns[CATALOG_NUM_COLUMNS];
+};
+
+void catalogRecordInit(struct catalogRecord *record, const char *path);
+void catalogWriterInit(struct catalogWriter *writer, struct internPool *pool);
+int catalogRecordField(struct catalogRecord *record, const char *label,
+	const char *value, size_t len);
+int catalogWriterAdd(struct catalogWriter *writer,
+	const struct catalogRecord *record);
+int catalogWriterSave(const struct catalogWriter *writer,
+	const char *file_path);
+void catalogWriterFree(struct catalogWriter *writer);
+int catalogOpen(struct catalog *cat, const char *file_path);
+int catalogQuery(const struct catalog *cat, const char * const *filters,
+	const size_t num_filters, FILE *out);
+void catalogClose(struct catalog *cat);
+
+#endif /* CATALOG_H */
@@ -0,0 +1,380 @@
+/* The API format is an object of nodes keyed by id, each with a class_type
+ * and an object of inputs. Inputs wired to another node are given as an
+ * array of [id, output], which is how the sampler refers to its prompts.
+ * The inputs usually come before the class_type so the interesting ones are
+ * collected for every node and only kept once the node turns out to be of a
+ * class worth keeping */
+#include <string.h>
+
+#include "comfyPrompt.h"
+
+/* Fields beyond the numbered ones */
+#define COMFY_NONE  -1
+#define COMFY_CLASS -2
+#define COMFY_TEXT  -3
+
+/* Node depths within the JSON, see jsonScan.h */
+#define DEPTH_NODES  1
+#define DEPTH_NODE   2
+#define DEPTH_INPUTS 3
+#define DEPTH_LINK   4
+
+static const struct
+{
+	const char *name;
+	int field;
+} comfy_inputs[] =
+{
+	{"seed",         COMFY_SEED},
+	{"noise_seed",   COMFY_SEED},
+	{"steps",        COMFY_STEPS},
+	{"cfg",          COMFY_CFG},
+	{"sampler_name", COMFY_SAMPLER},
+	{"width",        COMFY_WIDTH},
+	{"height",       COMFY_HEIGHT},
+	{"ckpt_name",    COMFY_CKPT},
+	{"positive",     COMFY_POSITIVE},
+	{"negative",     COMFY_NEGATIVE},
+	{"text",         COMFY_TEXT}
+};
+
+/* ComfyUI's sampler names alongside what sd calls the same thing, anything
+ * not listed is passed through as is */
+static const struct
+{
+	const char *comfy;
+	const char *sd;
+} comfy_samplers[] =
+{
+	{"euler",              "euler"},
+	{"euler_ancestral",    "euler_a"},
+	{"heun",               "heun"},
+	{"dpm_2",              "dpm2"},
+	{"dpmpp_2s_ancestral", "dpm++2s_a"},
+	{"dpmpp_2m",           "dpm++2m"},
+	{"ipndm",              "ipndm"},
+	{"ipndm_v",            "ipndm_v"},
+	{"lcm",                "lcm"},
+	{"ddim",               "ddim_trailing"}
+};
+
+#define COMFY_NUM_INPUTS (sizeof(comfy_inputs) / sizeof(comfy_inputs[0]))
+#define COMFY_NUM_SAMPLERS \
+	(sizeof(comfy_samplers) / sizeof(comfy_samplers[0]))
+
+static void comfyCopy(char *dst, const size_t dst_max, const char *str,
+	const size_t len, const int append)
+{
+	const size_t start = (append != 0) ? strlen(dst) : 0;
+	const size_t room  = dst_max - 1 - start;
+	const size_t take  = (len < room) ? len : room;
+
+	memcpy(dst + start, str, take);
+	dst[start + take] = '\0';
+}
+
+static void comfyStartNode(struct comfyPrompt *comfy)
+{
+	memset(comfy->node_class, 0, sizeof(comfy->node_class));
+	memset(comfy->node_fields, 0, sizeof(comfy->node_fields));
+	outputReset(&comfy->node_text);
+	comfy->field = COMFY_NONE;
+}
+
+static void comfyKeepFields(struct comfyPrompt *comfy, const int first,
+	const int last)
+{
+	int i;
+
+	for (i = first; i <= last; i++)
+	{
+		memcpy(comfy->fields[i], comfy->node_fields[i], COMFY_FIELD_MAX);
+	}
+}
+
+static void comfyEndNode(struct comfyPrompt *comfy)
+{
+	const char *class_type = comfy->node_class;
+
+	if ((comfy->have_sampler == 0)
+	&& (strstr(class_type, "KSampler") != NULL))
+	{
+		comfyKeepFields(comfy, COMFY_SEED, COMFY_SAMPLER);
+		comfyKeepFields(comfy, COMFY_POSITIVE, COMFY_NEGATIVE);
+		comfy->have_sampler = 1;
+	}
+	else if ((comfy->have_ckpt == 0)
+	&& (strstr(class_type, "CheckpointLoader") != NULL))
+	{
+		comfyKeepFields(comfy, COMFY_CKPT, COMFY_CKPT);
+		comfy->have_ckpt = 1;
+	}
+	else if ((comfy->have_latent == 0)
+	&& (strncmp(class_type, "Empty", sizeof("Empty") - 1) == 0)
+	&& (strstr(class_type, "LatentImage") != NULL))
+	{
+		comfyKeepFields(comfy, COMFY_WIDTH, COMFY_HEIGHT);
+		comfy->have_latent = 1;
+	}
+	else if ((comfy->num_texts < COMFY_TEXT_MAX)
+	&& (strcmp(class_type, "CLIPTextEncode") == 0))
+	{
+		struct comfyText *text = &comfy->texts[comfy->num_texts++];
+
+		/* Hand the buffer over rather than copying it */
+		strcpy(text->id, comfy->node_id);
+		text->text = comfy->node_text;
+		memset(&comfy->node_text, 0, sizeof(struct outputBuffer));
+	}
+}
+
+static enum jsonAction comfyKey(struct comfyPrompt *comfy, const char *str,
+	const size_t len, const size_t depth)
+{
+	size_t i;
+
+	comfy->field = COMFY_NONE;
+
+	switch (depth)
+	{
+		case DEPTH_NODES:
+			comfyCopy(comfy->node_id, COMFY_ID_MAX, str, len, 0);
+
+			return JSON_CONTINUE;
+		case DEPTH_NODE:
+			if ((len == sizeof("class_type") - 1)
+			&& (memcmp(str, "class_type", len) == 0))
+			{
+				comfy->field = COMFY_CLASS;
+
+				return JSON_CONTINUE;
+			}
+
+			return ((len == sizeof("inputs") - 1)
+				&& (memcmp(str, "inputs", len) == 0))
+				? JSON_CONTINUE : JSON_SKIP;
+		case DEPTH_INPUTS:
+			for (i = 0; i < COMFY_NUM_INPUTS; i++)
+			{
+				if ((strlen(comfy_inputs[i].name) == len)
+				&& (memcmp(comfy_inputs[i].name, str, len) == 0))
+				{
+					comfy->field = comfy_inputs[i].field;
+
+					return JSON_CONTINUE;
+				}
+			}
+
+			return JSON_SKIP;
+		default:
+			return JSON_SKIP;
+	}
+}
+
+static enum jsonAction comfyValue(struct comfyPrompt *comfy,
+	const enum jsonEvent event, const char *str, const size_t len,
+	const size_t depth)
+{
+	const int append = comfy->appending;
+
+	comfy->appending = (event == JSON_STRING_PART);
+
+	if ((depth == DEPTH_NODE) && (comfy->field == COMFY_CLASS))
+	{
+		comfyCopy(comfy->node_class, COMFY_FIELD_MAX, str, len, append);
+	}
+	else if ((depth == DEPTH_INPUTS) && (comfy->field == COMFY_TEXT))
+	{
+		outputAppend(&comfy->node_text, str, len);
+	}
+	else if ((depth == DEPTH_INPUTS) && (comfy->field >= 0)
+	&& (comfy->field < COMFY_POSITIVE))
+	{
+		comfyCopy(comfy->node_fields[comfy->field], COMFY_FIELD_MAX,
+			str, len, append);
+	}
+	else if ((depth == DEPTH_LINK) && (comfy->field >= COMFY_POSITIVE)
+	&& ((append != 0) || (comfy->node_fields[comfy->field][0] == '\0')))
+	{
+		comfyCopy(comfy->node_fields[comfy->field], COMFY_ID_MAX,
+			str, len, append);
+	}
+
+	return JSON_CONTINUE;
+}
+
+static enum jsonAction comfyEvent(const enum jsonEvent event,
+	const char *str, const size_t len, const size_t depth, void *ctx)
+{
+	struct comfyPrompt *comfy = (struct comfyPrompt *) ctx;
+
+	switch (event)
+	{
+		case JSON_OBJECT_BEGIN:
+			if (depth == DEPTH_NODE)
+			{
+				comfyStartNode(comfy);
+			}
+
+			return (depth <= DEPTH_INPUTS)
+				? JSON_CONTINUE : JSON_SKIP;
+		case JSON_ARRAY_BEGIN:
+			/* Only links to the conditioning are followed, any
+			 * other linked input can't be resolved anyway */
+			return ((depth == DEPTH_LINK)
+				&& (comfy->field >= COMFY_POSITIVE))
+				? JSON_CONTINUE : JSON_SKIP;
+		case JSON_OBJECT_END:
+			if (depth == DEPTH_NODE)
+			{
+				comfyEndNode(comfy);
+			}
+
+			return JSON_CONTINUE;
+		case JSON_KEY:
+			return comfyKey(comfy, str, len, depth);
+		case JSON_STRING_PART: /* fallthrough */
+		case JSON_STRING:      /* fallthrough */
+		case JSON_NUMBER:
+			return comfyValue(comfy, event, str, len, depth);
+		case JSON_ARRAY_END: /* fallthrough */
+		case JSON_LITERAL:   /* fallthrough */
+		default:
+			return JSON_CONTINUE;
+	}
+}
+
+void comfyInit(struct comfyPrompt *comfy)
+{
+	memset(comfy, 0, sizeof(struct comfyPrompt));
+	jsonInit(&comfy->scan, comfyEvent, comfy);
+	comfy->field = COMFY_NONE;
+}
+
+/* Matches INFLATE_SINK so it can be fed straight from the inflater */
+int comfyFeed(const char *data, const size_t len, void *ctx)
+{
+	struct comfyPrompt *comfy = (struct comfyPrompt *) ctx;
+
+	return (jsonFeed(&comfy->scan, data, len) != JSON_OK);
+}
+
+static const struct comfyText* comfyFindText(
+	const struct comfyPrompt *comfy, const char *id)
+{
+	size_t i;
+
+	for (i = 0; (id[0] != '\0') && (i < comfy->num_texts); i++)
+	{
+		if (strcmp(comfy->texts[i].id, id) == 0)
+		{
+			return &comfy->texts[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Prompts are free to contain newlines but they would end the line here */
+static void comfyPutText(struct outputBuffer *params,
+	const struct comfyText *text)
+{
+	size_t i;
+
+	for (i = 0; i < text->text.len; i++)
+	{
+		const char ch = text->text.data[i];
+
+		outputPutc(params, ((ch == '\n') || (ch == '\r')) ? ' ' : ch);
+	}
+}
+
+/* One setting per line rather than A1111's single comma separated line so
+ * that model names and the like may have commas in them */
+static void comfyPutSetting(struct outputBuffer *params, const char *label,
+	const char *value)
+{
+	if (value[0] == '\0')
+	{
+		return;
+	}
+
+	outputPutc(params, '\n');
+	outputPuts(params, label);
+	outputPuts(params, ": ");
+	outputPuts(params, value);
+}
+
+/* Writes what was found out in the same labelled form as a parameters chunk
+ * so it can go through the usual tokenizing, returns 1 if the JSON was 
+ * malformed or had no sampler node in it */
+int comfyWriteParams(struct comfyPrompt *comfy, struct outputBuffer *params)
+{
+	const char *sampler = comfy->fields[COMFY_SAMPLER];
+	const struct comfyText *positive = NULL;
+	const struct comfyText *negative = NULL;
+	size_t i;
+
+	if ((jsonFinish(&comfy->scan) != JSON_OK)
+	|| (comfy->have_sampler == 0))
+	{
+		return 1;
+	}
+
+	positive = comfyFindText(comfy, comfy->fields[COMFY_POSITIVE]);
+	negative = comfyFindText(comfy, comfy->fields[COMFY_NEGATIVE]);
+	outputPuts(params, "parameters:");
+
+	if (positive != NULL)
+	{
+		comfyPutText(params, positive);
+	}
+
+	if ((negative != NULL) && (negative->text.len != 0))
+	{
+		outputPuts(params, "\nNegative prompt: ");
+		comfyPutText(params, negative);
+	}
+
+	for (i = 0; i < COMFY_NUM_SAMPLERS; i++)
+	{
+		if (strcmp(comfy_samplers[i].comfy, sampler) == 0)
+		{
+			sampler = comfy_samplers[i].sd;
+
+			break;
+		}
+	}
+
+	comfyPutSetting(params, "CFG scale", comfy->fields[COMFY_CFG]);
+	comfyPutSetting(params, "Seed", comfy->fields[COMFY_SEED]);
+
+	if ((comfy->fields[COMFY_WIDTH][0] != '\0')
+	&& (comfy->fields[COMFY_HEIGHT][0] != '\0'))
+	{
+		outputPuts(params, "\nSize: ");
+		outputPuts(params, comfy->fields[COMFY_WIDTH]);
+		outputPutc(params, 'x');
+		outputPuts(params, comfy->fields[COMFY_HEIGHT]);
+	}
+
+	comfyPutSetting(params, "Model", comfy->fields[COMFY_CKPT]);
+	comfyPutSetting(params, "Sampler", sampler);
+	/* Whatever follows Steps is split by commas, so it has to come last */
+	comfyPutSetting(params, "Steps", comfy->fields[COMFY_STEPS]);
+
+	return params->error;
+}
+
+void comfyFree(struct comfyPrompt *comfy)
+{
+	size_t i;
+
+	for (i = 0; i < comfy->num_texts; i++)
+	{
+		outputFree(&comfy->texts[i].text);
+	}
+
+	outputFree(&comfy->node_text);
+	comfy->num_texts = 0;
+}
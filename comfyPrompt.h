@@ -0,0 +1,62 @@
+#ifndef COMFY_PROMPT_H
+#define COMFY_PROMPT_H
+
+#include <stddef.h>
+
+#include "jsonScan.h"
+#include "outputBuffer.h"
+
+/* Pulls the generation settings out of the API format "prompt" JSON that
+ * ComfyUI embeds, only the sampler, checkpoint loader, latent, and text 
+ * encoder nodes are looked at and everything else is skipped unread */
+
+#define COMFY_ID_MAX    32
+#define COMFY_FIELD_MAX 256
+/* Text encoder nodes kept around until the sampler says which it uses */
+#define COMFY_TEXT_MAX  8
+
+enum comfyField
+{
+	COMFY_SEED = 0,
+	COMFY_STEPS,
+	COMFY_CFG,
+	COMFY_SAMPLER,
+	COMFY_WIDTH,
+	COMFY_HEIGHT,
+	COMFY_CKPT,
+	COMFY_POSITIVE, /* Node ids of the conditioning */
+	COMFY_NEGATIVE,
+	COMFY_NUM_FIELDS
+};
+
+struct comfyText
+{
+	char id[COMFY_ID_MAX];
+	struct outputBuffer text;
+};
+
+struct comfyPrompt
+{
+	struct jsonScanner scan;
+	int field;
+	int appending; /* Parts of the same string follow one another */
+	/* The node currently being read */
+	char node_id[COMFY_ID_MAX];
+	char node_class[COMFY_FIELD_MAX];
+	char node_fields[COMFY_NUM_FIELDS][COMFY_FIELD_MAX];
+	struct outputBuffer node_text;
+	/* What has been found so far */
+	char fields[COMFY_NUM_FIELDS][COMFY_FIELD_MAX];
+	int have_sampler;
+	int have_ckpt;
+	int have_latent;
+	struct comfyText texts[COMFY_TEXT_MAX];
+	size_t num_texts;
+};
+
+void comfyInit(struct comfyPrompt *comfy);
+int comfyFeed(const char *data, const size_t len, void *ctx);
+int comfyWriteParams(struct comfyPrompt *comfy, struct outputBuffer *params);
+void comfyFree(struct comfyPrompt *comfy);
+
+#endif /* COMFY_PROMPT_H */
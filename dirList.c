@@ -0,0 +1,76 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else  /* POSIX */
+#include <dirent.h>
+#endif /* Platform Check */
+
+#include "dirList.h"
+
+#ifdef _WIN32
+int dirList(const char *dir, DirVisitFunc *visit, void *ctx)
+{
+	const size_t dir_len = strlen(dir);
+	WIN32_FIND_DATAA found;
+	HANDLE find;
+	char *pattern = NULL;
+	int ret = 0;
+
+	if ((pattern = malloc(dir_len + 3)) == NULL)
+	{
+		return 1;
+	}
+
+	memcpy(pattern, dir, dir_len);
+	strcpy(pattern + dir_len, ((dir_len != 0) 
+		&& ((dir[dir_len - 1] == '\\') || (dir[dir_len - 1] == '/')))
+		? "*" : "\\*");
+
+	if ((find = FindFirstFileA(pattern, &found)) == INVALID_HANDLE_VALUE)
+	{
+		free(pattern);
+
+		return 1;
+	}
+
+	do
+	{
+		if ((found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+		{
+			ret = visit(found.cFileName, ctx);
+		}
+	} while ((ret == 0) && (FindNextFileA(find, &found) != 0));
+
+	FindClose(find);
+	free(pattern);
+
+	return ret;
+}
+#else  /* POSIX */
+int dirList(const char *dir, DirVisitFunc *visit, void *ctx)
+{
+	struct dirent *entry;
+	DIR *handle;
+	int ret = 0;
+
+	if ((handle = opendir(dir)) == NULL)
+	{
+		return 1;
+	}
+
+	while ((ret == 0) && ((entry = readdir(handle)) != NULL))
+	{
+		if ((strcmp(entry->d_name, ".") != 0) 
+		&& (strcmp(entry->d_name, "..") != 0))
+		{
+			ret = visit(entry->d_name, ctx);
+		}
+	}
+
+	closedir(handle);
+
+	return ret;
+}
+#endif /* Platform Check */
@@ -0,0 +1,11 @@
+#ifndef DIR_LIST_H
+#define DIR_LIST_H
+
+/* Calls visit with the name of every entry in dir other than . and .., 
+ * stopping early if it returns anything but 0. Directories are skipped 
+ * where the platform says which entries are directories for free */
+typedef int (DirVisitFunc)(const char *name, void *ctx);
+
+int dirList(const char *dir, DirVisitFunc *visit, void *ctx);
+
+#endif /* DIR_LIST_H */
@@ -0,0 +1,78 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#define FILE_COPY_KERNEL
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef FILE_COPY_KERNEL
+#include <unistd.h>
+#endif
+
+#include "fileCopy.h"
+#include "ioThrottle.h"
+
+#define FILE_COPY_WINDOW 65536
+
+int fileCopyRange(FILE *src, long int offset, uint64_t len, FILE *dst)
+{
+	unsigned char window[FILE_COPY_WINDOW];
+
+#ifdef FILE_COPY_KERNEL
+	long int dst_pos;
+
+	/* Anything stdio is still holding onto has to land first, and stdio
+	 * has to be told where the kernel left off afterwards */
+	if ((fflush(dst) == 0) && ((dst_pos = ftell(dst)) != -1))
+	{
+		off64_t in_off = offset, out_off = dst_pos;
+
+		while (len != 0)
+		{
+			const size_t want = (len < FILE_COPY_WINDOW) 
+				? (size_t) len : FILE_COPY_WINDOW;
+			ssize_t done;
+
+			ioChargeRead(want);
+			done = copy_file_range(fileno(src), &in_off, 
+				fileno(dst), &out_off, want, 0);
+
+			if (done <= 0)
+			{
+				break;
+			}
+
+			len -= (uint64_t) done;
+		}
+
+		offset = (long int) in_off;
+
+		if (fseek(dst, (long int) out_off, SEEK_SET) != 0)
+		{
+			return 1;
+		}
+	}
+#endif
+
+	if ((len != 0) && (fseek(src, offset, SEEK_SET) != 0))
+	{
+		return 1;
+	}
+
+	while (len != 0)
+	{
+		const size_t want = (len < FILE_COPY_WINDOW) 
+			? (size_t) len : FILE_COPY_WINDOW;
+
+		if ((ioRead(window, sizeof(char), want, src) != want)
+		|| (fwrite(window, sizeof(char), want, dst) != want))
+		{
+			return 1;
+		}
+
+		len -= want;
+	}
+
+	return 0;
+}
@@ -0,0 +1,14 @@
+#ifndef FILE_COPY_H
+#define FILE_COPY_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Copies len bytes starting at offset in src to the current position of 
+ * dst. On Linux the kernel copies the data itself without it ever passing
+ * through this process, elsewhere, or if the kernel declines, it's read and
+ * written in the usual way. src is left at an unspecified position */
+int fileCopyRange(FILE *src, long int offset, uint64_t len, 
+	FILE *dst);
+
+#endif /* FILE_COPY_H */
@@ -0,0 +1,832 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "pngProcessing.h"
+#include "ioThrottle.h"
+#include "imageProcessing.h"
+
+#define IMAGE_WINDOW 4096
+
+#define EXIF_ID_LEN  6
+#define XMP_ID_LEN   29
+#define IFD_ENTRY    12
+
+/* Places text is looked for in JPEG and WebP files, most preferred first */
+enum imageSource
+{
+	SOURCE_USER_COMMENT = 0, /* EXIF UserComment, as A1111 writes it */
+	SOURCE_COMFY,            /* An EXIF string starting with "prompt:" */
+	SOURCE_XMP,
+	SOURCE_COMMENT,          /* JPEG COM segment */
+	NUM_SOURCES
+};
+
+struct imageFound
+{
+	struct imageText text[NUM_SOURCES];
+	int have[NUM_SOURCES];
+};
+
+/* EXIF is a small TIFF file, every offset in it is relative to its header
+ * and multi-byte values are in whichever byte order the header says */
+struct tiffReader
+{
+	FILE *fhandle;
+	long int base;
+	uint32_t length;
+	int big_endian;
+};
+
+static const char exif_id[EXIF_ID_LEN] = {'E', 'x', 'i', 'f', 0, 0};
+static const char xmp_id[XMP_ID_LEN] = "http://ns.adobe.com/xap/1.0/";
+
+/* XMP properties that parameters turn up in, most preferred first */
+static const char * const xmp_names[] =
+{
+	"exif:UserComment",
+	"dc:description",
+	"tiff:ImageDescription"
+};
+
+#define XMP_NUM_NAMES (sizeof(xmp_names) / sizeof(xmp_names[0]))
+
+static void imageFoundText(struct imageFound *found,
+	const enum imageSource source, const enum imageEncoding encoding,
+	const long int offset, const size_t length)
+{
+	if (found->have[source] == 0)
+	{
+		found->text[source].kind = (source == SOURCE_COMFY)
+			? IMAGE_TEXT_COMFY : IMAGE_TEXT_PARAMETERS;
+		found->text[source].encoding = encoding;
+		found->text[source].offset = offset;
+		found->text[source].length = length;
+		found->have[source] = 1;
+	}
+}
+
+static uint32_t tiffGet(const struct tiffReader *tiff,
+	const unsigned char *bytes, const size_t len)
+{
+	uint32_t val = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		val = (val << 8)
+			| bytes[(tiff->big_endian != 0) ? i : len - 1 - i];
+	}
+
+	return val;
+}
+
+static int tiffFits(const struct tiffReader *tiff, const uint32_t offset,
+	const uint32_t len)
+{
+	return ((offset <= tiff->length) && (len <= tiff->length - offset));
+}
+
+static int tiffRead(const struct tiffReader *tiff, const uint32_t offset,
+	unsigned char *dst, const size_t len)
+{
+	if ((tiffFits(tiff, offset, (uint32_t) len) == 0)
+	|| (fseek(tiff->fhandle, tiff->base + (long int) offset, SEEK_SET)
+		!= 0)
+	|| (ioRead(dst, sizeof(char), len, tiff->fhandle) != len))
+	{
+		return 1;
+	}
+
+	return 0;
+}
+
+/* The 8 byte character code ahead of a UserComment says how it's encoded,
+ * A1111 writes UTF-16 in big endian no matter the byte order of the rest of
+ * the EXIF so the first character is looked at as well */
+static void exifUserComment(const struct tiffReader *tiff,
+	const uint32_t offset, const uint32_t count, struct imageFound *found)
+{
+	unsigned char head[10] = {0};
+	enum imageEncoding encoding = IMAGE_UTF8;
+
+	if ((count <= 8) || (tiffFits(tiff, offset, count) == 0)
+	|| (tiffRead(tiff, offset, head, (count < 10) ? 8 : 10) != 0))
+	{
+		return;
+	}
+
+	if (memcmp(head, "UNICODE\0", 8) == 0)
+	{
+		if ((head[8] == 0) && (head[9] != 0))
+		{
+			encoding = IMAGE_UTF16_BE;
+		}
+		else if ((head[8] != 0) && (head[9] == 0))
+		{
+			encoding = IMAGE_UTF16_LE;
+		}
+		else
+		{
+			encoding = (tiff->big_endian != 0)
+				? IMAGE_UTF16_BE : IMAGE_UTF16_LE;
+		}
+	}
+
+	imageFoundText(found, SOURCE_USER_COMMENT, encoding,
+		tiff->base + (long int) offset + 8, count - 8);
+}
+
+/* ComfyUI keeps its prompt JSON in an ordinary EXIF string behind a label */
+static void exifString(const struct tiffReader *tiff, const uint32_t offset,
+	const uint32_t count, struct imageFound *found)
+{
+	unsigned char head[sizeof("prompt:") - 1];
+
+	if ((found->have[SOURCE_COMFY] != 0) || (count <= sizeof(head))
+	|| (tiffFits(tiff, offset, count) == 0)
+	|| (tiffRead(tiff, offset, head, sizeof(head)) != 0))
+	{
+		return;
+	}
+
+	if (memcmp(head, "prompt:", sizeof(head)) == 0)
+	{
+		imageFoundText(found, SOURCE_COMFY, IMAGE_UTF8,
+			tiff->base + (long int) (offset + sizeof(head)),
+			count - sizeof(head));
+	}
+}
+
+/* Only the entries themselves are read, returns the offset of the Exif
+ * sub-IFD if this IFD points to one and 0 otherwise */
+static uint32_t exifScanIfd(const struct tiffReader *tiff,
+	const uint32_t ifd, struct imageFound *found)
+{
+	unsigned char entry[IFD_ENTRY];
+	uint32_t i, num_entries, sub_ifd = 0;
+
+	if (tiffRead(tiff, ifd, entry, 2) != 0)
+	{
+		return 0;
+	}
+
+	num_entries = tiffGet(tiff, entry, 2);
+
+	for (i = 0; (i < num_entries) && (i < IMAGE_IFD_MAX); i++)
+	{
+		uint32_t tag, type, count, value;
+
+		if (tiffRead(tiff, ifd + 2 + i * IFD_ENTRY, entry, IFD_ENTRY)
+			!= 0)
+		{
+			break;
+		}
+
+		tag   = tiffGet(tiff, entry, 2);
+		type  = tiffGet(tiff, entry + 2, 2);
+		count = tiffGet(tiff, entry + 4, 4);
+		value = tiffGet(tiff, entry + 8, 4);
+
+		/* Anything of four bytes or less is stored in the value
+		 * field itself, none of the text wanted is ever that short */
+		if (tag == 0x8769) /* Exif IFD pointer */
+		{
+			sub_ifd = value;
+		}
+		else if ((tag == 0x9286) && (count > 4)) /* UserComment */
+		{
+			exifUserComment(tiff, value, count, found);
+		}
+		else if ((type == 2) && (count > 4)) /* ASCII */
+		{
+			exifString(tiff, value, count, found);
+		}
+	}
+
+	return sub_ifd;
+}
+
+static void exifScan(FILE *fhandle, const long int base,
+	const uint32_t length, struct imageFound *found)
+{
+	struct tiffReader tiff = {NULL, 0, 0, 0};
+	unsigned char head[8];
+	uint32_t sub_ifd;
+
+	tiff.fhandle = fhandle;
+	tiff.base    = base;
+	tiff.length  = length;
+
+	if (tiffRead(&tiff, 0, head, sizeof(head)) != 0)
+	{
+		return;
+	}
+
+	if (memcmp(head, "MM\0*", 4) == 0)
+	{
+		tiff.big_endian = 1;
+	}
+	else if (memcmp(head, "II*\0", 4) != 0)
+	{
+		return;
+	}
+
+	if ((sub_ifd = exifScanIfd(&tiff, tiffGet(&tiff, head + 4, 4), found))
+		!= 0)
+	{
+		exifScanIfd(&tiff, sub_ifd, found);
+	}
+}
+
+static const char* xmpClosingTag(const char *pos, const char *name,
+	const size_t name_len)
+{
+	while ((pos = strstr(pos, "</")) != NULL)
+	{
+		if (strncmp(pos + 2, name, name_len) == 0)
+		{
+			return pos;
+		}
+
+		pos += 2;
+	}
+
+	return NULL;
+}
+
+/* Properties may be written either as an attribute or as an element, whose
+ * value is usually wrapped in an rdf:Alt list of translations of which the
+ * first is taken. Returns 1 if the property isn't there */
+static int xmpFindValue(const char *packet, const char *name,
+	const char **value, size_t *value_len)
+{
+	const size_t name_len = strlen(name);
+	const char *pos = packet;
+	const char *end = NULL;
+
+	while ((pos = strstr(pos, name)) != NULL)
+	{
+		const char *after = pos + name_len;
+
+		if ((after[0] == '=') && ((after[1] == '"') || (after[1] == '\'')))
+		{
+			*value = after + 2;
+			end = strchr(*value, after[1]);
+		}
+		else if ((pos != packet) && (pos[-1] == '<') && (after[0] != '\0')
+		&& (strchr(" \t\r\n>", after[0]) != NULL))
+		{
+			const char *item = NULL;
+
+			if (((*value = strchr(after, '>')) == NULL)
+			|| ((*value)[-1] == '/'))
+			{
+				pos = after;
+
+				continue;
+			}
+
+			(*value)++;
+			end = xmpClosingTag(*value, name, name_len);
+
+			if ((end != NULL)
+			&& ((item = strstr(*value, "<rdf:li")) != NULL)
+			&& (item < end)
+			&& ((*value = strchr(item, '>')) != NULL))
+			{
+				(*value)++;
+				end = strstr(*value, "</rdf:li>");
+			}
+		}
+		else
+		{
+			pos = after;
+
+			continue;
+		}
+
+		if (end == NULL)
+		{
+			return 1;
+		}
+
+		*value_len = (size_t) (end - *value);
+
+		return 0;
+	}
+
+	return 1;
+}
+
+/* The packet has to be searched so it is read in whole, but only up to
+ * IMAGE_XMP_MAX bytes of it */
+static void xmpScan(FILE *fhandle, const long int start, const size_t length,
+	struct imageFound *found)
+{
+	char *packet = NULL;
+	size_t i;
+
+	if ((found->have[SOURCE_XMP] != 0) || (length == 0)
+	|| (length > IMAGE_XMP_MAX)
+	|| ((packet = malloc(length + 1)) == NULL))
+	{
+		return;
+	}
+
+	if ((fseek(fhandle, start, SEEK_SET) == 0)
+	&& (ioRead(packet, sizeof(char), length, fhandle) == length))
+	{
+		packet[length] = '\0';
+
+		for (i = 0; (i < XMP_NUM_NAMES)
+		&& (found->have[SOURCE_XMP] == 0); i++)
+		{
+			const char *value = NULL;
+			size_t value_len = 0;
+
+			if (xmpFindValue(packet, xmp_names[i], &value,
+				&value_len) == 0)
+			{
+				imageFoundText(found, SOURCE_XMP, IMAGE_XML,
+					start + (long int) (value - packet),
+					value_len);
+			}
+		}
+	}
+
+	free(packet);
+}
+
+/* Walks the segments up to the start of the first scan, past which there is
+ * only compressed image data, seeking over any segment not of interest */
+static void jpegScan(FILE *fhandle, struct imageFound *found)
+{
+	unsigned char len_bytes[2];
+	char id[XMP_ID_LEN];
+	long int pos = 2; /* Past the SOI marker */
+
+	while (found->have[SOURCE_USER_COMMENT] == 0)
+	{
+		long int seg_start;
+		size_t seg_len, id_len;
+		int marker;
+
+		if ((fseek(fhandle, pos, SEEK_SET) != 0)
+		|| (ioGetc(fhandle) != 0xFF))
+		{
+			return;
+		}
+
+		/* Markers may be padded out with any number of fill bytes */
+		while ((marker = ioGetc(fhandle)) == 0xFF);
+
+		if ((marker == EOF)
+		|| (marker == 0xDA)  /* SOS */
+		|| (marker == 0xD9)) /* EOI */
+		{
+			return;
+		}
+
+		/* Standalone markers have no length */
+		if (((marker >= 0xD0) && (marker <= 0xD7)) || (marker == 0x01))
+		{
+			pos = ftell(fhandle);
+
+			continue;
+		}
+
+		if ((ioRead(len_bytes, sizeof(char), 2, fhandle) != 2)
+		|| ((seg_len = ((size_t) len_bytes[0] << 8) | len_bytes[1])
+			< 2)
+		|| ((seg_start = ftell(fhandle)) == -1))
+		{
+			return;
+		}
+
+		seg_len -= 2;
+		id_len = (seg_len < XMP_ID_LEN) ? seg_len : XMP_ID_LEN;
+
+		if (marker == 0xE1) /* APP1 */
+		{
+			if (ioRead(id, sizeof(char), id_len, fhandle) != id_len)
+			{
+				return;
+			}
+
+			if ((id_len >= EXIF_ID_LEN)
+			&& (memcmp(id, exif_id, EXIF_ID_LEN) == 0))
+			{
+				exifScan(fhandle, seg_start + EXIF_ID_LEN,
+					(uint32_t) (seg_len - EXIF_ID_LEN),
+					found);
+			}
+			else if ((id_len == XMP_ID_LEN)
+			&& (memcmp(id, xmp_id, XMP_ID_LEN) == 0))
+			{
+				xmpScan(fhandle, seg_start + XMP_ID_LEN,
+					seg_len - XMP_ID_LEN, found);
+			}
+		}
+		else if (marker == 0xFE) /* COM */
+		{
+			imageFoundText(found, SOURCE_COMMENT, IMAGE_UTF8,
+				seg_start, seg_len);
+		}
+
+		pos = seg_start + (long int) seg_len;
+	}
+}
+
+static uint32_t webpLe32(const unsigned char *bytes)
+{
+	return (uint32_t) bytes[0] | ((uint32_t) bytes[1] << 8)
+		| ((uint32_t) bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+}
+
+/* Walks the RIFF chunk headers, the bitstream chunks are seeked over */
+static void webpScan(FILE *fhandle, struct imageFound *found)
+{
+	unsigned char head[8];
+	unsigned long riff_end, pos = 12; /* Past "RIFF", size, "WEBP" */
+
+	if ((fseek(fhandle, 4, SEEK_SET) != 0)
+	|| (ioRead(head, sizeof(char), 4, fhandle) != 4))
+	{
+		return;
+	}
+
+	riff_end = (unsigned long) webpLe32(head) + 8;
+
+	while ((pos + 8 <= riff_end)
+	&& (found->have[SOURCE_USER_COMMENT] == 0))
+	{
+		const unsigned long data = pos + 8;
+		uint32_t chunk_len;
+		char id[EXIF_ID_LEN];
+
+		if ((fseek(fhandle, (long int) pos, SEEK_SET) != 0)
+		|| (ioRead(head, sizeof(char), 8, fhandle) != 8)
+		|| ((chunk_len = webpLe32(head + 4)) > riff_end - data))
+		{
+			return;
+		}
+
+		if (memcmp(head, "EXIF", 4) == 0)
+		{
+			/* The spec has the TIFF header straight away but some
+			 * writers keep the JPEG style identifier in front */
+			if ((chunk_len >= EXIF_ID_LEN)
+			&& (ioRead(id, sizeof(char), EXIF_ID_LEN, fhandle)
+				== EXIF_ID_LEN)
+			&& (memcmp(id, exif_id, EXIF_ID_LEN) == 0))
+			{
+				exifScan(fhandle, (long int) data + EXIF_ID_LEN,
+					chunk_len - EXIF_ID_LEN, found);
+			}
+			else
+			{
+				exifScan(fhandle, (long int) data, chunk_len,
+					found);
+			}
+		}
+		else if (memcmp(head, "XMP ", 4) == 0)
+		{
+			xmpScan(fhandle, (long int) data, chunk_len, found);
+		}
+
+		/* Chunks are padded out to an even length */
+		pos = data + chunk_len + (chunk_len & 1);
+	}
+}
+
+/* Leaves the file just past the signature, same as pngValidate */
+enum imageFormat imageDetect(FILE *fhandle)
+{
+	unsigned char head[12] = {0};
+	size_t got;
+
+	if ((fhandle == NULL) || (fseek(fhandle, 0, SEEK_SET) != 0))
+	{
+		return IMAGE_UNKNOWN;
+	}
+
+	if (pngValidate(fhandle) == 1)
+	{
+		return IMAGE_PNG;
+	}
+
+	if ((fseek(fhandle, 0, SEEK_SET) != 0)
+	|| ((got = ioRead(head, sizeof(char), sizeof(head), fhandle)) < 3))
+	{
+		return IMAGE_UNKNOWN;
+	}
+
+	if ((head[0] == 0xFF) && (head[1] == 0xD8) && (head[2] == 0xFF))
+	{
+		return (fseek(fhandle, 2, SEEK_SET) == 0)
+			? IMAGE_JPEG : IMAGE_UNKNOWN;
+	}
+
+	if ((got == sizeof(head)) && (memcmp(head, "RIFF", 4) == 0)
+	&& (memcmp(head + 8, "WEBP", 4) == 0))
+	{
+		return IMAGE_WEBP;
+	}
+
+	return IMAGE_UNKNOWN;
+}
+
+const char* imageFormatName(const enum imageFormat format)
+{
+	switch (format)
+	{
+		case IMAGE_PNG:
+			return "PNG";
+		case IMAGE_JPEG:
+			return "JPEG";
+		case IMAGE_WEBP:
+			return "WebP";
+		case IMAGE_UNKNOWN: /* fallthrough */
+		default:
+			return "unknown";
+	}
+}
+
+/* Finds where the parameters are kept in a JPEG or WebP file, PNG files go
+ * through pngScanText instead. Returns 1 if there aren't any */
+int imageFindText(FILE *fhandle, const enum imageFormat format,
+	struct imageText *text)
+{
+	struct imageFound found;
+	size_t i;
+
+	if ((fhandle == NULL) || (text == NULL))
+	{
+		return 1;
+	}
+
+	memset(&found, 0, sizeof(struct imageFound));
+
+	switch (format)
+	{
+		case IMAGE_JPEG:
+			jpegScan(fhandle, &found);
+			break;
+		case IMAGE_WEBP:
+			webpScan(fhandle, &found);
+			break;
+		case IMAGE_PNG:     /* fallthrough */
+		case IMAGE_UNKNOWN: /* fallthrough */
+		default:
+			return 1;
+	}
+
+	for (i = 0; i < NUM_SOURCES; i++)
+	{
+		if (found.have[i] != 0)
+		{
+			*text = found.text[i];
+
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static size_t imageUtf8(char *dst, const unsigned long cp)
+{
+	if (cp < 0x80)
+	{
+		dst[0] = (char) cp;
+
+		return 1;
+	}
+	else if (cp < 0x800)
+	{
+		dst[0] = (char) (0xC0 | (cp >> 6));
+		dst[1] = (char) (0x80 | (cp & 0x3F));
+
+		return 2;
+	}
+	else if (cp < 0x10000)
+	{
+		dst[0] = (char) (0xE0 | (cp >> 12));
+		dst[1] = (char) (0x80 | ((cp >> 6) & 0x3F));
+		dst[2] = (char) (0x80 | (cp & 0x3F));
+
+		return 3;
+	}
+
+	dst[0] = (char) (0xF0 | (cp >> 18));
+	dst[1] = (char) (0x80 | ((cp >> 12) & 0x3F));
+	dst[2] = (char) (0x80 | ((cp >> 6) & 0x3F));
+	dst[3] = (char) (0x80 | (cp & 0x3F));
+
+	return 4;
+}
+
+/* UTF-8 and UTF-16 text is passed along a window at a time, the latter
+ * converted to UTF-8 on the way. A null character ends the text early since
+ * EXIF strings are often padded out with them */
+static int imageStreamPlain(FILE *fhandle, const struct imageText *text,
+	INFLATE_SINK *sink, void *ctx)
+{
+	unsigned char window[IMAGE_WINDOW];
+	/* A UTF-16 unit is at most three bytes of UTF-8, plus room for a
+	 * replacement character for a high surrogate left from last time */
+	char out[IMAGE_WINDOW / 2 * 3 + 3];
+	const int big_endian = (text->encoding == IMAGE_UTF16_BE);
+	size_t left = text->length;
+	unsigned long high = 0; /* High surrogate waiting on its pair */
+
+	while (left != 0)
+	{
+		const size_t want = (left < IMAGE_WINDOW) ? left : IMAGE_WINDOW;
+		size_t i, out_len = 0;
+		int ended = 0;
+
+		if (ioRead(window, sizeof(char), want, fhandle) != want)
+		{
+			return 1;
+		}
+
+		left -= want;
+
+		if (text->encoding == IMAGE_UTF8)
+		{
+			const unsigned char *nul = memchr(window, '\0', want);
+			const size_t len = (nul == NULL)
+				? want : (size_t) (nul - window);
+
+			if ((sink((const char *) window, len, ctx) != 0)
+			|| (nul != NULL))
+			{
+				return 0;
+			}
+
+			continue;
+		}
+
+		for (i = 0; i + 1 < want; i += 2)
+		{
+			const unsigned long unit = (big_endian != 0)
+				? ((unsigned long) window[i] << 8) | window[i + 1]
+				: ((unsigned long) window[i + 1] << 8) | window[i];
+			unsigned long cp = unit;
+
+			if (unit == 0)
+			{
+				ended = 1;
+
+				break;
+			}
+
+			if ((high != 0) && ((unit < 0xDC00) || (unit > 0xDFFF)))
+			{
+				out_len += imageUtf8(out + out_len, 0xFFFD);
+				high = 0;
+			}
+
+			if ((unit >= 0xD800) && (unit <= 0xDBFF))
+			{
+				high = unit;
+
+				continue;
+			}
+			else if ((unit >= 0xDC00) && (unit <= 0xDFFF))
+			{
+				cp = (high == 0) ? 0xFFFD
+					: 0x10000 + ((high - 0xD800) << 10)
+					+ (unit - 0xDC00);
+				high = 0;
+			}
+
+			out_len += imageUtf8(out + out_len, cp);
+		}
+
+		if (((out_len != 0) && (sink(out, out_len, ctx) != 0))
+		|| (ended != 0))
+		{
+			return 0;
+		}
+	}
+
+	return 0;
+}
+
+static unsigned long xmlEntity(const char *name, const size_t len)
+{
+	const struct
+	{
+		const char *name;
+		char ch;
+	} named[] = {{"amp", '&'}, {"lt", '<'}, {"gt", '>'}, {"quot", '"'},
+		{"apos", '\''}};
+	char num[16] = {0};
+	size_t i;
+
+	if ((len > 1) && (len < sizeof(num)) && (name[0] == '#'))
+	{
+		memcpy(num, name + 1, len - 1);
+
+		return ((num[0] == 'x') || (num[0] == 'X'))
+			? strtoul(num + 1, NULL, 16) : strtoul(num, NULL, 10);
+	}
+
+	for (i = 0; i < sizeof(named) / sizeof(named[0]); i++)
+	{
+		if ((strlen(named[i].name) == len)
+		&& (memcmp(named[i].name, name, len) == 0))
+		{
+			return (unsigned long) named[i].ch;
+		}
+	}
+
+	return 0;
+}
+
+/* XMP values are small enough to be read in whole and have their entities
+ * replaced in place, none of which is shorter than what it stands for */
+static int imageStreamXml(FILE *fhandle, const struct imageText *text,
+	INFLATE_SINK *sink, void *ctx)
+{
+	char *value = NULL;
+	size_t i = 0, len = 0;
+
+	if ((text->length > IMAGE_XMP_MAX)
+	|| ((value = malloc(text->length + 1)) == NULL))
+	{
+		return 1;
+	}
+
+	if (ioRead(value, sizeof(char), text->length, fhandle) != text->length)
+	{
+		free(value);
+
+		return 1;
+	}
+
+	while ((i < text->length) && (value[i] != '\0'))
+	{
+		const char *semi = (value[i] == '&')
+			? memchr(value + i, ';', text->length - i) : NULL;
+		const unsigned long cp = (semi != NULL)
+			? xmlEntity(value + i + 1, (size_t) (semi - value - i - 1))
+			: 0;
+
+		if ((cp != 0) && (cp <= 0x10FFFF))
+		{
+			len += imageUtf8(value + len, cp);
+			i = (size_t) (semi - value) + 1;
+		}
+		else
+		{
+			value[len++] = value[i++];
+		}
+	}
+
+	sink(value, len, ctx);
+	free(value);
+
+	return 0;
+}
+
+/* Feeds the text to sink decoded, sink returning non-zero just stops things
+ * early and isn't an error, returns 1 if the text couldn't be read */
+int imageStreamText(FILE *fhandle, const struct imageText *text,
+	INFLATE_SINK *sink, void *ctx)
+{
+	enum inflateResult ret;
+
+	if ((fhandle == NULL) || (text == NULL) || (sink == NULL)
+	|| (fseek(fhandle, text->offset, SEEK_SET) != 0))
+	{
+		return 1;
+	}
+
+	switch (text->encoding)
+	{
+		case IMAGE_ZLIB:
+			ret = inflateZlibFile(fhandle, text->length, sink, ctx);
+
+			if ((ret != INFLATE_OK) && (ret != INFLATE_STOPPED))
+			{
+				fprintf(stderr, "Unable to decompress text: %s\n",
+					inflateErrorString(ret));
+
+				return 1;
+			}
+
+			return 0;
+		case IMAGE_XML:
+			return imageStreamXml(fhandle, text, sink, ctx);
+		case IMAGE_UTF8:     /* fallthrough */
+		case IMAGE_UTF16_BE: /* fallthrough */
+		case IMAGE_UTF16_LE: /* fallthrough */
+		default:
+			return imageStreamPlain(fhandle, text, sink, ctx);
+	}
+}
@@ -0,0 +1,59 @@
+#ifndef IMAGE_PROCESSING_H
+#define IMAGE_PROCESSING_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "inflate.h"
+
+/* Front end for the image formats parameters can be read out of. PNG files
+ * are handed over to pngProcessing, JPEG and WebP files have their EXIF and
+ * XMP found by walking the APPn segments or RIFF chunk headers, seeking past
+ * everything else so the compressed image data is never read */
+
+/* Larger XMP packets are not searched */
+#define IMAGE_XMP_MAX  (1L << 20)
+/* Guards against looping IFDs in damaged EXIF */
+#define IMAGE_IFD_MAX  512
+
+enum imageFormat
+{
+	IMAGE_UNKNOWN = 0,
+	IMAGE_PNG,
+	IMAGE_JPEG,
+	IMAGE_WEBP
+};
+
+/* What the text holds once decoded */
+enum imageTextKind
+{
+	IMAGE_TEXT_PARAMETERS = 0, /* A1111 style, prompt on the first line */
+	IMAGE_TEXT_COMFY           /* ComfyUI's API format prompt JSON */
+};
+
+/* How the text is stored in the file */
+enum imageEncoding
+{
+	IMAGE_UTF8 = 0,
+	IMAGE_ZLIB,
+	IMAGE_UTF16_BE,
+	IMAGE_UTF16_LE,
+	IMAGE_XML /* UTF-8 with entities, bounded by IMAGE_XMP_MAX */
+};
+
+struct imageText
+{
+	enum imageTextKind kind;
+	enum imageEncoding encoding;
+	long int offset;
+	size_t length;
+};
+
+enum imageFormat imageDetect(FILE *fhandle);
+const char* imageFormatName(const enum imageFormat format);
+int imageFindText(FILE *fhandle, const enum imageFormat format,
+	struct imageText *text);
+int imageStreamText(FILE *fhandle, const struct imageText *text,
+	INFLATE_SINK *sink, void *ctx);
+
+#endif /* IMAGE_PROCESSING_H */
@@ -0,0 +1,644 @@
+/* Table driven streaming inflate, decodes a zlib stream straight from a file
+ * through a small input window into a 32K history window which is handed to
+ * the caller's sink each time it fills. Codes no longer than
+ * INFLATE_FAST_BITS decode with one lookup, longer ones fall back to walking
+ * the canonical code a bit at a time which is rare enough not to matter */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ioThrottle.h"
+#include "inflate.h"
+
+#define INFLATE_MAX_BITS   15
+#define INFLATE_MAX_LCODES 288
+#define INFLATE_MAX_DCODES 30
+#define INFLATE_ADLER_MOD  65521
+
+struct inflateHuffman
+{
+	/* (length << 9) | symbol, zero if the code is longer than the table */
+	uint16_t fast[1 << INFLATE_FAST_BITS];
+	uint16_t counts[INFLATE_MAX_BITS + 1];
+	uint16_t symbols[INFLATE_MAX_LCODES];
+};
+
+struct inflateState
+{
+	FILE *fhandle;
+	size_t in_left;   /* Compressed bytes not yet read from the file */
+	size_t in_pos;
+	size_t in_len;
+	uint32_t bit_buf;
+	int bit_cnt;
+	int pad_bits;     /* Zero bits added past the end of input */
+	int overrun;      /* Some of those were actually consumed */
+	unsigned long win_pos;
+	unsigned long flushed;
+	uint32_t adler_a;
+	uint32_t adler_b;
+	INFLATE_SINK *sink;
+	void *ctx;
+	struct inflateHuffman lens;
+	struct inflateHuffman dists;
+	unsigned char in[INFLATE_IN_WINDOW];
+	unsigned char window[INFLATE_WINDOW];
+};
+
+static const uint16_t length_base[29] =
+{
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51,
+	59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint16_t length_extra[29] =
+{
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4,
+	5, 5, 5, 5, 0
+};
+
+static const uint16_t dist_base[30] =
+{
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+	513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint16_t dist_extra[30] =
+{
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10,
+	10, 11, 11, 12, 12, 13, 13
+};
+
+static int inflateFetchByte(struct inflateState *state)
+{
+	if (state->in_pos == state->in_len)
+	{
+		const size_t want = (state->in_left < INFLATE_IN_WINDOW)
+			? state->in_left : INFLATE_IN_WINDOW;
+
+		if ((want == 0)
+		|| ((state->in_len = ioRead(state->in, sizeof(char), want,
+			state->fhandle)) == 0))
+		{
+			return EOF;
+		}
+
+		state->in_left -= state->in_len;
+		state->in_pos   = 0;
+	}
+
+	return state->in[state->in_pos++];
+}
+
+/* Past the end of the input the buffer is padded with zeros so the fast
+ * table can always peek, actually consuming those bits sets overrun */
+static void inflateFill(struct inflateState *state, const int need)
+{
+	while (state->bit_cnt < need)
+	{
+		int byte = inflateFetchByte(state);
+
+		if (byte == EOF)
+		{
+			byte = 0;
+			state->pad_bits += 8;
+		}
+
+		state->bit_buf |= (uint32_t) byte << state->bit_cnt;
+		state->bit_cnt += 8;
+	}
+}
+
+static uint32_t inflateBits(struct inflateState *state, const int need)
+{
+	uint32_t ret;
+
+	if (need == 0)
+	{
+		return 0;
+	}
+
+	inflateFill(state, need);
+	ret = state->bit_buf & ((1UL << need) - 1);
+	state->bit_buf >>= need;
+	state->bit_cnt -= need;
+
+	if (state->bit_cnt < state->pad_bits)
+	{
+		state->overrun = 1;
+	}
+
+	return ret;
+}
+
+/* Returns non-zero if the lengths describe an over-subscribed code */
+static int inflateBuild(struct inflateHuffman *huff, const uint8_t *lengths,
+	const size_t num)
+{
+	uint16_t offsets[INFLATE_MAX_BITS + 1];
+	uint16_t next_code[INFLATE_MAX_BITS + 1];
+	size_t i;
+	long left = 1;
+	uint16_t code = 0;
+
+	memset(huff->counts, 0, sizeof(huff->counts));
+	memset(huff->fast, 0, sizeof(huff->fast));
+
+	for (i = 0; i < num; i++)
+	{
+		huff->counts[lengths[i]]++;
+	}
+
+	huff->counts[0] = 0;
+
+	for (i = 1; i <= INFLATE_MAX_BITS; i++)
+	{
+		left = (left << 1) - huff->counts[i];
+
+		if (left < 0)
+		{
+			return 1;
+		}
+	}
+
+	offsets[1] = 0;
+
+	for (i = 1; i < INFLATE_MAX_BITS; i++)
+	{
+		offsets[i + 1] = offsets[i] + huff->counts[i];
+	}
+
+	for (i = 1; i <= INFLATE_MAX_BITS; i++)
+	{
+		code = (code + huff->counts[i - 1]) << 1;
+		next_code[i] = code;
+	}
+
+	for (i = 0; i < num; i++)
+	{
+		const uint8_t len = lengths[i];
+		uint16_t rev = 0, c;
+		int b;
+
+		if (len == 0)
+		{
+			continue;
+		}
+
+		huff->symbols[offsets[len]++] = (uint16_t) i;
+		c = next_code[len]++;
+
+		if (len > INFLATE_FAST_BITS)
+		{
+			continue;
+		}
+
+		/* Codes are packed most significant bit first */
+		for (b = 0; b < len; b++)
+		{
+			rev = (uint16_t) ((rev << 1) | ((c >> b) & 1));
+		}
+
+		for (; rev < (1 << INFLATE_FAST_BITS); rev += (1 << len))
+		{
+			huff->fast[rev] = (uint16_t) ((len << 9) | i);
+		}
+	}
+
+	return 0;
+}
+
+/* Returns the decoded symbol or -1 on a bad code */
+static int inflateDecode(struct inflateState *state,
+	const struct inflateHuffman *huff)
+{
+	int len, code = 0, first = 0, index = 0;
+	uint16_t entry;
+
+	inflateFill(state, INFLATE_FAST_BITS);
+	entry = huff->fast[state->bit_buf & ((1 << INFLATE_FAST_BITS) - 1)];
+
+	if (entry != 0)
+	{
+		(void) inflateBits(state, entry >> 9);
+
+		return entry & 0x1FF;
+	}
+
+	for (len = 1; len <= INFLATE_MAX_BITS; len++)
+	{
+		const int count = huff->counts[len];
+
+		code |= (int) inflateBits(state, 1);
+
+		if (code - count < first)
+		{
+			return huff->symbols[index + (code - first)];
+		}
+
+		index += count;
+		first  = (first + count) << 1;
+		code <<= 1;
+	}
+
+	return -1;
+}
+
+static void inflateAdler(struct inflateState *state,
+	const unsigned char *data, size_t len)
+{
+	while (len > 0)
+	{
+		/* 5552 is the most that can be summed before a 32-bit
+		 * accumulator could overflow */
+		size_t run = (len < 5552) ? len : 5552;
+
+		len -= run;
+
+		for (; run > 0; run--)
+		{
+			state->adler_a += *data++;
+			state->adler_b += state->adler_a;
+		}
+
+		state->adler_a %= INFLATE_ADLER_MOD;
+		state->adler_b %= INFLATE_ADLER_MOD;
+	}
+}
+
+static int inflateFlush(struct inflateState *state)
+{
+	const unsigned char *data
+		= state->window + (state->flushed % INFLATE_WINDOW);
+	const size_t len = state->win_pos - state->flushed;
+
+	if (len == 0)
+	{
+		return 0;
+	}
+
+	inflateAdler(state, data, len);
+	state->flushed = state->win_pos;
+
+	return state->sink((const char *) data, len, state->ctx);
+}
+
+/* Returns non-zero if the sink asked to stop */
+static int inflatePut(struct inflateState *state, const unsigned char byte)
+{
+	state->window[state->win_pos++ % INFLATE_WINDOW] = byte;
+
+	return ((state->win_pos % INFLATE_WINDOW) == 0)
+		? inflateFlush(state) : 0;
+}
+
+static enum inflateResult inflateStored(struct inflateState *state)
+{
+	uint32_t len, nlen;
+
+	/* Stored blocks start on a byte boundary */
+	(void) inflateBits(state, state->bit_cnt & 7);
+	len  = inflateBits(state, 16);
+	nlen = inflateBits(state, 16);
+
+	if (state->overrun != 0)
+	{
+		return INFLATE_TRUNCATED;
+	}
+
+	if ((len ^ 0xFFFF) != nlen)
+	{
+		return INFLATE_BAD_DATA;
+	}
+
+	for (; len > 0; len--)
+	{
+		const uint32_t byte = inflateBits(state, 8);
+
+		if (state->overrun != 0)
+		{
+			return INFLATE_TRUNCATED;
+		}
+
+		if (inflatePut(state, (unsigned char) byte) != 0)
+		{
+			return INFLATE_STOPPED;
+		}
+	}
+
+	return INFLATE_OK;
+}
+
+static enum inflateResult inflateCodes(struct inflateState *state)
+{
+	for (;;)
+	{
+		int sym = inflateDecode(state, &state->lens);
+		unsigned long len, dist;
+
+		if (state->overrun != 0)
+		{
+			return INFLATE_TRUNCATED;
+		}
+
+		if (sym < 0)
+		{
+			return INFLATE_BAD_DATA;
+		}
+
+		if (sym < 256)
+		{
+			if (inflatePut(state, (unsigned char) sym) != 0)
+			{
+				return INFLATE_STOPPED;
+			}
+
+			continue;
+		}
+
+		if (sym == 256)
+		{
+			return INFLATE_OK;
+		}
+
+		if ((sym -= 257) >= 29)
+		{
+			return INFLATE_BAD_DATA;
+		}
+
+		len = length_base[sym] + inflateBits(state, length_extra[sym]);
+
+		if (((sym = inflateDecode(state, &state->dists)) < 0)
+		|| (sym >= 30))
+		{
+			return INFLATE_BAD_DATA;
+		}
+
+		dist = dist_base[sym] + inflateBits(state, dist_extra[sym]);
+
+		if (state->overrun != 0)
+		{
+			return INFLATE_TRUNCATED;
+		}
+
+		if ((dist > state->win_pos) || (dist > INFLATE_WINDOW))
+		{
+			return INFLATE_BAD_DATA;
+		}
+
+		/* Byte at a time since the source and destination may
+		 * overlap, which is how runs get encoded */
+		for (; len > 0; len--)
+		{
+			const unsigned char byte = state->window[
+				(state->win_pos - dist) % INFLATE_WINDOW];
+
+			if (inflatePut(state, byte) != 0)
+			{
+				return INFLATE_STOPPED;
+			}
+		}
+	}
+}
+
+static enum inflateResult inflateFixed(struct inflateState *state)
+{
+	uint8_t lengths[INFLATE_MAX_LCODES];
+	size_t i;
+
+	for (i = 0; i < 144; i++)
+	{
+		lengths[i] = 8;
+	}
+
+	for (; i < 256; i++)
+	{
+		lengths[i] = 9;
+	}
+
+	for (; i < 280; i++)
+	{
+		lengths[i] = 7;
+	}
+
+	for (; i < INFLATE_MAX_LCODES; i++)
+	{
+		lengths[i] = 8;
+	}
+
+	inflateBuild(&state->lens, lengths, INFLATE_MAX_LCODES);
+
+	for (i = 0; i < INFLATE_MAX_DCODES; i++)
+	{
+		lengths[i] = 5;
+	}
+
+	inflateBuild(&state->dists, lengths, INFLATE_MAX_DCODES);
+
+	return inflateCodes(state);
+}
+
+static enum inflateResult inflateDynamic(struct inflateState *state)
+{
+	static const uint8_t order[19] =
+	{
+		16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+	};
+	uint8_t lengths[INFLATE_MAX_LCODES + INFLATE_MAX_DCODES] = {0};
+	const size_t num_lens  = inflateBits(state, 5) + 257;
+	const size_t num_dists = inflateBits(state, 5) + 1;
+	const size_t num_codes = inflateBits(state, 4) + 4;
+	size_t i = 0;
+
+	if ((num_lens > INFLATE_MAX_LCODES) || (num_dists > INFLATE_MAX_DCODES))
+	{
+		return INFLATE_BAD_DATA;
+	}
+
+	for (i = 0; i < num_codes; i++)
+	{
+		lengths[order[i]] = (uint8_t) inflateBits(state, 3);
+	}
+
+	/* The code length code borrows the length table for a moment */
+	if (inflateBuild(&state->lens, lengths, 19) != 0)
+	{
+		return INFLATE_BAD_DATA;
+	}
+
+	memset(lengths, 0, sizeof(lengths));
+
+	for (i = 0; i < num_lens + num_dists;)
+	{
+		const int sym = inflateDecode(state, &state->lens);
+		uint8_t fill = 0;
+		size_t repeat;
+
+		if (state->overrun != 0)
+		{
+			return INFLATE_TRUNCATED;
+		}
+
+		if (sym < 0)
+		{
+			return INFLATE_BAD_DATA;
+		}
+
+		if (sym < 16)
+		{
+			lengths[i++] = (uint8_t) sym;
+
+			continue;
+		}
+
+		if (sym == 16)
+		{
+			if (i == 0)
+			{
+				return INFLATE_BAD_DATA;
+			}
+
+			fill   = lengths[i - 1];
+			repeat = 3 + inflateBits(state, 2);
+		}
+		else if (sym == 17)
+		{
+			repeat = 3 + inflateBits(state, 3);
+		}
+		else
+		{
+			repeat = 11 + inflateBits(state, 7);
+		}
+
+		if (i + repeat > num_lens + num_dists)
+		{
+			return INFLATE_BAD_DATA;
+		}
+
+		for (; repeat > 0; repeat--)
+		{
+			lengths[i++] = fill;
+		}
+	}
+
+	/* Without an end of block code the block could never finish */
+	if ((lengths[256] == 0)
+	|| (inflateBuild(&state->lens, lengths, num_lens) != 0)
+	|| (inflateBuild(&state->dists, lengths + num_lens, num_dists) != 0))
+	{
+		return INFLATE_BAD_DATA;
+	}
+
+	return inflateCodes(state);
+}
+
+/* Decompresses the len byte zlib stream at the current file position into
+ * sink, verifying the Adler-32 trailer unless the sink stops it early */
+enum inflateResult inflateZlibFile(FILE *fhandle, const size_t len,
+	INFLATE_SINK *sink, void *ctx)
+{
+	struct inflateState *state = NULL;
+	enum inflateResult ret = INFLATE_OK;
+	uint32_t cmf, flg, last = 0, adler = 0;
+	size_t i;
+
+	if ((fhandle == NULL) || (sink == NULL))
+	{
+		return INFLATE_BAD_DATA;
+	}
+
+	if ((state = malloc(sizeof(struct inflateState))) == NULL)
+	{
+		return INFLATE_NO_MEMORY;
+	}
+
+	memset(state, 0, offsetof(struct inflateState, in));
+	state->fhandle = fhandle;
+	state->in_left = len;
+	state->adler_a = 1;
+	state->sink    = sink;
+	state->ctx     = ctx;
+
+	cmf = inflateBits(state, 8);
+	flg = inflateBits(state, 8);
+
+	/* Deflate only, no preset dictionary, header checksum must hold */
+	if (state->overrun != 0)
+	{
+		ret = INFLATE_TRUNCATED;
+	}
+	else if (((cmf & 0x0F) != 8) || ((cmf >> 4) > 7)
+	|| ((flg & 0x20) != 0) || ((((cmf << 8) | flg) % 31) != 0))
+	{
+		ret = INFLATE_BAD_DATA;
+	}
+
+	while ((ret == INFLATE_OK) && (last == 0))
+	{
+		last = inflateBits(state, 1);
+
+		switch (inflateBits(state, 2))
+		{
+			case 0:
+				ret = inflateStored(state);
+				break;
+			case 1:
+				ret = inflateFixed(state);
+				break;
+			case 2:
+				ret = inflateDynamic(state);
+				break;
+			default:
+				ret = (state->overrun != 0)
+					? INFLATE_TRUNCATED : INFLATE_BAD_DATA;
+				break;
+		}
+	}
+
+	if ((ret == INFLATE_OK) && (inflateFlush(state) != 0))
+	{
+		ret = INFLATE_STOPPED;
+	}
+
+	if (ret == INFLATE_OK)
+	{
+		(void) inflateBits(state, state->bit_cnt & 7);
+
+		for (i = 0; i < 4; i++)
+		{
+			adler = (adler << 8) | inflateBits(state, 8);
+		}
+
+		if (state->overrun != 0)
+		{
+			ret = INFLATE_TRUNCATED;
+		}
+		else if (adler != ((state->adler_b << 16) | state->adler_a))
+		{
+			ret = INFLATE_BAD_DATA;
+		}
+	}
+
+	free(state);
+
+	return ret;
+}
+
+const char* inflateErrorString(const enum inflateResult result)
+{
+	switch (result)
+	{
+		case INFLATE_OK:
+			return "ok";
+		case INFLATE_STOPPED:
+			return "stopped early";
+		case INFLATE_BAD_DATA:
+			return "corrupt deflate stream";
+		case INFLATE_TRUNCATED:
+			return "truncated deflate stream";
+		case INFLATE_NO_MEMORY:
+			return "out of memory";
+		default:
+			return "unknown error";
+	}
+}
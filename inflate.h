@@ -0,0 +1,33 @@
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* Minimal streaming zlib/DEFLATE (RFC 1950/1951) decoder so compressed text
+ * chunks can be read without pulling in zlib. Memory use is fixed, the 32K 
+ * history window, a small input window, and the two decoding tables */
+
+#define INFLATE_WINDOW    32768
+#define INFLATE_IN_WINDOW 4096
+/* Codes at most this long decode with a single table lookup */
+#define INFLATE_FAST_BITS 9
+
+enum inflateResult
+{
+	INFLATE_OK = 0,
+	INFLATE_STOPPED,   /* The sink asked to stop early, not an error */
+	INFLATE_BAD_DATA,
+	INFLATE_TRUNCATED,
+	INFLATE_NO_MEMORY
+};
+
+/* Receives decompressed data as it leaves the window, returning non-zero
+ * stops decompression right there */
+typedef int (INFLATE_SINK)(const char *data, const size_t len, void *ctx);
+
+enum inflateResult inflateZlibFile(FILE *fhandle, const size_t len, 
+	INFLATE_SINK *sink, void *ctx);
+const char* inflateErrorString(const enum inflateResult result);
+
+#endif /* INFLATE_H */
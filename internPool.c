@@ -0,0 +1,231 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "internPool.h"
+
+/* FNV-1a */
+static uint32_t internHash(const char *str, const size_t len)
+{
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		hash = (hash ^ (unsigned char) str[i]) * 16777619u;
+	}
+
+	return hash;
+}
+
+/* Copies str into the arena with a terminating null byte so callers can
+ * hand it straight to the string functions, strings that won't fit in a
+ * block of their own get a block sized just for them */
+static const char* internStore(struct internPool *pool, const char *str,
+	const size_t len)
+{
+	struct internBlock *block = pool->blocks;
+	char *dst;
+
+	if ((block == NULL) || (block->cap - block->used < len + 1))
+	{
+		const size_t cap = (len + 1 > INTERN_BLOCK_LEN)
+			? len + 1 : INTERN_BLOCK_LEN;
+
+		if ((block = malloc(sizeof(struct internBlock) + cap)) == NULL)
+		{
+			return NULL;
+		}
+
+		block->used = 0;
+		block->cap  = cap;
+
+		/* A nearly full block stays at the head if this one is
+		 * only for a single oversized string */
+		if ((pool->blocks != NULL) && (cap > INTERN_BLOCK_LEN))
+		{
+			block->next = pool->blocks->next;
+			pool->blocks->next = block;
+		}
+		else
+		{
+			block->next  = pool->blocks;
+			pool->blocks = block;
+		}
+	}
+
+	dst = block->data + block->used;
+	memcpy(dst, str, len);
+	dst[len] = '\0';
+	block->used += len + 1;
+
+	return dst;
+}
+
+static int internGrow(struct internPool *pool)
+{
+	const size_t num_slots = (pool->num_slots == 0)
+		? INTERN_GUESS_LEN << 1 : pool->num_slots << 1;
+	uint32_t *slots = calloc(num_slots, sizeof(uint32_t));
+	uint32_t id;
+
+	if (slots == NULL)
+	{
+		return 1;
+	}
+
+	for (id = 0; id < pool->len; id++)
+	{
+		size_t slot = pool->entries[id].hash & (num_slots - 1);
+
+		while (slots[slot] != 0)
+		{
+			slot = (slot + 1) & (num_slots - 1);
+		}
+
+		slots[slot] = id + 1;
+	}
+
+	free(pool->slots);
+	pool->slots = slots;
+	pool->num_slots = num_slots;
+
+	return 0;
+}
+
+/* The id of str, adding it if it hasn't been seen before. Ids count up from
+ * 0 in the order strings were first added */
+int internString(struct internPool *pool, const char *str, const size_t len,
+	uint32_t *id)
+{
+	const uint32_t hash = internHash(str, len);
+	struct internEntry *entry;
+	size_t slot;
+
+	if ((pool == NULL) || (str == NULL) || (id == NULL)
+	|| (pool->len == INTERN_NONE - 1))
+	{
+		return 1;
+	}
+
+	/* Kept at most half full */
+	if ((((size_t) pool->len + 1) << 1 > pool->num_slots)
+	&& (internGrow(pool) != 0))
+	{
+		return 1;
+	}
+
+	for (slot = hash & (pool->num_slots - 1); pool->slots[slot] != 0;
+		slot = (slot + 1) & (pool->num_slots - 1))
+	{
+		entry = &pool->entries[pool->slots[slot] - 1];
+
+		if ((entry->hash == hash) && (entry->len == len)
+		&& (memcmp(entry->str, str, len) == 0))
+		{
+			*id = pool->slots[slot] - 1;
+
+			return 0;
+		}
+	}
+
+	if (pool->len == pool->cap)
+	{
+		const uint32_t new_cap = (pool->cap == 0)
+			? INTERN_GUESS_LEN : pool->cap << 1;
+		struct internEntry *tmp = realloc(pool->entries,
+			sizeof(struct internEntry) * new_cap);
+
+		if (tmp == NULL)
+		{
+			return 1;
+		}
+
+		pool->entries = tmp;
+		pool->cap = new_cap;
+	}
+
+	entry = &pool->entries[pool->len];
+
+	if ((entry->str = internStore(pool, str, len)) == NULL)
+	{
+		return 1;
+	}
+
+	entry->len  = len;
+	entry->hash = hash;
+	*id = pool->len++;
+	pool->slots[slot] = *id + 1;
+
+	return 0;
+}
+
+/* Like internString without adding anything, returns 1 if str isn't there */
+int internFind(const struct internPool *pool, const char *str, 
+	const size_t len, uint32_t *id)
+{
+	const uint32_t hash = internHash(str, len);
+	size_t slot;
+
+	if ((pool == NULL) || (pool->num_slots == 0))
+	{
+		return 1;
+	}
+
+	for (slot = hash & (pool->num_slots - 1); pool->slots[slot] != 0;
+		slot = (slot + 1) & (pool->num_slots - 1))
+	{
+		const struct internEntry *entry 
+			= &pool->entries[pool->slots[slot] - 1];
+
+		if ((entry->hash == hash) && (entry->len == len)
+		&& (memcmp(entry->str, str, len) == 0))
+		{
+			if (id != NULL)
+			{
+				*id = pool->slots[slot] - 1;
+			}
+
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* NULL for an id the pool never handed out */
+const char* internGet(const struct internPool *pool, const uint32_t id,
+	size_t *len)
+{
+	if ((pool == NULL) || (id >= pool->len))
+	{
+		return NULL;
+	}
+
+	if (len != NULL)
+	{
+		*len = pool->entries[id].len;
+	}
+
+	return pool->entries[id].str;
+}
+
+void internFree(struct internPool *pool)
+{
+	struct internBlock *block, *next;
+
+	if (pool == NULL)
+	{
+		return;
+	}
+
+	for (block = pool->blocks; block != NULL; block = next)
+	{
+		next = block->next;
+		free(block);
+	}
+
+	free(pool->entries);
+	free(pool->slots);
+	memset(pool, 0, sizeof(struct internPool));
+}
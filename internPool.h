@@ -0,0 +1,51 @@
+#ifndef INTERN_POOL_H
+#define INTERN_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Batch wide set of strings handing out small integer ids, so per image
+ * records can keep ids in place of their own copies of values that repeat
+ * across a whole library, and compare them without looking at the text.
+ * Strings live in large arena blocks and never move once added. A zeroed
+ * pool is ready for use */
+
+#define INTERN_BLOCK_LEN 65536
+#define INTERN_GUESS_LEN 256
+/* Never handed out, stands in for no string at all */
+#define INTERN_NONE      UINT32_MAX
+
+struct internBlock
+{
+	struct internBlock *next;
+	size_t used;
+	size_t cap;
+	char data[];
+};
+
+struct internEntry
+{
+	const char *str;
+	size_t len;
+	uint32_t hash;
+};
+
+struct internPool
+{
+	struct internBlock *blocks;
+	struct internEntry *entries;
+	uint32_t len;
+	uint32_t cap;
+	uint32_t *slots; /* id + 1, 0 for an empty slot */
+	size_t num_slots;
+};
+
+int internString(struct internPool *pool, const char *str, const size_t len,
+	uint32_t *id);
+int internFind(const struct internPool *pool, const char *str, 
+	const size_t len, uint32_t *id);
+const char* internGet(const struct internPool *pool, const uint32_t id,
+	size_t *len);
+void internFree(struct internPool *pool);
+
+#endif /* INTERN_POOL_H */
@@ -0,0 +1,189 @@
+#if defined(__linux__)
+#define _GNU_SOURCE
+#elif !defined(_WIN32)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else  /* POSIX */
+#include <time.h>
+#include <fcntl.h>
+#endif /* Platform Check */
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#include "ioThrottle.h"
+
+/* From linux/ioprio.h, which isn't always installed */
+#define IO_IOPRIO_WHO_PROCESS 1
+#define IO_IOPRIO_CLASS_IDLE  3
+#define IO_IOPRIO_CLASS_SHIFT 13
+
+struct ioBucket
+{
+	double rate; /* Per second, 0 for unlimited */
+	double tokens;
+};
+
+static struct
+{
+	struct ioBucket bytes;
+	struct ioBucket ops;
+	double last;
+	uint64_t file_bytes; /* Read from the file opened last */
+	int background;
+} io_state = {{0, 0}, {0, 0}, 0, 0, 0};
+
+static double ioNow(void)
+{
+#ifdef _WIN32
+	return (double) GetTickCount64() / 1000.0;
+#else  /* POSIX */
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+#endif /* Platform Check */
+}
+
+static void ioSleep(const double seconds)
+{
+#ifdef _WIN32
+	Sleep((DWORD) (seconds * 1000.0) + 1);
+#else  /* POSIX */
+	struct timespec wait;
+
+	wait.tv_sec = (time_t) seconds;
+	wait.tv_nsec = (long) ((seconds - (double) wait.tv_sec) * 1e9);
+
+	while ((nanosleep(&wait, &wait) != 0) && (errno == EINTR));
+#endif /* Platform Check */
+}
+
+/* Only as much I/O priority as the platform will give up, returns 1 if 
+ * there was no way to ask for it */
+static int ioIdlePriority(void)
+{
+#if defined(__linux__)
+	return (syscall(SYS_ioprio_set, IO_IOPRIO_WHO_PROCESS, 0, 
+		IO_IOPRIO_CLASS_IDLE << IO_IOPRIO_CLASS_SHIFT) != 0);
+#elif defined(_WIN32)
+	return (SetPriorityClass(GetCurrentProcess(), 
+		PROCESS_MODE_BACKGROUND_BEGIN) == 0);
+#else
+	return 1;
+#endif
+}
+
+/* Background asks for idle I/O priority and for each file to be dropped 
+ * from the page cache once it's done with */
+int ioThrottleSetup(const double bytes_per_sec, const double ops_per_sec,
+	const int background)
+{
+	memset(&io_state, 0, sizeof(io_state));
+	io_state.bytes.rate = io_state.bytes.tokens = bytes_per_sec;
+	io_state.ops.rate = io_state.ops.tokens = ops_per_sec;
+	io_state.last = ioNow();
+	io_state.background = background;
+
+	return (background != 0) ? ioIdlePriority() : 0;
+}
+
+static void ioRefill(struct ioBucket *bucket, const double elapsed)
+{
+	bucket->tokens += bucket->rate * elapsed;
+
+	if (bucket->tokens > bucket->rate)
+	{
+		bucket->tokens = bucket->rate;
+	}
+}
+
+static double ioDebt(const struct ioBucket *bucket)
+{
+	return ((bucket->rate == 0) || (bucket->tokens >= 0)) 
+		? 0 : -bucket->tokens / bucket->rate;
+}
+
+void ioCharge(const uint64_t bytes, const uint64_t ops)
+{
+	double now, wait;
+
+	if ((io_state.bytes.rate == 0) && (io_state.ops.rate == 0))
+	{
+		return;
+	}
+
+	now = ioNow();
+	ioRefill(&io_state.bytes, now - io_state.last);
+	ioRefill(&io_state.ops, now - io_state.last);
+	io_state.last = now;
+	io_state.bytes.tokens -= (double) bytes;
+	io_state.ops.tokens -= (double) ops;
+
+	wait = ioDebt(&io_state.bytes);
+	wait = (ioDebt(&io_state.ops) > wait) ? ioDebt(&io_state.ops) : wait;
+
+	if (wait > 0)
+	{
+		ioSleep(wait);
+	}
+}
+
+/* Lets the kernel drop the file's pages, when in the background and the 
+ * platform has a way to say so */
+void ioRelease(FILE *fhandle)
+{
+#ifdef POSIX_FADV_DONTNEED
+	if (io_state.background != 0)
+	{
+		posix_fadvise(fileno(fhandle), 0, 0, POSIX_FADV_DONTNEED);
+	}
+#else
+	(void) fhandle;
+#endif
+}
+
+void ioOpen(void)
+{
+	io_state.file_bytes = 0;
+	ioCharge(0, 1);
+}
+
+/* Charged for everything asked for whether or not it's all there, since 
+ * the charge has to come before the read, an operation each time the file
+ * crosses into the next IO_OP_BYTES */
+void ioChargeRead(const uint64_t bytes)
+{
+	const uint64_t ops_before 
+		= (io_state.file_bytes + IO_OP_BYTES - 1) / IO_OP_BYTES;
+
+	io_state.file_bytes += bytes;
+	ioCharge(bytes, (io_state.file_bytes + IO_OP_BYTES - 1) / IO_OP_BYTES
+		- ops_before);
+}
+
+size_t ioRead(void *dst, const size_t size, const size_t count, 
+	FILE *fhandle)
+{
+	ioChargeRead((uint64_t) size * count);
+
+	return fread(dst, size, count, fhandle);
+}
+
+int ioGetc(FILE *fhandle)
+{
+	ioChargeRead(1);
+
+	return fgetc(fhandle);
+}
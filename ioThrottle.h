@@ -0,0 +1,26 @@
+#ifndef IO_THROTTLE_H
+#define IO_THROTTLE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Process wide limits on how hard reading hits the disk, for sweeping 
+ * storage other jobs are busy with. Every open and read is paid for up 
+ * front out of token buckets for bytes and for operations, each holding a
+ * second's worth, and once either runs dry the charge sleeps off the debt
+ * before the read goes ahead. An operation is an open or each further 
+ * IO_OP_BYTES of the file read. A rate of 0 is no limit */
+
+#define IO_OP_BYTES 65536
+
+int ioThrottleSetup(const double bytes_per_sec, const double ops_per_sec,
+	const int background);
+void ioCharge(const uint64_t bytes, const uint64_t ops);
+void ioOpen(void);
+void ioChargeRead(const uint64_t bytes);
+size_t ioRead(void *dst, const size_t size, const size_t count, 
+	FILE *fhandle);
+int ioGetc(FILE *fhandle);
+void ioRelease(FILE *fhandle);
+
+#endif /* IO_THROTTLE_H */
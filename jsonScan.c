@@ -0,0 +1,532 @@
+/* A small state machine JSON scanner, fed however much input is at hand and
+ * calling back for every structural event. It never builds a tree, skipped
+ * values are stepped over by keeping count of the brackets, only lexing
+ * strings far enough to not be fooled by brackets inside of them */
+#include <string.h>
+
+#include "jsonScan.h"
+
+#define JSON_REPLACEMENT 0xFFFD
+
+enum jsonState
+{
+	SCAN_VALUE = 0,    /* Expecting any value */
+	SCAN_VALUE_OR_END, /* Just after '[' */
+	SCAN_KEY_OR_END,   /* Just after '{' */
+	SCAN_KEY,          /* After a ',' inside an object */
+	SCAN_COLON,
+	SCAN_AFTER_VALUE,
+	SCAN_STRING,
+	SCAN_ESCAPE,
+	SCAN_UNICODE,
+	SCAN_LITERAL,
+	SCAN_DONE
+};
+
+static int jsonIsSpace(const char ch)
+{
+	return (ch == ' ') || (ch == '\t') || (ch == '\n') || (ch == '\r');
+}
+
+static int jsonIsLiteral(const char ch)
+{
+	return ((ch >= '0') && (ch <= '9')) || ((ch >= 'a') && (ch <= 'z'))
+		|| (ch == '-') || (ch == '+') || (ch == '.') || (ch == 'E');
+}
+
+static void jsonEmit(struct jsonScanner *scan, const enum jsonEvent event,
+	const char *str, const size_t len, const size_t depth)
+{
+	if ((scan->muted != 0) || (scan->status != JSON_OK))
+	{
+		return;
+	}
+
+	switch (scan->callback(event, str, len, depth, scan->ctx))
+	{
+		case JSON_STOP:
+			scan->status = JSON_STOPPED;
+			break;
+		case JSON_SKIP:
+			if (event == JSON_KEY)
+			{
+				scan->skip_next = 1;
+			}
+			else if ((event == JSON_OBJECT_BEGIN)
+			|| (event == JSON_ARRAY_BEGIN))
+			{
+				scan->muted = 1;
+				scan->mute_depth = depth - 1;
+			}
+
+			break;
+		case JSON_CONTINUE: /* fallthrough */
+		default:
+			break;
+	}
+}
+
+static void jsonBeginValue(struct jsonScanner *scan)
+{
+	if (scan->skip_next != 0)
+	{
+		scan->skip_next  = 0;
+		scan->muted      = 1;
+		scan->mute_depth = scan->depth;
+	}
+}
+
+static void jsonEndValue(struct jsonScanner *scan)
+{
+	if ((scan->muted != 0) && (scan->depth == scan->mute_depth))
+	{
+		scan->muted = 0;
+	}
+
+	scan->state = (scan->depth == 0) ? SCAN_DONE : SCAN_AFTER_VALUE;
+}
+
+/* Keys that don't fit are truncated, values are flushed as parts */
+static void jsonAppend(struct jsonScanner *scan, const char *str,
+	size_t len)
+{
+	if (scan->muted != 0)
+	{
+		return;
+	}
+
+	while (len > 0)
+	{
+		size_t room = JSON_TOKEN_MAX - scan->token_len;
+
+		if (room == 0)
+		{
+			if (scan->is_key != 0)
+			{
+				return;
+			}
+
+			jsonEmit(scan, JSON_STRING_PART, scan->token,
+				scan->token_len, scan->depth);
+			scan->token_len = 0;
+			room = JSON_TOKEN_MAX;
+		}
+
+		room = (room < len) ? room : len;
+		memcpy(scan->token + scan->token_len, str, room);
+		scan->token_len += room;
+		str += room;
+		len -= room;
+	}
+}
+
+static void jsonAppendUtf8(struct jsonScanner *scan, unsigned long cp)
+{
+	char bytes[4];
+	size_t len;
+
+	if (cp < 0x80)
+	{
+		bytes[0] = (char) cp;
+		len = 1;
+	}
+	else if (cp < 0x800)
+	{
+		bytes[0] = (char) (0xC0 | (cp >> 6));
+		bytes[1] = (char) (0x80 | (cp & 0x3F));
+		len = 2;
+	}
+	else if (cp < 0x10000)
+	{
+		bytes[0] = (char) (0xE0 | (cp >> 12));
+		bytes[1] = (char) (0x80 | ((cp >> 6) & 0x3F));
+		bytes[2] = (char) (0x80 | (cp & 0x3F));
+		len = 3;
+	}
+	else
+	{
+		bytes[0] = (char) (0xF0 | (cp >> 18));
+		bytes[1] = (char) (0x80 | ((cp >> 12) & 0x3F));
+		bytes[2] = (char) (0x80 | ((cp >> 6) & 0x3F));
+		bytes[3] = (char) (0x80 | (cp & 0x3F));
+		len = 4;
+	}
+
+	jsonAppend(scan, bytes, len);
+}
+
+/* A high surrogate only means something if a low one follows right away */
+static void jsonFlushSurrogate(struct jsonScanner *scan)
+{
+	if (scan->high_surrogate != 0)
+	{
+		scan->high_surrogate = 0;
+		jsonAppendUtf8(scan, JSON_REPLACEMENT);
+	}
+}
+
+static void jsonCodePoint(struct jsonScanner *scan, unsigned long cp)
+{
+	if ((cp >= 0xD800) && (cp <= 0xDBFF))
+	{
+		jsonFlushSurrogate(scan);
+		scan->high_surrogate = cp;
+
+		return;
+	}
+
+	if ((cp >= 0xDC00) && (cp <= 0xDFFF))
+	{
+		cp = (scan->high_surrogate == 0) ? JSON_REPLACEMENT
+			: 0x10000 + ((scan->high_surrogate - 0xD800) << 10)
+				+ (cp - 0xDC00);
+		scan->high_surrogate = 0;
+	}
+	else
+	{
+		jsonFlushSurrogate(scan);
+	}
+
+	jsonAppendUtf8(scan, cp);
+}
+
+static void jsonPush(struct jsonScanner *scan, const char kind)
+{
+	if (scan->depth == JSON_MAX_DEPTH)
+	{
+		scan->status = JSON_ERROR;
+
+		return;
+	}
+
+	scan->stack[scan->depth++] = kind;
+	jsonEmit(scan, (kind == '{') ? JSON_OBJECT_BEGIN : JSON_ARRAY_BEGIN,
+		NULL, 0, scan->depth);
+	scan->state = (kind == '{') ? SCAN_KEY_OR_END : SCAN_VALUE_OR_END;
+}
+
+static void jsonPop(struct jsonScanner *scan, const char closer)
+{
+	const char kind = (closer == '}') ? '{' : '[';
+
+	if ((scan->depth == 0) || (scan->stack[scan->depth - 1] != kind))
+	{
+		scan->status = JSON_ERROR;
+
+		return;
+	}
+
+	jsonEmit(scan, (kind == '{') ? JSON_OBJECT_END : JSON_ARRAY_END,
+		NULL, 0, scan->depth);
+	scan->depth--;
+	jsonEndValue(scan);
+}
+
+static void jsonStartValue(struct jsonScanner *scan, const char ch)
+{
+	if ((ch == '{') || (ch == '['))
+	{
+		jsonBeginValue(scan);
+		jsonPush(scan, ch);
+	}
+	else if (ch == '"')
+	{
+		jsonBeginValue(scan);
+		scan->is_key    = 0;
+		scan->token_len = 0;
+		scan->state     = SCAN_STRING;
+	}
+	else if ((ch == '-') || ((ch >= '0') && (ch <= '9'))
+	|| (ch == 't') || (ch == 'f') || (ch == 'n'))
+	{
+		jsonBeginValue(scan);
+		scan->token[0]  = ch;
+		scan->token_len = 1;
+		scan->state     = SCAN_LITERAL;
+	}
+	else
+	{
+		scan->status = JSON_ERROR;
+	}
+}
+
+static void jsonStartKey(struct jsonScanner *scan, const char ch)
+{
+	if (ch != '"')
+	{
+		scan->status = JSON_ERROR;
+
+		return;
+	}
+
+	scan->is_key    = 1;
+	scan->token_len = 0;
+	scan->state     = SCAN_STRING;
+}
+
+static void jsonEndLiteral(struct jsonScanner *scan)
+{
+	const char first = scan->token[0];
+
+	jsonEmit(scan, ((first == 't') || (first == 'f') || (first == 'n'))
+		? JSON_LITERAL : JSON_NUMBER, scan->token, scan->token_len,
+		scan->depth);
+	scan->token_len = 0;
+	jsonEndValue(scan);
+}
+
+/* Returns how much of data was used, strings are consumed in bulk */
+static size_t jsonString(struct jsonScanner *scan, const char *data,
+	const size_t len)
+{
+	size_t i;
+
+	for (i = 0; (i < len) && (data[i] != '"') && (data[i] != '\\'); i++);
+
+	if (i != 0)
+	{
+		jsonFlushSurrogate(scan);
+		jsonAppend(scan, data, i);
+	}
+
+	if (i == len)
+	{
+		return i;
+	}
+
+	if (data[i] == '\\')
+	{
+		scan->state = SCAN_ESCAPE;
+
+		return i + 1;
+	}
+
+	jsonFlushSurrogate(scan);
+
+	if (scan->is_key != 0)
+	{
+		jsonEmit(scan, JSON_KEY, scan->token, scan->token_len,
+			scan->depth);
+		scan->state = SCAN_COLON;
+	}
+	else
+	{
+		jsonEmit(scan, JSON_STRING, scan->token, scan->token_len,
+			scan->depth);
+		jsonEndValue(scan);
+	}
+
+	scan->token_len = 0;
+
+	return i + 1;
+}
+
+static void jsonEscape(struct jsonScanner *scan, const char ch)
+{
+	const char *from = "\"\\/bfnrt";
+	const char *to   = "\"\\/\b\f\n\r\t";
+	const char *hit  = NULL;
+
+	scan->state = SCAN_STRING;
+
+	if (ch == 'u')
+	{
+		scan->hex_left   = 4;
+		scan->code_point = 0;
+		scan->state      = SCAN_UNICODE;
+
+		return;
+	}
+
+	if ((ch == '\0') || ((hit = strchr(from, ch)) == NULL))
+	{
+		scan->status = JSON_ERROR;
+
+		return;
+	}
+
+	jsonFlushSurrogate(scan);
+	jsonAppend(scan, to + (hit - from), 1);
+}
+
+static void jsonHexDigit(struct jsonScanner *scan, const char ch)
+{
+	unsigned long value;
+
+	if ((ch >= '0') && (ch <= '9'))
+	{
+		value = (unsigned long) (ch - '0');
+	}
+	else if ((ch >= 'a') && (ch <= 'f'))
+	{
+		value = (unsigned long) (ch - 'a' + 10);
+	}
+	else if ((ch >= 'A') && (ch <= 'F'))
+	{
+		value = (unsigned long) (ch - 'A' + 10);
+	}
+	else
+	{
+		scan->status = JSON_ERROR;
+
+		return;
+	}
+
+	scan->code_point = (scan->code_point << 4) | value;
+
+	if (--scan->hex_left == 0)
+	{
+		jsonCodePoint(scan, scan->code_point);
+		scan->state = SCAN_STRING;
+	}
+}
+
+static void jsonStructural(struct jsonScanner *scan, const char ch)
+{
+	switch (scan->state)
+	{
+		case SCAN_VALUE_OR_END:
+			if (ch == ']')
+			{
+				jsonPop(scan, ch);
+
+				break;
+			}
+
+			jsonStartValue(scan, ch);
+			break;
+		case SCAN_VALUE:
+			jsonStartValue(scan, ch);
+			break;
+		case SCAN_KEY_OR_END:
+			if (ch == '}')
+			{
+				jsonPop(scan, ch);
+
+				break;
+			}
+
+			jsonStartKey(scan, ch);
+			break;
+		case SCAN_KEY:
+			jsonStartKey(scan, ch);
+			break;
+		case SCAN_COLON:
+			if (ch != ':')
+			{
+				scan->status = JSON_ERROR;
+			}
+
+			scan->state = SCAN_VALUE;
+			break;
+		case SCAN_AFTER_VALUE:
+			if (ch == ',')
+			{
+				scan->state = (scan->stack[scan->depth - 1]
+					== '{') ? SCAN_KEY : SCAN_VALUE;
+			}
+			else if ((ch == '}') || (ch == ']'))
+			{
+				jsonPop(scan, ch);
+			}
+			else
+			{
+				scan->status = JSON_ERROR;
+			}
+
+			break;
+		case SCAN_DONE: /* fallthrough */
+		default:
+			scan->status = JSON_ERROR;
+			break;
+	}
+}
+
+void jsonInit(struct jsonScanner *scan, JSON_CB *callback, void *ctx)
+{
+	memset(scan, 0, sizeof(struct jsonScanner));
+	scan->callback = callback;
+	scan->ctx      = ctx;
+	scan->state    = SCAN_VALUE;
+	scan->status   = JSON_OK;
+}
+
+enum jsonStatus jsonFeed(struct jsonScanner *scan, const char *data,
+	const size_t len)
+{
+	size_t i = 0;
+
+	if ((scan == NULL) || (data == NULL))
+	{
+		return JSON_ERROR;
+	}
+
+	while ((i < len) && (scan->status == JSON_OK))
+	{
+		const char ch = data[i];
+
+		switch (scan->state)
+		{
+			case SCAN_STRING:
+				i += jsonString(scan, data + i, len - i);
+				break;
+			case SCAN_ESCAPE:
+				jsonEscape(scan, ch);
+				i++;
+				break;
+			case SCAN_UNICODE:
+				jsonHexDigit(scan, ch);
+				i++;
+				break;
+			case SCAN_LITERAL:
+				if (jsonIsLiteral(ch) == 0)
+				{
+					/* Not consumed, it's whatever comes
+					 * after the literal */
+					jsonEndLiteral(scan);
+				}
+				else if (scan->token_len == JSON_TOKEN_MAX)
+				{
+					scan->status = JSON_ERROR;
+				}
+				else
+				{
+					scan->token[scan->token_len++] = ch;
+					i++;
+				}
+
+				break;
+			default:
+				if (jsonIsSpace(ch) == 0)
+				{
+					jsonStructural(scan, ch);
+				}
+
+				i++;
+				break;
+		}
+	}
+
+	return (enum jsonStatus) scan->status;
+}
+
+/* A lone top level number has no terminator of its own */
+enum jsonStatus jsonFinish(struct jsonScanner *scan)
+{
+	if (scan == NULL)
+	{
+		return JSON_ERROR;
+	}
+
+	if ((scan->status == JSON_OK) && (scan->state == SCAN_LITERAL))
+	{
+		jsonEndLiteral(scan);
+	}
+
+	if ((scan->status == JSON_OK) && (scan->state != SCAN_DONE))
+	{
+		scan->status = JSON_ERROR;
+	}
+
+	return (enum jsonStatus) scan->status;
+}
@@ -0,0 +1,73 @@
+#ifndef JSON_SCAN_H
+#define JSON_SCAN_H
+
+#include <stddef.h>
+
+/* Streaming SAX style JSON scanner, input may arrive in pieces of any size 
+ * and nothing is allocated, everything lives in the scanner struct. Strings
+ * longer than JSON_TOKEN_MAX are handed over as several JSON_STRING_PART 
+ * events followed by a final JSON_STRING, keys that long are truncated */
+
+#define JSON_MAX_DEPTH 64
+#define JSON_TOKEN_MAX 256
+
+enum jsonEvent
+{
+	JSON_OBJECT_BEGIN = 0,
+	JSON_OBJECT_END,
+	JSON_ARRAY_BEGIN,
+	JSON_ARRAY_END,
+	JSON_KEY,
+	JSON_STRING_PART,
+	JSON_STRING,
+	JSON_NUMBER,
+	JSON_LITERAL /* true, false, or null */
+};
+
+/* Returning JSON_SKIP from a key skips that key's value, from the start of 
+ * an object or array it skips the rest of it. Skipped values are only 
+ * scanned far enough to find their end, no events are raised for them */
+enum jsonAction
+{
+	JSON_CONTINUE = 0,
+	JSON_SKIP,
+	JSON_STOP
+};
+
+enum jsonStatus
+{
+	JSON_OK = 0,
+	JSON_STOPPED,
+	JSON_ERROR
+};
+
+/* depth is the number of open containers holding the event, an object's 
+ * begin and end events are given the depth of its own keys */
+typedef enum jsonAction (JSON_CB)(const enum jsonEvent event, 
+	const char *str, const size_t len, const size_t depth, void *ctx);
+
+struct jsonScanner
+{
+	JSON_CB *callback;
+	void *ctx;
+	int state;
+	int status;
+	size_t depth;
+	char stack[JSON_MAX_DEPTH];
+	char token[JSON_TOKEN_MAX];
+	size_t token_len;
+	int is_key;
+	int hex_left;
+	unsigned long code_point;
+	unsigned long high_surrogate;
+	int skip_next;
+	int muted;
+	size_t mute_depth;
+};
+
+void jsonInit(struct jsonScanner *scan, JSON_CB *callback, void *ctx);
+enum jsonStatus jsonFeed(struct jsonScanner *scan, const char *data, 
+	const size_t len);
+enum jsonStatus jsonFinish(struct jsonScanner *scan);
+
+#endif /* JSON_SCAN_H */
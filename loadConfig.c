@@ -52,7 +52,8 @@ static void cfgCallback(const char *key, const char *val, void *data)
 		{"lora-dir",  args->lora_path},
 		{"bin-dir",   args->bin_path},
 		{"vae-path",  args->vae_path},
-		{"exe-name",  args->exe_name}
+		{"exe-name",  args->exe_name},
+		{"template",  args->template_text}
 	};
 	const size_t lookup_len 
 		= sizeof(lookup_table) / sizeof(lookup_table[0]);
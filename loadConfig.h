@@ -11,6 +11,7 @@ struct cfgArguments
 	char **bin_path;
 	char **exe_name;
 	STI_BOOL *abrv;
+	char **template_text;
 };
 
 int loadDefaultFile(struct cfgArguments *args, char *alt_path);
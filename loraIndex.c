@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "internPool.h"
+#include "dirList.h"
+#include "loraIndex.h"
+
+#define LORA_TAG "<lora:"
+#define LORA_TAG_LEN (sizeof(LORA_TAG) - 1)
+
+/* What sd tries, in the same order, when applying a LoRA by name */
+static const char *const lora_exts[] = {".safetensors", ".ckpt"};
+
+#define LORA_NUM_EXTS (sizeof(lora_exts) / sizeof(lora_exts[0]))
+
+static int loraIndexFile(const char *file, void *ctx)
+{
+	struct loraIndex *index = (struct loraIndex *) ctx;
+	const size_t len = strlen(file);
+	size_t i;
+
+	for (i = 0; i < LORA_NUM_EXTS; i++)
+	{
+		const size_t ext_len = strlen(lora_exts[i]);
+		uint32_t id;
+
+		if ((len > ext_len) 
+		&& (strcmp(file + len - ext_len, lora_exts[i]) == 0))
+		{
+			return internString(&index->names, file, len - ext_len,
+				&id);
+		}
+	}
+
+	return 0;
+}
+
+int loraIndexBuild(struct loraIndex *index, const char *dir)
+{
+	memset(index, 0, sizeof(struct loraIndex));
+
+	return dirList(dir, loraIndexFile, index);
+}
+
+int loraIndexHas(const struct loraIndex *index, const char *name, 
+	const size_t len)
+{
+	return (internFind(&index->names, name, len, NULL) == 0);
+}
+
+/* Finds the next tag at or past *pos, taking the same <lora:name:weight> 
+ * form sd does, and leaves *pos just past it. Returns 1 once there are no 
+ * more */
+int loraNextTag(const char *prompt, const size_t len, size_t *pos, 
+	const char **name, size_t *name_len)
+{
+	const char *start;
+
+	while ((*pos < len) && ((start = memchr(prompt + *pos, '<', 
+		len - *pos)) != NULL))
+	{
+		size_t i = (size_t) (start - prompt) + LORA_TAG_LEN;
+		size_t name_end, weight_end;
+
+		*pos = (size_t) (start - prompt) + 1;
+
+		if ((i > len) || (memcmp(start, LORA_TAG, LORA_TAG_LEN) != 0))
+		{
+			continue;
+		}
+
+		for (name_end = i; (name_end < len) && (prompt[name_end] != ':')
+			&& (prompt[name_end] != '>'); name_end++);
+
+		if ((name_end == i) || (name_end == len) 
+		|| (prompt[name_end] != ':'))
+		{
+			continue;
+		}
+
+		for (weight_end = name_end + 1; (weight_end < len) 
+			&& (prompt[weight_end] != '>'); weight_end++);
+
+		if ((weight_end == len) || (weight_end == name_end + 1))
+		{
+			continue;
+		}
+
+		*name = prompt + i;
+		*name_len = name_end - i;
+		*pos = weight_end + 1;
+
+		return 0;
+	}
+
+	return 1;
+}
+
+void loraIndexFree(struct loraIndex *index)
+{
+	if (index == NULL)
+	{
+		return;
+	}
+
+	internFree(&index->names);
+}
@@ -0,0 +1,25 @@
+#ifndef LORA_INDEX_H
+#define LORA_INDEX_H
+
+#include <stddef.h>
+
+#include "internPool.h"
+
+/* Names of the LoRAs sd would be able to load out of --lora-model-dir, that
+ * is every file in it with one of the extensions sd looks for, minus the 
+ * extension. The directory is only listed once, checking a prompt's 
+ * <lora:name:weight> tags after that is a hash lookup per tag */
+
+struct loraIndex
+{
+	struct internPool names;
+};
+
+int loraIndexBuild(struct loraIndex *index, const char *dir);
+int loraIndexHas(const struct loraIndex *index, const char *name, 
+	const size_t len);
+int loraNextTag(const char *prompt, const size_t len, size_t *pos, 
+	const char **name, size_t *name_len);
+void loraIndexFree(struct loraIndex *index);
+
+#endif /* LORA_INDEX_H */
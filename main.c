@@ -2,12 +2,32 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include "portopt.h"
 #include "portegg.h"
 #include "stiTokenizer.h"
 #include "pngProcessing.h"
 #include "loadConfig.h"
+#include "outputBuffer.h"
+#include "scriptOutput.h"
+#include "inflate.h"
+#include "comfyPrompt.h"
+#include "imageProcessing.h"
+#include "catalog.h"
+#include "paramValues.h"
+#include "summary.h"
+#include "termSketch.h"
+#include "promptCluster.h"
+#include "pixelHash.h"
+#include "shardMerge.h"
+#include "sortRuns.h"
+#include "loraIndex.h"
+#include "modelIndex.h"
+#include "ioThrottle.h"
+#include "shellQuote.h"
+#include "outputTemplate.h"
+#include "traceEvents.h"
 
 /* Arguments that may be modified by command line switches or .cfg file */
 char *model_path    = NULL;
@@ -16,15 +36,56 @@ char *vae_path      = NULL;
 char *bin_path      = NULL;
 char *exe_name      = NULL;
 STI_BOOL abrv_flags = STI_FALSE;
+enum pngLayout text_layout = PNG_LAYOUT_ANY;
+enum shellStyle quote_style = SHELL_DOUBLE;
+char *template_text = NULL;
 
-typedef void (PrintFunc)(const char *str, const size_t len);
+/* --template compiled, no ops means the usual output */
+static struct outputTemplate output_template;
 
-static void printLen(const char *str, const size_t len);
-static void printQuote(const char *str, const size_t len);
-static void printSize(const char *str, const size_t len);
-static void printModel(const char *str, const size_t len);
-static void printVAE(const char *str, const size_t len);
-static void printLoRA(const char *str, const size_t len);
+#define FIELDS_MAX 16
+
+/* Labels asked for with --fields in the order given, everything processTokens
+ * knows about is read when there are none */
+static const char *field_labels[FIELDS_MAX];
+static size_t num_fields = 0;
+
+/* The LoRA and model directories are only listed the first time an image 
+ * needs them */
+enum dirState
+{
+	DIR_UNLISTED = 0,
+	DIR_LISTED,
+	DIR_UNREADABLE
+};
+
+static enum dirState lora_state = DIR_UNLISTED;
+static struct loraIndex lora_index;
+static enum dirState model_state = DIR_UNLISTED;
+static struct modelIndex model_index;
+/* The image's own size, from IHDR, when it has to stand in for a Size that's
+ * missing or wrong */
+static struct pngHeader image_header;
+static STI_BOOL use_header = STI_FALSE;
+/* The image's "Model hash" if it has one, for printModel */
+static const char *model_hash = NULL;
+static size_t model_hash_len = 0;
+
+typedef void (PrintFunc)(struct outputBuffer *out, const char *str, 
+	const size_t len);
+
+static void printLen(struct outputBuffer *out, const char *str, 
+	const size_t len);
+static void printQuote(struct outputBuffer *out, const char *str, 
+	const size_t len);
+static void printSize(struct outputBuffer *out, const char *str, 
+	const size_t len);
+static void printModel(struct outputBuffer *out, const char *str, 
+	const size_t len);
+static void printVAE(struct outputBuffer *out, const char *str, 
+	const size_t len);
+static void printLoRA(struct outputBuffer *out, const char *str, 
+	const size_t len);
 
 struct paramHashNode
 {
@@ -64,8 +125,10 @@ static const char* chomp(const char *str)
 }
 
 /* Chomped substring print but it's important to increment i so just using
- * the above chomp function wouldn't be enough */
-static void printLen(const char *str, const size_t len)
+ * the above chomp function wouldn't be enough. The value came out of the
+ * image so it's quoted if the shell would do anything with it */
+static void printLen(struct outputBuffer *out, const char *str, 
+	const size_t len)
 {
 	size_t i;
 
@@ -76,34 +139,78 @@ static void printLen(const char *str, const size_t len)
 
 	for (i = 0; (i < len) && (str[i] == ' ' || str[i] == '\t'); i++);
 
-	for (; i < len; i++)
+	shellQuoteWord(out, str + i, len - i, quote_style);
+}
+
+static void printQuote(struct outputBuffer *out, const char *str, 
+	const size_t len)
+{
+	size_t i;
+
+	if (str == NULL)
 	{
-		fputc(str[i], stdout);	
+		return;
 	}
+
+	for (i = 0; (i < len) && (str[i] == ' ' || str[i] == '\t'); i++);
+
+	shellQuote(out, str + i, len - i, quote_style);
 }
 
-static void printQuote(const char *str, const size_t len)
+/* The name of the file in model_path the image's model really is, NULL 
+ * to go with what the image says */
+static const char* resolveModel(const char *str, size_t len)
 {
-	fputc('"', stdout);
-	printLen(str, len);
-	fputc('"', stdout);
+	if (model_state == DIR_UNREADABLE)
+	{
+		return NULL;
+	}
+
+	if ((model_state == DIR_UNLISTED)
+	&& (modelIndexBuild(&model_index, model_path) != 0))
+	{
+		fprintf(stderr, "Unable to list model directory %s, models "
+			"won't be checked\n", model_path);
+		model_state = DIR_UNREADABLE;
+
+		return NULL;
+	}
+
+	model_state = DIR_LISTED;
+	str = paramTrim(str, &len);
+
+	return modelIndexResolve(&model_index, str, len, model_hash, 
+		model_hash_len);
 }
 
-static void printModel(const char *str, const size_t len)
+static void printModel(struct outputBuffer *out, const char *str, 
+	const size_t len)
 {
+	const char *name = NULL;
+
 	if (model_path != NULL)
 	{
-		fputs(model_path, stdout);
+		outputPuts(out, model_path);
+		name = resolveModel(str, len);
 	}
 
-	printLen(str, len);
+	if (name != NULL)
+	{
+		shellQuoteWord(out, name, strlen(name), quote_style);
+	}
+	else
+	{
+		printLen(out, str, len);
+	}
 
 	return;
 }
 
 /* XXX: Won't be called as the encoded name is not in use */
-static void printVAE(const char *str, const size_t len)
+static void printVAE(struct outputBuffer *out, const char *str, 
+	const size_t len)
 {
+	(void) out;
 	(void) str;
 	(void) len;
 
@@ -111,35 +218,51 @@ static void printVAE(const char *str, const size_t len)
 }
 
 /* XXX: Won't be called as the encoded name is not in use */
-static void printLoRA(const char *str, const size_t len)
+static void printLoRA(struct outputBuffer *out, const char *str, 
+	const size_t len)
 {
+	(void) out;
 	(void) str;
 	(void) len;
 
 	return;
 }
 
-static void printSize(const char *str, const size_t len)
+static void printU32(struct outputBuffer *out, uint32_t val)
 {
-	size_t tmp;
+	char digits[10];
+	size_t i = sizeof(digits);
 
-	if (str != NULL)
+	do
 	{
-		for (tmp = 0; (tmp < len) && (str[tmp] != 'x'); tmp++);
+		digits[--i] = (char) ('0' + val % 10);
+		val /= 10;
+	} while (val != 0);
 
-		if (tmp == len) /* Bad token */
-		{
-			return;
-		}
+	outputAppend(out, digits + i, sizeof(digits) - i);
+}
+
+static void printSize(struct outputBuffer *out, const char *str, 
+	const size_t len)
+{
+	struct paramValues size = {0};
 
-		fputs((abrv_flags == STI_TRUE) ? "-W " : "--width ", stdout);
-		printLen(str, tmp);
-		tmp++;
-		fputs((abrv_flags == STI_TRUE) ? " -H " : " --height ",stdout);
-		printLen(str + tmp, len - tmp);
+	if (use_header == STI_TRUE)
+	{
+		size.width  = image_header.width;
+		size.height = image_header.height;
+	}
+	/* Bad tokens are reported along with the rest of the values */
+	else if ((str == NULL) 
+	|| (paramDecode(&size, "Size", str, len) != 0))
+	{
+		return;
 	}
 
-	return;
+	outputPuts(out, (abrv_flags == STI_TRUE) ? "-W " : "--width ");
+	printU32(out, size.width);
+	outputPuts(out, (abrv_flags == STI_TRUE) ? " -H " : " --height ");
+	printU32(out, size.height);
 }
 
 /* Daniel J. Bernstein hashing algorithm */
@@ -241,20 +364,93 @@ static void dumpHashtable(void)
 
 #define LABEL_LIM 63
 
-/* Process all the tokens in FIFO order */
-static void processTokens(const char *buffer, const struct stiToken *stack,
-	const size_t depth)
+/* Records where a value lands in the output so batch modes can group on it
+ * without having to re-parse the formatted command */
+static void markSpan(struct scriptSpan *span, const size_t start, 
+	const size_t end)
+{
+	span->start = start;
+	span->len   = end - start;
+}
+
+/* Copies out the label ahead of a token's colon, returns where the value
+ * starts just past the colon or 0 if there's no label */
+static size_t tokenLabel(const char *substr, char *label)
+{
+	size_t j;
+
+	for (j = 0; j < LABEL_LIM && substr[j] != ':'; j++)
+	{
+		label[j] = substr[j];
+	}
+
+	label[j] = '\0';
+	j++; /* Just skip over that colon */
+
+	return (j >= LABEL_LIM) ? 0 : j;
+}
+
+/* The trimmed value of the first token under label, NULL if there's none */
+static const char* findValue(const char *buffer, 
+	const struct stiToken *tokens, const size_t num_tokens, 
+	const char *label, size_t *len)
+{
+	size_t i;
+
+	for (i = 0; i < num_tokens; i++)
+	{
+		const char *substr = buffer + tokens[i].token_start;
+		const size_t token_len 
+			= tokens[i].token_end - tokens[i].token_start;
+		char found[LABEL_LIM + 1];
+		const size_t j = tokenLabel(substr, found);
+
+		if ((j != 0) && (j <= token_len) 
+		&& (strcmp(chomp(found), label) == 0))
+		{
+			*len = token_len - j;
+
+			return paramTrim(substr + j, len);
+		}
+	}
+
+	return NULL;
+}
+
+/* Overrides whatever Size decoded to, if anything */
+static void headerValues(struct paramValues *values)
+{
+	const uint32_t size_bits 
+		= PARAM_BIT(PARAM_WIDTH) | PARAM_BIT(PARAM_HEIGHT);
+
+	if (use_header == STI_TRUE)
+	{
+		values->width      = image_header.width;
+		values->height     = image_header.height;
+		values->present   |= size_bits;
+		values->malformed &= ~size_bits;
+	}
+}
+
+static void printExe(struct outputBuffer *out)
 {
 #ifndef _WIN32
 	const char *default_exe = "sd";
 #else
 	const char *default_exe = "sd.exe";
 #endif
-	size_t i, j;
 
-	fprintf(stdout, "%s%s ", 
-		(bin_path == NULL) ? "" : bin_path, 
-		(exe_name == NULL) ? default_exe : exe_name);
+	outputPuts(out, (bin_path == NULL) ? "" : bin_path);
+	outputPuts(out, (exe_name == NULL) ? default_exe : exe_name);
+}
+
+/* Every switch sd needs to regenerate the image, each followed by a space */
+static void printArgs(struct outputBuffer *out, const char *buffer, 
+	const struct stiToken *stack, const size_t depth, 
+	struct scriptEntry *marks)
+{
+	STI_BOOL printed_size = STI_FALSE;
+	size_t i, j, value_start;
 
 	for (i = 0; i < depth; i++)
 	{
@@ -264,207 +460,1952 @@ static void processTokens(const char *buffer, const struct stiToken *stack,
 		char label[LABEL_LIM + 1] = {0};
 		struct paramHashNode *node = NULL;
 
-		for (j = 0; j < LABEL_LIM && substr[j] != ':'; j++)
-		{
-			label[j] = substr[j];
-		}
-
-		j++; /* Just skip over that colon */
-
-		if ((j >= LABEL_LIM)
+		if (((j = tokenLabel(substr, label)) == 0)
 		|| ((node = hashLookup(chomp(label))) == NULL))
 		{
 			continue;
 		}
 
+		paramDecode(&marks->values, chomp(label), substr + j, 
+			token_len - j);
+
 		if (node->switch_name != NULL)
 		{
 			if ((abrv_flags == STI_TRUE)
 			&& (node->abrv != 0))
 			{
-				fprintf(stdout, "-%c ", node->abrv);
+				outputPutc(out, '-');
+				outputPutc(out, node->abrv);
+				outputPutc(out, ' ');
 			}
 			else
 			{
-				fprintf(stdout, "%s ", node->switch_name);
+				outputPuts(out, node->switch_name);
+				outputPutc(out, ' ');
 			}
 		}
 
-		node->print(substr + j, token_len - j);
-		fputc(' ', stdout);
+		value_start = out->len;
+		node->print(out, substr + j, token_len - j);
+
+		if (node->print == printSize)
+		{
+			printed_size = STI_TRUE;
+		}
+
+		if (node->print == printModel)
+		{
+			markSpan(&marks->keys[SCRIPT_KEY_MODEL], 
+				value_start, out->len);
+		}
+		else if (strcmp(node->encode_name, "Seed") == 0)
+		{
+			markSpan(&marks->seed, value_start, out->len);
+		}
+
+		outputPutc(out, ' ');
+	}
+
+	if (use_header == STI_TRUE)
+	{
+		headerValues(&marks->values);
+
+		if (printed_size == STI_FALSE)
+		{
+			printSize(out, NULL, 0);
+			outputPutc(out, ' ');
+		}
 	}
 
 	if (vae_path != NULL)
 	{
-		fprintf(stdout, "--vae %s ", vae_path);
+		outputPuts(out, "--vae ");
+		markSpan(&marks->keys[SCRIPT_KEY_VAE], out->len, 
+			out->len + strlen(vae_path));
+		outputPuts(out, vae_path);
+		outputPutc(out, ' ');
 	}
 
 	if (lora_path != NULL)
 	{
-		fprintf(stdout, "--lora-model-dir %s ", lora_path);
+		outputPuts(out, "--lora-model-dir ");
+		markSpan(&marks->keys[SCRIPT_KEY_LORA], out->len, 
+			out->len + strlen(lora_path));
+		outputPuts(out, lora_path);
+		outputPutc(out, ' ');
 	}
+}
 
-	fputs("--color ", stdout);
-	fputs((abrv_flags == STI_TRUE) 
-		? "-o <REPLACE_ME>\n" : "--output <REPLACE_ME>\n", stdout);
+/* Process all the tokens in FIFO order, marks records where the model, 
+ * vae, lora, seed, and output values ended up and what the numeric 
+ * settings decoded to, out_name replaces the <REPLACE_ME> placeholder if 
+ * not NULL */
+static void processTokens(struct outputBuffer *out, const char *buffer, 
+	const struct stiToken *stack, const size_t depth, 
+	struct scriptEntry *marks, const char *out_name)
+{
+	size_t value_start;
+
+	memset(marks, 0, sizeof(struct scriptEntry));
+	model_hash = findValue(buffer, stack, depth, "Model hash", 
+		&model_hash_len);
+
+	printExe(out);
+	outputPutc(out, ' ');
+	printArgs(out, buffer, stack, depth, marks);
+	outputPuts(out, "--color ");
+	outputPuts(out, (abrv_flags == STI_TRUE) ? "-o " : "--output ");
+	value_start = out->len;
+	outputPuts(out, (out_name == NULL) ? "<REPLACE_ME>" : out_name);
+	markSpan(&marks->output, value_start, out->len);
+	outputPutc(out, '\n');
 }
 
-static int dumpSDPrompt(FILE *fhandle)
+#define LINE_STACK_LEN 16
+
+/* Names --fields takes and the labels they're written under, everything
+ * past the first two is on the settings line */
+static const struct
 {
-	/* We treat this array as a FIFO stack of tokens */
-	struct stiToken *tokens = NULL;
-	size_t num_tokens = 0;
-	/* Signature is quite literally "tEXt" */
-	const char text_signature[] = {116, 69, 88, 116};
-	char *buffer  = NULL;
-	size_t i, buffer_size = 0;
+	const char *name;
+	const char *label;
+} field_names[] =
+{
+	{"prompt",   "parameters"},
+	{"negative", "Negative prompt"},
+	{"steps",    "Steps"},
+	{"cfg",      "CFG scale"},
+	{"seed",     "Seed"},
+	{"size",     "Size"},
+	{"sampler",  "Sampler"},
+	{"model",    "Model"},
+	{"rng",      "RNG"}
+};
+
+#define FIELD_NAMES (sizeof(field_names) / sizeof(field_names[0]))
+#define FIELD_FIRST_SETTING 2
 
-	if ((buffer_size = pngFindChunk(fhandle, text_signature)) == 0)
+/* Takes a comma separated list of field names, returns 1 on a name that 
+ * isn't known or if there are too many */
+static int parseFields(const char *arg)
+{
+	while (*arg != '\0')
 	{
-		fprintf(stderr, "Unable to find tEXt chunk\n");
+		size_t i, len;
 
-		return 1;
-	}
+		for (len = 0; (arg[len] != ',') && (arg[len] != '\0'); len++);
 
-	/* +1 to accommodate the terminating null byte */
-	if ((buffer = calloc(buffer_size + 1, sizeof(char))) == NULL)
-	{
-		fprintf(stderr, "Calloc error, don't see that every day\n");	
+		for (i = 0; (i < FIELD_NAMES) 
+		&& ((strncmp(field_names[i].name, arg, len) != 0)
+		|| (field_names[i].name[len] != '\0')); i++);
 
-		return 1;
-	}
+		if ((i == FIELD_NAMES) || (num_fields == FIELDS_MAX))
+		{
+			fprintf(stderr, "Unknown field \"%.*s\", expected one of"
+				" prompt, negative, steps, cfg, seed, size, "
+				"sampler, model, or rng\n", (int) len, arg);
 
-	if (fread(buffer, sizeof(char), buffer_size, fhandle) != buffer_size)
-	{
-		fprintf(stderr, "Unable to fill info buffer with %lu bytes\n",
-			buffer_size);
-		free(buffer);
+			return 1;
+		}
 
-		return 1;
+		field_labels[num_fields++] = field_names[i].label;
+		arg += (arg[len] == ',') ? len + 1 : len;
 	}
 
-	/* Why the PNG spec deliminates with null chars I will never know */
-	if (strncmp("parameters", buffer, sizeof("parameters") - 1) == 0)
+	return (num_fields == 0);
+}
+
+static STI_BOOL isSetting(const char *label)
+{
+	size_t i;
+
+	for (i = FIELD_FIRST_SETTING; i < FIELD_NAMES; i++)
 	{
-		buffer[sizeof("parameters") - 1] = ':';
+		if (strcmp(field_names[i].label, label) == 0)
+		{
+			return STI_TRUE;
+		}
 	}
 
-	if ((tokens = stiNewTokenStack((const char *) buffer, buffer_size, 
-		GO_TILL_NULL, "\n", &num_tokens)) == NULL)
-	{
-		fprintf(stderr, "Failed to generate token stack for buffer\n");
-		free(buffer);
+	return STI_FALSE;
+}
 
-		return 1;
-	}
+/* Bits of the wanted fields a kept line resolves, the settings line starts
+ * with Steps and carries all the rest of the settings along with it */
+static uint32_t fieldsResolved(const char *label)
+{
+	const STI_BOOL settings = (strcmp(label, "Steps") == 0) 
+		? STI_TRUE : STI_FALSE;
+	uint32_t ret = 0;
+	size_t i;
 
-	/* The two prompt tokens can be processed as is, the misc token needs
-	 * to be further tokenized by commas before being processed, it would
-	 * be better if they all were delimed by newlines but that's a 
-	 * potential improvement to sdcpp for future consideration */
-	/* If there are no negative-prompt args it will not get encoded so it
-	 * isn't enough just to call subtokenize on the third token because it
-	 * might actually be the second of only two tokens. It would be nice
-	 * if it started with something like "misc" or "settings" */
-	for (i = 0; i < num_tokens; i++)
+	for (i = 0; i < num_fields; i++)
 	{
-		if (strncmp(buffer + tokens[i].token_start, "Steps", 
-			sizeof("Steps") - 1) != 0)
+		if ((strcmp(field_labels[i], label) == 0)
+		|| ((settings == STI_TRUE) 
+		&& (isSetting(field_labels[i]) == STI_TRUE)))
 		{
-			continue;
+			ret |= (uint32_t) 1 << i;
 		}
+	}
 
-		if (stiSubtokenize(buffer, buffer_size, ",", i, &tokens, 
-			&num_tokens) == 0)
-		{
-			fprintf(stderr, "Bad sub-tokenize\n");
-			free(tokens);
-			free(buffer);
+	return ret;
+}
 
-			return 1;
-		}
-		else
+static STI_BOOL fieldsDone(const uint32_t resolved)
+{
+	return ((num_fields != 0) 
+	&& (resolved == ((uint32_t) 1 << num_fields) - 1))
+		? STI_TRUE : STI_FALSE;
+}
+
+/* Whether a labelled line has to be read at all */
+static STI_BOOL keepLine(const char *label)
+{
+	if (hashLookup(label) == NULL)
+	{
+		return STI_FALSE;
+	}
+
+	return ((num_fields == 0) || (fieldsResolved(label) != 0))
+		? STI_TRUE : STI_FALSE;
+}
+
+/* Appends a file token to out a window at a time */
+static int copyFileToken(FILE *fhandle, const struct stiToken *token,
+	struct outputBuffer *out)
+{
+	char window[STI_FILE_WINDOW];
+	struct stiToken piece = *token;
+
+	while (piece.token_start < token->token_end)
+	{
+		const size_t got 
+			= stiReadToken(fhandle, &piece, window, STI_FILE_WINDOW,
+				ioRead);
+
+		if ((got == 0) || (outputAppend(out, window, got) != 0))
 		{
-			break;
+			return 1;
 		}
-	}
 
-	processTokens(buffer, tokens, num_tokens);
-	free(tokens); 
-	free(buffer);
+		piece.token_start += got;
+	}
 
 	return 0;
 }
 
-static char* lazyStrdup(const char *src)
+/* Streams a text chunk line by line through the file tokenizer and copies 
+ * out only the lines processTokens has a use for, anything else is never 
+ * read past its label. This keeps per image memory down to the size of the 
+ * values actually printed no matter how large the chunk is. The first line 
+ * of a "parameters" chunk is the prompt and carries no label of its own.
+ * With --fields only lines holding a wanted field are copied and the walk
+ * stops as soon as all of them have turned up */
+static int gatherParams(FILE *fhandle, const struct pngTextChunk *chunk,
+	const STI_BOOL first_is_prompt, struct outputBuffer *params)
 {
-	char *dst = NULL;
+	struct stiToken lines[LINE_STACK_LEN];
+	const size_t text_start = (size_t) chunk->text_offset;
+	const size_t text_end = text_start + chunk->text_length;
+	size_t i, num_lines, pos = text_start;
+	uint32_t resolved = 0;
 
-	if (src != NULL)
+	do
 	{
-		const size_t len = strlen(src) + 1;
+		if ((fseek(fhandle, (long int) pos, SEEK_SET) != 0)
+		|| ((num_lines = stiTokenizeFile(fhandle, 
+			(long int) (text_end - pos), "\n", lines, 
+			LINE_STACK_LEN, ioRead)) == 0))
+		{
+			return 1;
+		}
 
-		if ((dst = malloc(sizeof(char) * (len))) != NULL)
+		for (i = 0; i < num_lines; i++)
 		{
-			dst = strncpy(dst, src, len);
+			char label[LABEL_LIM + 1] = {0};
+			size_t j, label_len;
+
+			if ((first_is_prompt == STI_TRUE)
+			&& (lines[i].token_start == text_start))
+			{
+				if (keepLine("parameters") == STI_FALSE)
+				{
+					continue;
+				}
+
+				outputPuts(params, "parameters:");
+				resolved |= fieldsResolved("parameters");
+			}
+			else
+			{
+				label_len = stiReadToken(fhandle, &lines[i], 
+					label, LABEL_LIM, ioRead);
+
+				for (j = 0; (j < label_len) 
+				&& (label[j] != ':'); j++);
+
+				label[j] = '\0';
+
+				if ((j == label_len) 
+				|| (keepLine(chomp(label)) == STI_FALSE))
+				{
+					continue;
+				}
+
+				resolved |= fieldsResolved(chomp(label));
+
+				if (params->len != 0)
+				{
+					outputPutc(params, '\n');
+				}
+			}
+
+			if (copyFileToken(fhandle, &lines[i], params) != 0)
+			{
+				return 1;
+			}
+
+			if (fieldsDone(resolved) == STI_TRUE)
+			{
+				return params->error;
+			}
 		}
-	}
 
-	return dst;
+		pos = lines[num_lines - 1].token_end + 1;
+	} while ((num_lines == LINE_STACK_LEN) 
+	&& (lines[num_lines - 1].token_end < text_end));
+
+	return params->error;
 }
 
-static void printHelp(void)
+enum sinkState
 {
-	fputs("stable-diffusion.cpp Prompt Dumper, sdPromptDumper:\n\n"
-		"-M, --model  <DIR PATH> : Path to user's model directory\n"
-		"-L, --lora   <DIR PATH> : Path to user's LoRA directory\n"
-		"-B, --bin    <DIR PATH> : Path to sd binary directory\n"
-		"-E, --exe   <FILE NAME> : Alternative name for executable\n" 
-		"-V, --vae   <FILE PATH> : As above, include file as well\n"
-		"-c, --config <DIR PATH> : Path to alt config file directory\n"
-		"-a, --abrv              : Abbreviates switches in output\n"
-		"-e, --endian            : Prints assumed endian form, exits\n"
-		"-h, --help              : Prints this help message, exits\n\n"
-		"./sdPromptDumper [FLAGS]... [PNG Files]...\n\n"
-		"Example:\n"
-		"./sdPromptDumper --model ~/.models/ --vae ./myVAE.safetensors"
-		" aLovelyCat.png\n\n", stdout);
-}
+	SINK_LABEL = 0,
+	SINK_KEEP,
+	SINK_SKIP
+};
 
-int main(int argc, char **argv)
+/* Applies the same line filtering gatherParams does to text arriving a piece
+ * at a time from the inflater, since decompressed text can't be seeked 
+ * around in. Only the label being looked at is held beyond what is kept */
+struct paramSink
 {
-	const struct portoptVerboseOpt opts[] =
-	{
-		{'M', "model",  PORTOPT_TRUE},
-		{'L', "lora",   PORTOPT_TRUE},
-		{'B', "bin",    PORTOPT_TRUE},
-		{'E', "exe",    PORTOPT_TRUE},
-		{'V', "vae",    PORTOPT_TRUE},
-		{'c', "config", PORTOPT_TRUE},
-		{'a', "abrv",   PORTOPT_FALSE},
-		{'e', "endian", PORTOPT_FALSE},
-		{'h', "help",   PORTOPT_FALSE}
-	};
-	const size_t num_opts = sizeof(opts) / sizeof(opts[0]);
-	const size_t argl = (size_t) argc;
-	size_t i, ind = 0;
-	char *alt_cfg_path = NULL;
-	int flag, num_bad_files = 0;
+	struct outputBuffer *params;
+	char label[LABEL_LIM + 1];
+	size_t label_len;
+	enum sinkState state;
+	STI_BOOL in_settings;
+	uint32_t resolved;
+};
 
-	if (setupHashtable() == 1)
+static void sinkCheckLabel(struct paramSink *sink)
+{
+	sink->label[sink->label_len - 1] = '\0';
+
+	if (keepLine(chomp(sink->label)) == STI_FALSE)
 	{
-		fprintf(stderr, "Failed to initialize parameter hashtable\n");
+		sink->state = SINK_SKIP;
 
-		return 1;
+		return;
 	}
 
-	while ((flag = portoptVerbose(argl, argv, opts, num_opts, &ind)) != -1)
+	sink->resolved |= fieldsResolved(chomp(sink->label));
+
+	sink->in_settings = (strcmp(chomp(sink->label), "Steps") == 0)
+		? STI_TRUE : STI_FALSE;
+	sink->label[sink->label_len - 1] = ':';
+	sink->state = SINK_KEEP;
+
+	if (sink->params->len != 0)
 	{
-		switch (flag)
-		{
-			case 'M':
-				model_path = lazyStrdup(portoptGetArg(
-					argl, argv, &ind));
+		outputPutc(sink->params, '\n');
+	}
+
+	outputAppend(sink->params, sink->label, sink->label_len);
+}
+
+/* Nothing past the settings line is of any use, so once it's complete, or
+ * every field asked for has been, the inflater is told to stop rather than 
+ * decompressing the rest */
+static int sinkFeed(const char *data, const size_t len, void *ctx)
+{
+	struct paramSink *sink = (struct paramSink *) ctx;
+	size_t i = 0;
+
+	while ((i < len) && (sink->params->error == 0))
+	{
+		const char *newline = NULL;
+		size_t run;
+
+		if (sink->state == SINK_LABEL)
+		{
+			const char ch = data[i++];
+
+			if (ch == '\n') /* Unlabeled line */
+			{
+				sink->label_len = 0;
+
+				continue;
+			}
+
+			sink->label[sink->label_len++] = ch;
+
+			if (ch == ':')
+			{
+				sinkCheckLabel(sink);
+			}
+			else if (sink->label_len == LABEL_LIM)
+			{
+				sink->state = SINK_SKIP;
+			}
+
+			continue;
+		}
+
+		newline = memchr(data + i, '\n', len - i);
+		run = (newline == NULL) ? len - i : (size_t) (newline - data) - i;
+
+		if (sink->state == SINK_KEEP)
+		{
+			outputAppend(sink->params, data + i, run);
+		}
+
+		i += run;
+
+		if (newline != NULL)
+		{
+			if ((sink->state == SINK_KEEP) 
+			&& ((sink->in_settings == STI_TRUE)
+			|| (fieldsDone(sink->resolved) == STI_TRUE)))
+			{
+				return 1;
+			}
+
+			sink->state = SINK_LABEL;
+			sink->label_len = 0;
+			i++;
+		}
+	}
+
+	return sink->params->error;
+}
+
+/* Text that can't be seeked around in, compressed or needing conversion,
+ * goes through the line filter as it streams in */
+static int sinkParams(FILE *fhandle, const struct imageText *text,
+	const STI_BOOL first_is_prompt, struct outputBuffer *params)
+{
+	struct paramSink sink;
+
+	memset(&sink, 0, sizeof(struct paramSink));
+	sink.params = params;
+
+	if ((first_is_prompt == STI_TRUE) 
+	&& (keepLine("parameters") == STI_TRUE))
+	{
+		outputPuts(params, "parameters:");
+		sink.state = SINK_KEEP;
+		sink.resolved = fieldsResolved("parameters");
+	}
+	else if (first_is_prompt == STI_TRUE)
+	{
+		sink.state = SINK_SKIP;
+	}
+
+	if (imageStreamText(fhandle, text, sinkFeed, &sink) != 0)
+	{
+		return 1;
+	}
+
+	return params->error;
+}
+
+/* ComfyUI's "prompt" JSON, what's needed out of it is rewritten into params
+ * in the same labelled form as a "parameters" chunk */
+static int comfyParams(FILE *fhandle, const struct imageText *text,
+	struct outputBuffer *params)
+{
+	struct comfyPrompt *comfy = NULL;
+	int ret;
+
+	/* Big enough that it shouldn't go on the stack */
+	if ((comfy = malloc(sizeof(struct comfyPrompt))) == NULL)
+	{
+		return 1;
+	}
+
+	comfyInit(comfy);
+
+	if ((ret = imageStreamText(fhandle, text, comfyFeed, comfy)) == 0)
+	{
+		ret = comfyWriteParams(comfy, params);
+	}
+
+	if (ret != 0)
+	{
+		fprintf(stderr, "Unable to read ComfyUI prompt\n");
+	}
+
+	comfyFree(comfy);
+	free(comfy);
+
+	return ret;
+}
+
+/* Prefers the "parameters" chunk, then ComfyUI's "prompt" chunk, but falls
+ * back to the first text chunk, which is all that used to be looked at */
+static const struct pngTextChunk* pickParamChunk(
+	const struct pngTextTable *table)
+{
+	const struct pngTextChunk *chunk = NULL;
+
+	if (((chunk = pngFindText(table, "parameters")) != NULL)
+	|| ((chunk = pngFindText(table, "prompt")) != NULL))
+	{
+		return chunk;
+	}
+
+	return (table->len != 0) ? &table->chunks[0] : NULL;
+}
+
+static int readPngParams(FILE *fhandle, struct outputBuffer *params)
+{
+	const char * const wanted[] = {"parameters", "prompt"};
+	struct pngTextTable table;
+	const struct pngTextChunk *chunk = NULL;
+	struct imageText text;
+	STI_BOOL first_is_prompt;
+	uint64_t begin = traceNow();
+	int ret;
+
+	if ((pngScanText(fhandle, &table, wanted, 
+		sizeof(wanted) / sizeof(wanted[0]), text_layout) != 0)
+	|| ((chunk = pickParamChunk(&table)) == NULL))
+	{
+		fprintf(stderr, "Unable to find tEXt chunk\n");
+		traceSpan(TRACE_CHUNKS, begin);
+
+		return 1;
+	}
+
+	traceSpan(TRACE_CHUNKS, begin);
+	begin = traceNow();
+
+	first_is_prompt = (strcmp(chunk->keyword, "parameters") == 0)
+		? STI_TRUE : STI_FALSE;
+	text.kind     = (strcmp(chunk->keyword, "prompt") == 0)
+		? IMAGE_TEXT_COMFY : IMAGE_TEXT_PARAMETERS;
+	text.encoding = (chunk->compressed != 0) ? IMAGE_ZLIB : IMAGE_UTF8;
+	text.offset   = chunk->text_offset;
+	text.length   = chunk->text_length;
+
+	ret = (text.kind == IMAGE_TEXT_COMFY)
+		? comfyParams(fhandle, &text, params)
+		: (chunk->compressed != 0)
+		? sinkParams(fhandle, &text, first_is_prompt, params)
+		: gatherParams(fhandle, chunk, first_is_prompt, params);
+	traceSpan(TRACE_READ, begin);
+
+	if (ret != 0)
+	{
+		fprintf(stderr, "Unable to read %lu byte tEXt chunk\n",
+			(unsigned long) chunk->text_length);
+	}
+
+	return ret;
+}
+
+/* JPEG and WebP files keep their parameters in EXIF or XMP */
+static int readImageParams(FILE *fhandle, const enum imageFormat format,
+	struct outputBuffer *params)
+{
+	struct imageText text;
+	uint64_t begin = traceNow();
+	int ret;
+
+	if (imageFindText(fhandle, format, &text) != 0)
+	{
+		fprintf(stderr, "Unable to find parameters in %s metadata\n",
+			imageFormatName(format));
+		traceSpan(TRACE_CHUNKS, begin);
+
+		return 1;
+	}
+
+	traceSpan(TRACE_CHUNKS, begin);
+	begin = traceNow();
+	ret = (text.kind == IMAGE_TEXT_COMFY)
+		? comfyParams(fhandle, &text, params)
+		: sinkParams(fhandle, &text, STI_TRUE, params);
+	traceSpan(TRACE_READ, begin);
+
+	if (ret != 0)
+	{
+		fprintf(stderr, "Unable to read %lu bytes of %s metadata\n",
+			(unsigned long) text.length, imageFormatName(format));
+	}
+
+	return ret;
+}
+
+/* Reads the parameters out of the file and splits them into lines, with
+ * the settings line split by commas as well, the caller frees both */
+static int tokenizeParams(FILE *fhandle, const enum imageFormat format,
+	char **buffer_out, struct stiToken **tokens_out, size_t *num_out)
+{
+	/* We treat this array as a FIFO stack of tokens */
+	struct stiToken *tokens = NULL;
+	size_t num_tokens = 0;
+	struct outputBuffer params = {0};
+	char *buffer  = NULL;
+	size_t i, buffer_size = 0;
+	uint64_t begin;
+
+	/* The terminating null byte isn't counted in the buffer size */
+	if ((((format == IMAGE_PNG) 
+		? readPngParams(fhandle, &params)
+		: readImageParams(fhandle, format, &params)) != 0)
+	|| (outputPutc(&params, '\0') != 0))
+	{
+		outputFree(&params);
+
+		return 1;
+	}
+
+	buffer      = params.data;
+	buffer_size = params.len - 1;
+	begin       = traceNow();
+
+	if ((tokens = stiNewTokenStack((const char *) buffer, buffer_size, 
+		GO_TILL_NULL, "\n", &num_tokens)) == NULL)
+	{
+		fprintf(stderr, "Failed to generate token stack for buffer\n");
+		free(buffer);
+		traceSpan(TRACE_TOKENIZE, begin);
+
+		return 1;
+	}
+
+	/* The two prompt tokens can be processed as is, the misc token needs
+	 * to be further tokenized by commas before being processed, it would
+	 * be better if they all were delimed by newlines but that's a 
+	 * potential improvement to sdcpp for future consideration */
+	/* If there are no negative-prompt args it will not get encoded so it
+	 * isn't enough just to call subtokenize on the third token because it
+	 * might actually be the second of only two tokens. It would be nice
+	 * if it started with something like "misc" or "settings" */
+	for (i = 0; i < num_tokens; i++)
+	{
+		if (strncmp(buffer + tokens[i].token_start, "Steps", 
+			sizeof("Steps") - 1) != 0)
+		{
+			continue;
+		}
+
+		if (stiSubtokenize(buffer, buffer_size, ",", i, &tokens, 
+			&num_tokens) == 0)
+		{
+			fprintf(stderr, "Bad sub-tokenize\n");
+			free(tokens);
+			free(buffer);
+			traceSpan(TRACE_TOKENIZE, begin);
+
+			return 1;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	*buffer_out = buffer;
+	*tokens_out = tokens;
+	*num_out    = num_tokens;
+	traceSpan(TRACE_TOKENIZE, begin);
+
+	return 0;
+}
+
+/* Reports every <lora:...> tag in the prompt that sd won't find in the
+ * LoRA directory, rather than have the regeneration fail part way through */
+static void checkLoRAs(const char *path, const char *buffer, 
+	const struct stiToken *tokens, const size_t num_tokens)
+{
+	size_t len, name_len, pos = 0;
+	const char *prompt, *name;
+
+	if ((lora_path == NULL) || (lora_state == DIR_UNREADABLE)
+	|| ((prompt = findValue(buffer, tokens, num_tokens, "parameters", 
+		&len)) == NULL))
+	{
+		return;
+	}
+
+	if ((lora_state == DIR_UNLISTED) 
+	&& (loraIndexBuild(&lora_index, lora_path) != 0))
+	{
+		fprintf(stderr, "Unable to list LoRA directory %s, LoRA tags "
+			"won't be checked\n", lora_path);
+		lora_state = DIR_UNREADABLE;
+
+		return;
+	}
+
+	lora_state = DIR_LISTED;
+
+	while (loraNextTag(prompt, len, &pos, &name, &name_len) == 0)
+	{
+		if (loraIndexHas(&lora_index, name, name_len) == 0)
+		{
+			fprintf(stderr, "%s: LoRA \"%.*s\" not found in %s\n",
+				path, (int) name_len, name, lora_path);
+		}
+	}
+}
+
+/* One line per setting that was there but couldn't be decoded, the rest of
+ * the image is still usable so this is only ever a warning */
+static void reportMalformed(const char *path, 
+	const struct paramValues *values)
+{
+	size_t i;
+
+	for (i = 0; i < PARAM_NUM_FIELDS; i++)
+	{
+		if ((values->malformed & PARAM_BIT(i)) != 0)
+		{
+			fprintf(stderr, "%s: Malformed %s value\n", path, 
+				paramFieldName(i));
+		}
+	}
+}
+
+/* PNGs carry their real size in IHDR, which is what gets used whenever the
+ * Size setting is missing or says something else, the decode only costs
+ * the one extra read */
+static void checkHeader(const char *path, FILE *fhandle, 
+	const enum imageFormat format, const char *buffer, 
+	const struct stiToken *tokens, const size_t num_tokens)
+{
+	uint32_t width, height;
+	const char *size;
+	size_t len;
+
+	use_header = STI_FALSE;
+
+	if ((format != IMAGE_PNG) 
+	|| (pngReadHeader(fhandle, &image_header) != 0))
+	{
+		return;
+	}
+
+	if ((size = findValue(buffer, tokens, num_tokens, "Size", &len)) 
+		== NULL)
+	{
+		use_header = STI_TRUE;
+	}
+	else if ((paramParseSize(size, len, &width, &height) != 0)
+	|| (width != image_header.width) || (height != image_header.height))
+	{
+		fprintf(stderr, "%s: Size %.*s doesn't match the %lux%lu "
+			"image, using the image's\n", path, (int) len, size,
+			(unsigned long) image_header.width, 
+			(unsigned long) image_header.height);
+		use_header = STI_TRUE;
+	}
+}
+
+/* Both separators are accepted since either may show up on Windows */
+static const char* baseName(const char *path)
+{
+	const char *ret = path;
+
+	for (; *path != '\0'; path++)
+	{
+		if ((*path == '/') || (*path == '\\'))
+		{
+			ret = path + 1;
+		}
+	}
+
+	return ret;
+}
+
+/* Names --template knows, past TEMPLATE_NAME_LABELS they're the --fields
+ * names and are read straight out of the parameters */
+enum templateName
+{
+	TEMPLATE_NAME_PATH = 0,
+	TEMPLATE_NAME_BASENAME,
+	TEMPLATE_NAME_EXE,
+	TEMPLATE_NAME_ARGS,
+	TEMPLATE_NAME_OUTPUT,
+	TEMPLATE_NAME_WIDTH,
+	TEMPLATE_NAME_HEIGHT,
+	TEMPLATE_NAME_VAE,
+	TEMPLATE_NAME_LORA_DIR,
+	TEMPLATE_NAME_LABELS
+};
+
+static const char *template_names[TEMPLATE_NAME_LABELS + FIELD_NAMES] = 
+{
+	"path", "basename", "exe", "args", "output", "width", "height", "vae",
+	"lora_dir"
+};
+
+struct templateContext
+{
+	const char *path;
+	const char *buffer;
+	const struct stiToken *stack;
+	size_t depth;
+	struct scriptEntry *marks;
+	const char *out_name;
+};
+
+static int setupTemplate(const char *src)
+{
+	size_t i;
+
+	for (i = 0; i < FIELD_NAMES; i++)
+	{
+		template_names[TEMPLATE_NAME_LABELS + i] = field_names[i].name;
+	}
+
+	return templateCompile(&output_template, src, template_names, 
+		TEMPLATE_NAME_LABELS + FIELD_NAMES);
+}
+
+/* Values are written the way the usual output would have them, prompts 
+ * quoted and the model resolved against --model */
+static void printLabelled(struct outputBuffer *out, const char *label,
+	const struct templateContext *ctx)
+{
+	struct scriptEntry *marks = ctx->marks;
+	const size_t value_start = out->len;
+	size_t len;
+	const char *str = findValue(ctx->buffer, ctx->stack, ctx->depth, 
+		label, &len);
+
+	if ((strcmp(label, "Size") == 0) && (use_header == STI_TRUE))
+	{
+		printU32(out, image_header.width);
+		outputPutc(out, 'x');
+		printU32(out, image_header.height);
+	}
+	else if (str == NULL)
+	{
+		return;
+	}
+	else if ((strcmp(label, "parameters") == 0) 
+	|| (strcmp(label, "Negative prompt") == 0))
+	{
+		printQuote(out, str, len);
+	}
+	else if (strcmp(label, "Model") == 0)
+	{
+		printModel(out, str, len);
+		markSpan(&marks->keys[SCRIPT_KEY_MODEL], value_start, 
+			out->len);
+	}
+	else
+	{
+		printLen(out, str, len);
+
+		if (strcmp(label, "Seed") == 0)
+		{
+			markSpan(&marks->seed, value_start, out->len);
+		}
+	}
+}
+
+static void printTemplateField(struct outputBuffer *out, const size_t field,
+	void *data)
+{
+	const struct templateContext *ctx 
+		= (const struct templateContext *) data;
+	struct scriptEntry *marks = ctx->marks;
+	const size_t value_start = out->len;
+
+	switch (field)
+	{
+		/* Names are quoted like prompts, they can hold anything */
+		case TEMPLATE_NAME_PATH:
+			shellQuote(out, ctx->path, strlen(ctx->path), 
+				quote_style);
+			break;
+		case TEMPLATE_NAME_BASENAME:
+			shellQuote(out, baseName(ctx->path), 
+				strlen(baseName(ctx->path)), quote_style);
+			break;
+		case TEMPLATE_NAME_EXE:
+			printExe(out);
+			break;
+		case TEMPLATE_NAME_ARGS:
+			printArgs(out, ctx->buffer, ctx->stack, ctx->depth, 
+				marks);
+
+			/* The template has its own spacing */
+			if ((out->len > value_start) 
+			&& (out->data[out->len - 1] == ' '))
+			{
+				out->len--;
+			}
+
+			break;
+		case TEMPLATE_NAME_OUTPUT:
+			outputPuts(out, (ctx->out_name == NULL) 
+				? "<REPLACE_ME>" : ctx->out_name);
+			markSpan(&marks->output, value_start, out->len);
+			break;
+		case TEMPLATE_NAME_WIDTH:
+			if ((marks->values.present & PARAM_BIT(PARAM_WIDTH)) 
+				!= 0)
+			{
+				printU32(out, marks->values.width);
+			}
+
+			break;
+		case TEMPLATE_NAME_HEIGHT:
+			if ((marks->values.present & PARAM_BIT(PARAM_HEIGHT))
+				!= 0)
+			{
+				printU32(out, marks->values.height);
+			}
+
+			break;
+		case TEMPLATE_NAME_VAE:
+			if (vae_path != NULL)
+			{
+				outputPuts(out, vae_path);
+				markSpan(&marks->keys[SCRIPT_KEY_VAE], 
+					value_start, out->len);
+			}
+
+			break;
+		case TEMPLATE_NAME_LORA_DIR:
+			if (lora_path != NULL)
+			{
+				outputPuts(out, lora_path);
+				markSpan(&marks->keys[SCRIPT_KEY_LORA], 
+					value_start, out->len);
+			}
+
+			break;
+		default:
+			printLabelled(out, 
+				field_names[field - TEMPLATE_NAME_LABELS].label,
+				ctx);
+			break;
+	}
+}
+
+/* Same job as processTokens but shaped by --template, the values are 
+ * decoded up front since nothing says {args} is in there */
+static void processTemplate(struct outputBuffer *out, const char *path,
+	const char *buffer, const struct stiToken *stack, const size_t depth,
+	struct scriptEntry *marks, const char *out_name)
+{
+	struct templateContext ctx;
+	size_t i;
+
+	memset(marks, 0, sizeof(struct scriptEntry));
+	model_hash = findValue(buffer, stack, depth, "Model hash", 
+		&model_hash_len);
+
+	for (i = 0; i < depth; i++)
+	{
+		const char *substr = buffer + stack[i].token_start;
+		const size_t token_len 
+			= stack[i].token_end - stack[i].token_start;
+		char label[LABEL_LIM + 1] = {0};
+		const size_t j = tokenLabel(substr, label);
+
+		if ((j != 0) && (j <= token_len))
+		{
+			paramDecode(&marks->values, chomp(label), substr + j, 
+				token_len - j);
+		}
+	}
+
+	headerValues(&marks->values);
+
+	ctx.path     = path;
+	ctx.buffer   = buffer;
+	ctx.stack    = stack;
+	ctx.depth    = depth;
+	ctx.marks    = marks;
+	ctx.out_name = out_name;
+
+	templateEmit(&output_template, out, printTemplateField, &ctx);
+	outputPutc(out, '\n');
+}
+
+static int dumpSDPrompt(const char *path, FILE *fhandle, 
+	const enum imageFormat format, struct outputBuffer *out, 
+	struct scriptEntry *marks, const char *out_name)
+{
+	struct scriptEntry scratch;
+	struct stiToken *tokens = NULL;
+	size_t num_tokens = 0;
+	char *buffer = NULL;
+	uint64_t begin;
+
+	if (tokenizeParams(fhandle, format, &buffer, &tokens, &num_tokens) 
+		!= 0)
+	{
+		return 1;
+	}
+
+	if (marks == NULL)
+	{
+		marks = &scratch;
+	}
+
+	checkHeader(path, fhandle, format, buffer, tokens, num_tokens);
+	begin = traceNow();
+
+	if (output_template.num_ops != 0)
+	{
+		processTemplate(out, path, buffer, tokens, num_tokens, marks, 
+			out_name);
+	}
+	else
+	{
+		processTokens(out, buffer, tokens, num_tokens, marks, 
+			out_name);
+	}
+
+	traceSpan(TRACE_FORMAT, begin);
+
+	reportMalformed(path, &marks->values);
+	checkLoRAs(path, buffer, tokens, num_tokens);
+	free(tokens); 
+	free(buffer);
+
+	if (out->error != 0)
+	{
+		fprintf(stderr, "Unable to grow output buffer\n");
+
+		return 1;
+	}
+
+	return 0;
+}
+
+static char* lazyStrdup(const char *src)
+{
+	char *dst = NULL;
+
+	if (src != NULL)
+	{
+		const size_t len = strlen(src) + 1;
+
+		if ((dst = malloc(sizeof(char) * (len))) != NULL)
+		{
+			dst = strncpy(dst, src, len);
+		}
+	}
+
+	return dst;
+}
+
+/* Formats the invocation into the batch instead of stdout, for scripts each
+ * regenerated image is written to the script's output directory under its 
+ * old name */
+static int queueInvocation(const char *path, FILE *fhandle, 
+	const enum imageFormat format, struct outputBuffer *out, 
+	struct scriptBatch *batch, const STI_BOOL for_script)
+{
+	struct scriptEntry marks;
+	struct outputBuffer name = {0};
+	size_t command_len;
+	char *command = NULL;
+	int ret;
+
+	/* The name is whatever the file was called, so it can't be trusted 
+	 * to be anything the shell will leave alone */
+	if (for_script == STI_TRUE)
+	{
+		outputPuts(&name, "\"$SDPD_OUT_DIR\"/");
+		shellQuote(&name, baseName(path), strlen(baseName(path)), 
+			quote_style);
+	}
+	else
+	{
+		outputPuts(&name, "<REPLACE_ME>");
+	}
+
+	if (outputPutc(&name, '\0') != 0)
+	{
+		fprintf(stderr, "Unable to allocate output name for %s\n", 
+			path);
+		outputFree(&name);
+
+		return 1;
+	}
+
+	outputReset(out);
+	ret = dumpSDPrompt(path, fhandle, format, out, &marks, name.data);
+	outputFree(&name);
+
+	if (ret != 0)
+	{
+		fprintf(stderr, "Skipping %s\n", path);
+
+		return 1;
+	}
+
+	command_len = out->len;
+
+	if (((command = outputDetach(out)) == NULL)
+	|| (scriptBatchAdd(batch, path, command, command_len, marks.keys,
+		&marks.seed, &marks.output, &marks.values) != 0))
+	{
+		fprintf(stderr, "Unable to queue invocation for %s\n", path);
+		free(command);
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Picks the parameters apart into a catalog row instead of an invocation */
+static int catalogInvocation(const char *path, FILE *fhandle, 
+	const enum imageFormat format, struct catalogWriter *writer)
+{
+	struct catalogRecord record;
+	struct stiToken *tokens = NULL;
+	size_t i, num_tokens = 0;
+	char *buffer = NULL;
+	int ret;
+
+	if (tokenizeParams(fhandle, format, &buffer, &tokens, &num_tokens) 
+		!= 0)
+	{
+		fprintf(stderr, "Skipping %s\n", path);
+
+		return 1;
+	}
+
+	catalogRecordInit(&record, path);
+
+	for (i = 0; i < num_tokens; i++)
+	{
+		const char *substr = buffer + tokens[i].token_start;
+		const size_t token_len 
+			= tokens[i].token_end - tokens[i].token_start;
+		char label[LABEL_LIM + 1];
+		const size_t j = tokenLabel(substr, label);
+
+		if ((j != 0) && (j <= token_len))
+		{
+			catalogRecordField(&record, chomp(label), substr + j, 
+				token_len - j);
+		}
+	}
+
+	checkHeader(path, fhandle, format, buffer, tokens, num_tokens);
+	headerValues(&record.values);
+	reportMalformed(path, &record.values);
+
+	if ((ret = catalogWriterAdd(writer, &record)) != 0)
+	{
+		fprintf(stderr, "Unable to add %s to the catalog\n", path);
+	}
+
+	free(tokens);
+	free(buffer);
+
+	return ret;
+}
+
+/* Only counts what the image used, the invocation is never formatted */
+static int summaryInvocation(const char *path, FILE *fhandle, 
+	const enum imageFormat format, struct summary *sum)
+{
+	struct paramValues values = {0};
+	struct stiToken *tokens = NULL;
+	size_t i, num_tokens = 0;
+	char *buffer = NULL;
+	int ret = 0;
+
+	if (tokenizeParams(fhandle, format, &buffer, &tokens, &num_tokens) 
+		!= 0)
+	{
+		fprintf(stderr, "Skipping %s\n", path);
+
+		return 1;
+	}
+
+	for (i = 0; i < num_tokens; i++)
+	{
+		const char *substr = buffer + tokens[i].token_start;
+		const size_t token_len 
+			= tokens[i].token_end - tokens[i].token_start;
+		char label[LABEL_LIM + 1];
+		const size_t j = tokenLabel(substr, label);
+
+		if ((j != 0) && (j <= token_len))
+		{
+			paramDecode(&values, chomp(label), substr + j, 
+				token_len - j);
+			ret |= summaryField(sum, chomp(label), substr + j,
+				token_len - j);
+		}
+	}
+
+	checkHeader(path, fhandle, format, buffer, tokens, num_tokens);
+	headerValues(&values);
+	reportMalformed(path, &values);
+	summaryValues(sum, &values);
+
+	if (ret != 0)
+	{
+		fprintf(stderr, "Unable to count everything in %s\n", path);
+	}
+
+	free(tokens);
+	free(buffer);
+
+	return ret;
+}
+
+/* One tab separated line per image, the path and then each field in the
+ * order asked for, left empty when the image doesn't have it */
+static int fieldsInvocation(const char *path, FILE *fhandle, 
+	const enum imageFormat format, struct outputBuffer *out)
+{
+	struct stiToken *tokens = NULL;
+	size_t i, j, num_tokens = 0;
+	char *buffer = NULL;
+
+	if (tokenizeParams(fhandle, format, &buffer, &tokens, &num_tokens) 
+		!= 0)
+	{
+		fprintf(stderr, "Skipping %s\n", path);
+
+		return 1;
+	}
+
+	outputReset(out);
+	outputPuts(out, path);
+
+	for (i = 0; i < num_fields; i++)
+	{
+		outputPutc(out, '\t');
+
+		for (j = 0; j < num_tokens; j++)
+		{
+			const char *substr = buffer + tokens[j].token_start;
+			size_t token_len 
+				= tokens[j].token_end - tokens[j].token_start;
+			char label[LABEL_LIM + 1];
+			const size_t k = tokenLabel(substr, label);
+
+			if ((k != 0) && (k <= token_len)
+			&& (strcmp(chomp(label), field_labels[i]) == 0))
+			{
+				token_len -= k;
+				substr = paramTrim(substr + k, &token_len);
+				outputAppend(out, substr, token_len);
+
+				break;
+			}
+		}
+	}
+
+	outputPutc(out, '\n');
+
+	if (out->error == 0)
+	{
+		fwrite(out->data, sizeof(char), out->len, stdout);
+	}
+
+	free(tokens);
+	free(buffer);
+
+	return out->error;
+}
+
+/* Formats the image just as the plain dump would but into the spool, only
+ * a small record of its sort keys and where it went is kept */
+static int sortInvocation(const char *path, FILE *fhandle, 
+	const enum imageFormat format, struct outputBuffer *out, 
+	FILE *spool, uint64_t *spool_len, struct sortRuns *sorter, 
+	struct internPool *pool)
+{
+	struct sortRecord record = {0};
+	struct scriptEntry marks;
+	struct stat info;
+	const struct scriptSpan *model = &marks.keys[SCRIPT_KEY_MODEL];
+	const uint32_t size_bits 
+		= PARAM_BIT(PARAM_WIDTH) | PARAM_BIT(PARAM_HEIGHT);
+	size_t header_len;
+	int ret = 0;
+
+	outputReset(out);
+	outputPutc(out, '\n');
+	outputPuts(out, path);
+	outputPuts(out, ":\n\n");
+	header_len = out->len;
+
+	/* Failures keep their header like they would unsorted */
+	if (dumpSDPrompt(path, fhandle, format, out, &marks, NULL) != 0)
+	{
+		out->len = header_len;
+		memset(&marks, 0, sizeof(struct scriptEntry));
+		ret = 1;
+	}
+
+	if ((model->len != 0) && (internString(pool, out->data + model->start,
+		model->len, &record.model) == 0))
+	{
+		record.present |= SORT_BIT(SORT_KEY_MODEL);
+	}
+
+	if ((marks.values.present & PARAM_BIT(PARAM_SEED)) != 0)
+	{
+		record.seed = marks.values.seed;
+		record.present |= SORT_BIT(SORT_KEY_SEED);
+	}
+
+	if ((marks.values.present & PARAM_BIT(PARAM_STEPS)) != 0)
+	{
+		record.steps = marks.values.steps;
+		record.present |= SORT_BIT(SORT_KEY_STEPS);
+	}
+
+	if ((marks.values.present & PARAM_BIT(PARAM_CFG)) != 0)
+	{
+		record.cfg = marks.values.cfg;
+		record.present |= SORT_BIT(SORT_KEY_CFG);
+	}
+
+	if ((marks.values.present & size_bits) == size_bits)
+	{
+		record.size = (uint64_t) marks.values.width 
+			* marks.values.height;
+		record.present |= SORT_BIT(SORT_KEY_SIZE);
+	}
+
+	if (stat(path, &info) == 0)
+	{
+		record.mtime = (uint64_t) info.st_mtime;
+		record.present |= SORT_BIT(SORT_KEY_MTIME);
+	}
+
+	record.offset = *spool_len;
+	record.len = (uint32_t) out->len;
+
+	if ((out->error != 0) || (out->len > UINT32_MAX)
+	|| (fwrite(out->data, sizeof(char), out->len, spool) != out->len)
+	|| (sortRunsAdd(sorter, &record) != 0))
+	{
+		fprintf(stderr, "Unable to queue %s for sorting\n", path);
+
+		return 1;
+	}
+
+	*spool_len += out->len;
+
+	return ret;
+}
+
+/* Copies each spooled image out in sorted order */
+static int printSorted(struct sortRuns *sorter, FILE *spool)
+{
+	struct sortRecord record;
+	char chunk[4096];
+	int status;
+
+	if ((fflush(spool) != 0) || (sortRunsFinish(sorter) != 0))
+	{
+		fprintf(stderr, "Unable to sort the output\n");
+
+		return 1;
+	}
+
+	while ((status = sortRunsNext(sorter, &record)) == 0)
+	{
+		size_t left = record.len;
+
+		if (fseek(spool, (long) record.offset, SEEK_SET) != 0)
+		{
+			status = -1;
+
+			break;
+		}
+
+		while (left != 0)
+		{
+			const size_t want = (left < sizeof(chunk)) 
+				? left : sizeof(chunk);
+
+			if (fread(chunk, sizeof(char), want, spool) != want)
+			{
+				break;
+			}
+
+			fwrite(chunk, sizeof(char), want, stdout);
+			left -= want;
+		}
+
+		if (left != 0)
+		{
+			status = -1;
+
+			break;
+		}
+	}
+
+	if (status < 0)
+	{
+		fprintf(stderr, "Unable to read back the sorted output\n");
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Only the prompt itself is split into terms, the negative prompt is mostly
+ * the same boilerplate everywhere and would crowd out the rest */
+static int termsInvocation(const char *path, FILE *fhandle, 
+	const enum imageFormat format, struct termSketch *sketch)
+{
+	struct stiToken *tokens = NULL;
+	size_t i, num_tokens = 0;
+	char *buffer = NULL;
+	int ret = 0;
+
+	if (tokenizeParams(fhandle, format, &buffer, &tokens, &num_tokens) 
+		!= 0)
+	{
+		fprintf(stderr, "Skipping %s\n", path);
+
+		return 1;
+	}
+
+	for (i = 0; i < num_tokens; i++)
+	{
+		const char *substr = buffer + tokens[i].token_start;
+		const size_t token_len 
+			= tokens[i].token_end - tokens[i].token_start;
+		char label[LABEL_LIM + 1];
+		const size_t j = tokenLabel(substr, label);
+
+		if ((j != 0) && (j <= token_len)
+		&& (strcmp(chomp(label), "parameters") == 0))
+		{
+			ret = termSketchPrompt(sketch, substr + j, token_len - j);
+
+			break;
+		}
+	}
+
+	if (ret != 0)
+	{
+		fprintf(stderr, "Unable to count the terms in %s\n", path);
+	}
+
+	free(tokens);
+	free(buffer);
+
+	return ret;
+}
+
+/* Keeps only the prompt's signature, the invocation itself is formatted 
+ * again later for just the one image that represents each cluster */
+static int clusterInvocation(const char *path, const size_t id, 
+	FILE *fhandle, const enum imageFormat format, struct clusterSet *set)
+{
+	struct stiToken *tokens = NULL;
+	size_t i, num_tokens = 0;
+	char *buffer = NULL;
+	int ret = 0;
+
+	if (tokenizeParams(fhandle, format, &buffer, &tokens, &num_tokens) 
+		!= 0)
+	{
+		fprintf(stderr, "Skipping %s\n", path);
+
+		return 1;
+	}
+
+	for (i = 0; i < num_tokens; i++)
+	{
+		const char *substr = buffer + tokens[i].token_start;
+		const size_t token_len 
+			= tokens[i].token_end - tokens[i].token_start;
+		char label[LABEL_LIM + 1];
+		const size_t j = tokenLabel(substr, label);
+
+		if ((j != 0) && (j <= token_len)
+		&& (strcmp(chomp(label), "parameters") == 0))
+		{
+			ret = clusterAddPrompt(set, id, substr + j, 
+				token_len - j);
+
+			break;
+		}
+	}
+
+	if (ret != 0)
+	{
+		fprintf(stderr, "Unable to add %s to a cluster\n", path);
+	}
+
+	free(tokens);
+	free(buffer);
+
+	return ret;
+}
+
+/* Clusters of one aren't printed, each of the rest is led by the invocation
+ * of its first image and then the paths of all of its members */
+static int printClusters(struct clusterSet *set, char **argv, 
+	struct outputBuffer *out)
+{
+	size_t i, end, num_clusters = 0;
+	int ret = 0;
+
+	if (clusterBuild(set) != 0)
+	{
+		fprintf(stderr, "Unable to build clusters\n");
+
+		return 1;
+	}
+
+	for (i = 0; i < set->len; i = end)
+	{
+		const char *path = argv[set->ids[set->order[i]]];
+		FILE *handle = NULL;
+		enum imageFormat format;
+
+		for (end = i + 1; (end < set->len) 
+		&& (set->roots[set->order[end]] 
+			== set->roots[set->order[i]]); end++);
+
+		if (end - i == 1)
+		{
+			continue;
+		}
+
+		fprintf(stdout, "\nCluster %lu, %lu images:\n\n", 
+			(unsigned long) ++num_clusters, (unsigned long) (end - i));
+		outputReset(out);
+
+		ioOpen();
+
+		if (((handle = fopen(path, "rb")) == NULL)
+		|| ((format = imageDetect(handle)) == IMAGE_UNKNOWN)
+		|| (dumpSDPrompt(path, handle, format, out, NULL, NULL) != 0))
+		{
+			fprintf(stderr, "Unable to reread %s\n", path);
+			ret = 1;
+		}
+		else
+		{
+			fwrite(out->data, sizeof(char), out->len, stdout);
+		}
+
+		if (handle != NULL)
+		{
+			ioRelease(handle);
+			fclose(handle);
+		}
+
+		for (; i < end; i++)
+		{
+			fprintf(stdout, "    %s\n", argv[set->ids[set->order[i]]]);
+		}
+	}
+
+	return ret;
+}
+
+struct pixelEntry
+{
+	uint64_t hash;
+	size_t id;
+	int has_params;
+};
+
+/* Only the pixel hash is kept, entries are packed into an outputBuffer the
+ * same as the catalog columns are */
+static int dedupeInvocation(const char *path, const size_t id, 
+	FILE *fhandle, const enum imageFormat format, 
+	struct outputBuffer *entries)
+{
+	struct pixelEntry entry;
+
+	if (format != IMAGE_PNG)
+	{
+		fprintf(stderr, "Skipping %s, only PNG image data is compared\n",
+			path);
+
+		return 1;
+	}
+
+	entry.id = id;
+
+	if (pngHashPixels(fhandle, &entry.hash, &entry.has_params) != 0)
+	{
+		fprintf(stderr, "Unable to hash the image data of %s\n", path);
+
+		return 1;
+	}
+
+	if (outputAppend(entries, (const char *) &entry, 
+		sizeof(struct pixelEntry)) != 0)
+	{
+		fprintf(stderr, "Unable to queue %s\n", path);
+
+		return 1;
+	}
+
+	return 0;
+}
+
+static int pixelEntryCmp(const void *left, const void *right)
+{
+	const struct pixelEntry *l = (const struct pixelEntry *) left;
+	const struct pixelEntry *r = (const struct pixelEntry *) right;
+
+	if (l->hash != r->hash)
+	{
+		return (l->hash < r->hash) ? -1 : 1;
+	}
+
+	return (l->id < r->id) ? -1 : (l->id > r->id);
+}
+
+static void printDuplicate(const struct pixelEntry *entry, char **argv)
+{
+	fprintf(stdout, "    %s%s\n", argv[entry->id],
+		(entry->has_params != 0) ? " (parameters)" : "");
+}
+
+/* Each group of identical image data leads with a copy that still has its
+ * parameters, if any do, as that's the one worth keeping */
+static void printDuplicates(struct outputBuffer *entries, char **argv)
+{
+	struct pixelEntry *list = (struct pixelEntry *) entries->data;
+	const size_t len = entries->len / sizeof(struct pixelEntry);
+	size_t i, j, end;
+
+	if (len == 0)
+	{
+		return;
+	}
+
+	qsort(list, len, sizeof(struct pixelEntry), pixelEntryCmp);
+
+	for (i = 0; i < len; i = end)
+	{
+		size_t keep;
+
+		for (end = i + 1; (end < len) && (list[end].hash 
+			== list[i].hash); end++);
+
+		if (end - i == 1)
+		{
+			continue;
+		}
+
+		for (j = i; (j < end) && (list[j].has_params == 0); j++);
+
+		keep = (j == end) ? i : j;
+		fprintf(stdout, "\n%lu copies of %016llx:\n", 
+			(unsigned long) (end - i), 
+			(unsigned long long) list[i].hash);
+
+		printDuplicate(&list[keep], argv);
+
+		for (j = i; j < end; j++)
+		{
+			if (j != keep)
+			{
+				printDuplicate(&list[j], argv);
+			}
+		}
+	}
+}
+
+/* Text chunks --rewrite drops, the ones front ends put generation data in */
+static const char *const rewrite_strip[] = {"parameters", "prompt", 
+	"workflow"};
+
+#define REWRITE_NUM_STRIP (sizeof(rewrite_strip) / sizeof(rewrite_strip[0]))
+
+/* Takes KEY=VALUE for --set-text, the key has to be a keyword the PNG spec 
+ * allows and the value can't hold a null byte anyway */
+static int parseNewText(char *arg, struct pngNewText *text)
+{
+	char *split = strchr(arg, '=');
+	size_t i;
+
+	if ((split == NULL) || (split == arg) || (split - arg > PNG_KEYWORD_MAX)
+	|| (arg[0] == ' ') || (split[-1] == ' '))
+	{
+		return 1;
+	}
+
+	for (i = 0; arg + i != split; i++)
+	{
+		const unsigned char ch = (unsigned char) arg[i];
+
+		if ((ch < 32) || ((ch > 126) && (ch < 161)))
+		{
+			return 1;
+		}
+	}
+
+	*split = '\0';
+	text->keyword = arg;
+	text->text = split + 1;
+
+	return 0;
+}
+
+/* Writes a copy of the PNG under the same name in dir with its generation 
+ * text stripped and any --set-text chunks put in their place */
+static int rewriteInvocation(const char *path, FILE *fhandle, 
+	const enum imageFormat format, const char *dir, 
+	const struct pngNewText *texts, const size_t num_texts)
+{
+	const size_t dir_len = strlen(dir);
+	struct outputBuffer out_path = {0};
+	struct stat in_info, out_info;
+	FILE *out = NULL;
+	size_t num_stripped = 0;
+	int ret;
+
+	if (format != IMAGE_PNG)
+	{
+		fprintf(stderr, "Skipping %s, only PNGs can be rewritten\n",
+			path);
+
+		return 1;
+	}
+
+	outputPuts(&out_path, dir);
+
+	if ((dir_len != 0) && (dir[dir_len - 1] != '/') 
+	&& (dir[dir_len - 1] != '\\'))
+	{
+		outputPutc(&out_path, '/');
+	}
+
+	outputPuts(&out_path, baseName(path));
+
+	if (outputPutc(&out_path, '\0') != 0)
+	{
+		fprintf(stderr, "Unable to allocate output name for %s\n", 
+			path);
+		outputFree(&out_path);
+
+		return 1;
+	}
+
+	/* Writing over the input would truncate it before it's been read */
+	if ((stat(path, &in_info) == 0) && (stat(out_path.data, &out_info) == 0)
+	&& (in_info.st_ino != 0) && (in_info.st_ino == out_info.st_ino) 
+	&& (in_info.st_dev == out_info.st_dev))
+	{
+		fprintf(stderr, "Skipping %s, it would be rewritten in place\n",
+			path);
+		outputFree(&out_path);
+
+		return 1;
+	}
+
+	if ((out = fopen(out_path.data, "wb")) == NULL)
+	{
+		fprintf(stderr, "Error opening %s\n", out_path.data);
+		outputFree(&out_path);
+
+		return 1;
+	}
+
+	ret = pngRewrite(fhandle, out, rewrite_strip, REWRITE_NUM_STRIP, 
+		texts, num_texts, &num_stripped);
+	ret |= (fclose(out) != 0);
+
+	if (ret != 0)
+	{
+		fprintf(stderr, "Unable to rewrite %s\n", path);
+		remove(out_path.data);
+	}
+	else
+	{
+		fprintf(stdout, "%s: %lu text chunks stripped, written to %s\n",
+			path, (unsigned long) num_stripped, out_path.data);
+	}
+
+	outputFree(&out_path);
+
+	return ret;
+}
+
+/* Only PNGs can be checked without reading their text, the rest and any
+ * PNG with a bad IHDR are kept and left for the mode to deal with */
+static STI_BOOL tooSmall(FILE *fhandle, const enum imageFormat format,
+	const uint32_t min_width, const uint32_t min_height)
+{
+	struct pngHeader header;
+
+	return ((format == IMAGE_PNG) 
+		&& (pngReadHeader(fhandle, &header) == 0)
+		&& ((header.width < min_width) 
+		|| (header.height < min_height))) ? STI_TRUE : STI_FALSE;
+}
+
+static void printHelp(void)
+{
+	fputs("stable-diffusion.cpp Prompt Dumper, sdPromptDumper:\n\n"
+		"-M, --model  <DIR PATH> : Path to user's model directory\n"
+		"-L, --lora   <DIR PATH> : Path to user's LoRA directory\n"
+		"-B, --bin    <DIR PATH> : Path to sd binary directory\n"
+		"-E, --exe   <FILE NAME> : Alternative name for executable\n" 
+		"-V, --vae   <FILE PATH> : As above, include file as well\n"
+		"-c, --config <DIR PATH> : Path to alt config file directory\n"
+		"-S, --script   <FILE>   : Writes a model-sorted shell script\n"
+		"-j, --jobs     <NUM>    : Splits the script into NUM files\n"
+		"-C, --collapse-seeds    : Batches seed-only variants\n"
+		"-T, --text-first        : Stops looking for text at IDAT\n"
+		"-X, --export-catalog <F>: Writes a columnar catalog to F\n"
+		"-Q, --catalog-query  <F>: Summarizes catalog F, any other\n"
+		"                          args are filters: steps>=20 ...\n"
+		"-u, --summarize         : Prints usage stats of all inputs\n"
+		"-k, --top-terms <NUM>   : Prints the NUM commonest terms\n"
+		"-G, --cluster <JACCARD> : Groups prompts with at least this\n"
+		"                          share of terms in common, 0 to 1\n"
+		"-P, --dedupe-pixels     : Groups PNGs with the same pixels\n"
+		"-F, --fields <LIST>     : Prints only these as a TSV line,\n"
+		"                          eg: seed,model,prompt\n"
+		"-s, --shard    <I/N>    : Only reads inputs in shard I of N\n"
+		"-m, --merge             : Merges sorted shard outputs, any\n"
+		"                          other args are the files to merge\n"
+		"-O, --sort-by <KEYS>    : Sorts the output by model, seed,\n"
+		"                          steps, cfg, size, mtime, eg: model,seed\n"
+		"-W, --sort-mem <MIB>    : Memory to sort in before spilling\n"
+		"-R, --rewrite <DIR>     : Copies PNGs to DIR without their\n"
+		"                          generation text\n"
+		"-K, --set-text <K=V>    : Adds tEXt chunk K to rewritten PNGs\n"
+		"-b, --io-budget <MB/S>  : Caps how fast files are read\n"
+		"-I, --iops     <NUM>    : Caps file opens and reads a second\n"
+		"-N, --background        : Idle I/O priority, and read files\n"
+		"                          are dropped from the page cache\n"
+		"-x, --min-width  <PX>   : Skips PNGs narrower than PX\n"
+		"-y, --min-height <PX>   : Skips PNGs shorter than PX\n"
+		"-q, --quote <STYLE>     : Quotes values double or single\n"
+		"-t, --template <TEXT>   : Formats each image as TEXT, eg:\n"
+		"                          \"{exe} {args} -o out/{basename}\"\n"
+		"-Z, --trace    <FILE>   : Writes a per-file timeline to FILE\n"
+		"-a, --abrv              : Abbreviates switches in output\n"
+		"-e, --endian            : Prints assumed endian form, exits\n"
+		"-h, --help              : Prints this help message, exits\n\n"
+		"./sdPromptDumper [FLAGS]... [PNG Files]...\n\n"
+		"Example:\n"
+		"./sdPromptDumper --model ~/.models/ --vae ./myVAE.safetensors"
+		" aLovelyCat.png\n\n", stdout);
+}
+
+int main(int argc, char **argv)
+{
+	const struct portoptVerboseOpt opts[] =
+	{
+		{'M', "model",  PORTOPT_TRUE},
+		{'L', "lora",   PORTOPT_TRUE},
+		{'B', "bin",    PORTOPT_TRUE},
+		{'E', "exe",    PORTOPT_TRUE},
+		{'V', "vae",    PORTOPT_TRUE},
+		{'c', "config", PORTOPT_TRUE},
+		{'S', "script", PORTOPT_TRUE},
+		{'j', "jobs",   PORTOPT_TRUE},
+		{'C', "collapse-seeds", PORTOPT_FALSE},
+		{'T', "text-first",     PORTOPT_FALSE},
+		{'X', "export-catalog", PORTOPT_TRUE},
+		{'Q', "catalog-query",  PORTOPT_TRUE},
+		{'u', "summarize",      PORTOPT_FALSE},
+		{'k', "top-terms",      PORTOPT_TRUE},
+		{'G', "cluster",        PORTOPT_TRUE},
+		{'P', "dedupe-pixels",  PORTOPT_FALSE},
+		{'F', "fields",         PORTOPT_TRUE},
+		{'s', "shard",          PORTOPT_TRUE},
+		{'m', "merge",          PORTOPT_FALSE},
+		{'O', "sort-by",        PORTOPT_TRUE},
+		{'W', "sort-mem",       PORTOPT_TRUE},
+		{'R', "rewrite",        PORTOPT_TRUE},
+		{'K', "set-text",       PORTOPT_TRUE},
+		{'b', "io-budget",      PORTOPT_TRUE},
+		{'I', "iops",           PORTOPT_TRUE},
+		{'N', "background",     PORTOPT_FALSE},
+		{'x', "min-width",      PORTOPT_TRUE},
+		{'y', "min-height",     PORTOPT_TRUE},
+		{'q', "quote",          PORTOPT_TRUE},
+		{'t', "template",       PORTOPT_TRUE},
+		{'Z', "trace",          PORTOPT_TRUE},
+		{'a', "abrv",   PORTOPT_FALSE},
+		{'e', "endian", PORTOPT_FALSE},
+		{'h', "help",   PORTOPT_FALSE}
+	};
+	const size_t num_opts = sizeof(opts) / sizeof(opts[0]);
+	const size_t argl = (size_t) argc;
+	size_t i, ind = 0;
+	char *alt_cfg_path = NULL;
+	char *script_path  = NULL;
+	char *catalog_path = NULL;
+	char *query_path   = NULL;
+	char *sort_keys    = NULL;
+	char *rewrite_dir  = NULL;
+	char *trace_path   = NULL;
+	FILE *spool        = NULL;
+	uint64_t spool_len = 0;
+	size_t sort_budget = SORT_DEFAULT_BUDGET;
+	float io_budget = 0;
+	uint32_t io_ops = 0;
+	STI_BOOL background = STI_FALSE;
+	uint32_t min_width = 0, min_height = 0;
+	size_t num_jobs = 1;
+	size_t top_terms = 0;
+	size_t shard_index = 0, shard_count = 0;
+	float cluster_min = -1;
+	STI_BOOL collapse_seeds = STI_FALSE;
+	STI_BOOL summarize      = STI_FALSE;
+	STI_BOOL dedupe         = STI_FALSE;
+	STI_BOOL merge          = STI_FALSE;
+	struct outputBuffer out = {0};
+	struct scriptBatch batch = {0};
+	struct catalogWriter writer;
+	struct internPool pool = {0};
+	struct summary sum = {0};
+	struct termSketch sketch = {0};
+	struct clusterSet clusters = {0};
+	struct outputBuffer pixels = {0};
+	struct sortRuns sorter = {0};
+	struct pngNewText new_texts[PNG_TEXT_MAX];
+	size_t num_new_texts = 0;
+	int flag, num_bad_files = 0;
+
+	if (setupHashtable() == 1)
+	{
+		fprintf(stderr, "Failed to initialize parameter hashtable\n");
+
+		return 1;
+	}
+
+	while ((flag = portoptVerbose(argl, argv, opts, num_opts, &ind)) != -1)
+	{
+		switch (flag)
+		{
+			case 'M':
+				model_path = lazyStrdup(portoptGetArg(
+					argl, argv, &ind));
 				break;
 			case 'L':
 				lora_path = lazyStrdup(portoptGetArg(
@@ -482,12 +2423,235 @@ int main(int argc, char **argv)
 				vae_path = lazyStrdup(portoptGetArg(
 					argl, argv, &ind));
 				break;
+			case 't':
+				template_text = lazyStrdup(portoptGetArg(
+					argl, argv, &ind));
+				break;
 			case 'a':
 				abrv_flags = STI_TRUE;
 				break;
+			case 'C':
+				collapse_seeds = STI_TRUE;
+				break;
+			case 'T':
+				text_layout = PNG_LAYOUT_TEXT_FIRST;
+				break;
+			case 'u':
+				summarize = STI_TRUE;
+				break;
+			case 'b':
+			{
+				const char *arg 
+					= portoptGetArg(argl, argv, &ind);
+
+				if ((arg == NULL) || (paramParseFloat(arg, 
+					strlen(arg), &io_budget) != 0)
+				|| (io_budget <= 0))
+				{
+					fprintf(stderr, "--io-budget expects a "
+						"positive number of MB/s\n");
+
+					return 1;
+				}
+
+				break;
+			}
+			case 'I':
+			{
+				const char *arg 
+					= portoptGetArg(argl, argv, &ind);
+
+				if ((arg == NULL) || (paramParseU32(arg, 
+					strlen(arg), &io_ops) != 0) 
+				|| (io_ops == 0))
+				{
+					fprintf(stderr, "--iops expects a "
+						"positive number\n");
+
+					return 1;
+				}
+
+				break;
+			}
+			case 'N':
+				background = STI_TRUE;
+				break;
+			case 'q':
+			{
+				const char *arg 
+					= portoptGetArg(argl, argv, &ind);
+
+				if ((arg == NULL) 
+				|| (shellStyleParse(arg, &quote_style) != 0))
+				{
+					fprintf(stderr, "--quote expects double "
+						"or single\n");
+
+					return 1;
+				}
+
+				break;
+			}
+			case 'x':
+			case 'y':
+			{
+				const char *arg 
+					= portoptGetArg(argl, argv, &ind);
+
+				if ((arg == NULL) || (paramParseU32(arg, 
+					strlen(arg), (flag == 'x') 
+					? &min_width : &min_height) != 0))
+				{
+					fprintf(stderr, "--min-%s expects a "
+						"number of pixels\n", (flag == 'x')
+						? "width" : "height");
+
+					return 1;
+				}
+
+				break;
+			}
+			case 'R':
+				rewrite_dir = portoptGetArg(argl, argv, &ind);
+				break;
+			case 'Z':
+				trace_path = portoptGetArg(argl, argv, &ind);
+				break;
+			case 'K':
+			{
+				char *arg = portoptGetArg(argl, argv, &ind);
+
+				if ((arg == NULL) || (num_new_texts == PNG_TEXT_MAX)
+				|| (parseNewText(arg, &new_texts[num_new_texts])
+					!= 0))
+				{
+					fprintf(stderr, "--set-text expects "
+						"KEYWORD=TEXT, keywords being 1 "
+						"to 79 printable characters\n");
+
+					return 1;
+				}
+
+				num_new_texts++;
+
+				break;
+			}
+			case 'P':
+				dedupe = STI_TRUE;
+				break;
+			case 'F':
+				if (parseFields(portoptGetArg(argl, argv, 
+					&ind)) != 0)
+				{
+					fprintf(stderr, "--fields needs a comma "
+						"separated list of fields\n");
+
+					return 1;
+				}
+				break;
+			case 's':
+				if (shardParse(portoptGetArg(argl, argv, &ind),
+					&shard_index, &shard_count) != 0)
+				{
+					fprintf(stderr, "--shard needs I/N with "
+						"I below N, eg: 0/4\n");
+
+					return 1;
+				}
+				break;
+			case 'm':
+				merge = STI_TRUE;
+				break;
 			case 'c':
 				alt_cfg_path = portoptGetArg(argl, argv, &ind);
 				break;
+			case 'S':
+				script_path = portoptGetArg(argl, argv, &ind);
+				break;
+			case 'X':
+				catalog_path = portoptGetArg(argl, argv, &ind);
+				break;
+			case 'Q':
+				query_path = portoptGetArg(argl, argv, &ind);
+				break;
+			case 'j':
+			{
+				const char *arg 
+					= portoptGetArg(argl, argv, &ind);
+				uint32_t val;
+
+				if ((arg == NULL) || (paramParseU32(arg, 
+					strlen(arg), &val) != 0) || (val == 0))
+				{
+					fprintf(stderr, "--jobs expects a "
+						"positive number\n");
+
+					return 1;
+				}
+
+				num_jobs = val;
+				break;
+			}
+			case 'O':
+				sort_keys = portoptGetArg(argl, argv, &ind);
+				break;
+			case 'W':
+			{
+				const char *arg 
+					= portoptGetArg(argl, argv, &ind);
+				char *end = NULL;
+
+				if ((arg == NULL)
+				|| ((sort_budget = strtoul(arg, &end, 10)) == 0)
+				|| (*end != '\0') || (sort_budget > 65536))
+				{
+					fprintf(stderr, "--sort-mem expects a "
+						"number of MiB up to 65536\n");
+
+					return 1;
+				}
+
+				sort_budget <<= 20;
+
+				break;
+			}
+			case 'k':
+			{
+				const char *arg 
+					= portoptGetArg(argl, argv, &ind);
+				uint32_t val;
+
+				if ((arg == NULL) || (paramParseU32(arg, 
+					strlen(arg), &val) != 0) || (val == 0))
+				{
+					fprintf(stderr, "--top-terms expects a "
+						"positive number\n");
+
+					return 1;
+				}
+
+				top_terms = val;
+				break;
+			}
+			case 'G':
+			{
+				const char *arg 
+					= portoptGetArg(argl, argv, &ind);
+
+				if ((arg == NULL)
+				|| (paramParseFloat(arg, strlen(arg), 
+					&cluster_min) != 0)
+				|| (cluster_min <= 0) || (cluster_min > 1))
+				{
+					fprintf(stderr, "--cluster expects a "
+						"similarity above 0 and up to 1"
+						"\n");
+
+					return 1;
+				}
+
+				break;
+			}
 			case 'e':
 				fputs((porteggIsLittle() == PORTEGG_TRUE)
 					? "little-endian\n"
@@ -502,6 +2666,128 @@ int main(int argc, char **argv)
 		}
 	}
 
+	/* The remaining arguments are filters rather than images */
+	if (query_path != NULL)
+	{
+		struct catalog cat;
+
+		if (catalogOpen(&cat, query_path) != 0)
+		{
+			return 1;
+		}
+
+		num_bad_files = catalogQuery(&cat, (const char * const *) 
+			(argv + ind), argl - ind, stdout);
+		catalogClose(&cat);
+
+		return num_bad_files;
+	}
+
+	if (merge == STI_TRUE)
+	{
+		return shardMerge(argv + ind, argl - ind, stdout);
+	}
+
+	if ((top_terms != 0) && (termSketchInit(&sketch, top_terms) != 0))
+	{
+		fprintf(stderr, "Unable to allocate %lu term counters\n",
+			(unsigned long) top_terms);
+
+		return 1;
+	}
+
+	if (cluster_min > 0)
+	{
+		clusterInit(&clusters, cluster_min);
+	}
+
+	/* Those modes come first, left alone an empty script would still be 
+	 * written */
+	if (((script_path != NULL) || (collapse_seeds == STI_TRUE))
+	&& ((catalog_path != NULL) || (summarize == STI_TRUE) 
+	|| (top_terms != 0) || (cluster_min > 0) || (dedupe == STI_TRUE) 
+	|| (rewrite_dir != NULL)))
+	{
+		fprintf(stderr, "--%s has no effect with other modes\n",
+			(script_path != NULL) ? "script" : "collapse-seeds");
+		script_path = NULL;
+		collapse_seeds = STI_FALSE;
+	}
+
+	/* The fields filter is applied while reading so the other modes can't
+	 * be allowed to see it */
+	if ((num_fields != 0) && ((catalog_path != NULL) 
+	|| (summarize == STI_TRUE) || (top_terms != 0) || (cluster_min > 0) 
+	|| (dedupe == STI_TRUE) || (rewrite_dir != NULL) 
+	|| (script_path != NULL) || (collapse_seeds == STI_TRUE)))
+	{
+		fprintf(stderr, "--fields has no effect with other modes\n");
+		num_fields = 0;
+	}
+
+	if (((io_budget > 0) || (io_ops != 0) || (background == STI_TRUE))
+	&& (ioThrottleSetup((double) io_budget * 1e6, (double) io_ops, 
+		(background == STI_TRUE)) != 0))
+	{
+		fprintf(stderr, "Unable to lower the I/O priority here, going "
+			"on without\n");
+	}
+
+	if ((trace_path != NULL) && (traceStart(trace_path, shard_index) != 0))
+	{
+		fprintf(stderr, "Unable to allocate the trace buffer\n");
+
+		return 1;
+	}
+
+	/* Only what was given here, one set in the .cfg file just sits idle 
+	 * for the modes that don't print invocations */
+	if ((template_text != NULL) && ((catalog_path != NULL) 
+	|| (summarize == STI_TRUE) || (top_terms != 0) || (cluster_min > 0) 
+	|| (dedupe == STI_TRUE) || (rewrite_dir != NULL) 
+	|| (num_fields != 0)))
+	{
+		fprintf(stderr, "--template has no effect with other modes\n");
+	}
+
+	if ((num_new_texts != 0) && (rewrite_dir == NULL))
+	{
+		fprintf(stderr, "--set-text has no effect without --rewrite\n");
+	}
+
+	/* Sorting is only for the plain dump, the others have orders of their
+	 * own */
+	if ((sort_keys != NULL) && ((catalog_path != NULL) 
+	|| (summarize == STI_TRUE) || (top_terms != 0) || (cluster_min > 0) 
+	|| (dedupe == STI_TRUE) || (rewrite_dir != NULL) 
+	|| (script_path != NULL) || (collapse_seeds == STI_TRUE) 
+	|| (num_fields != 0)))
+	{
+		fprintf(stderr, "--sort-by has no effect with other modes\n");
+		sort_keys = NULL;
+	}
+
+	if (sort_keys != NULL)
+	{
+		if (sortRunsInit(&sorter, sort_keys, sort_budget, &pool) != 0)
+		{
+			fprintf(stderr, "--sort-by needs a comma separated list "
+				"of keys\n");
+
+			return 1;
+		}
+
+		if ((spool = tmpfile()) == NULL)
+		{
+			fprintf(stderr, "Unable to create a temporary file to "
+				"sort in\n");
+
+			return 1;
+		}
+	}
+
+	catalogWriterInit(&writer, &pool);
+
 	if (ind == (size_t) argc)
 	{
 		fputs("Please supply a file path to an image generated with "
@@ -511,7 +2797,7 @@ int main(int argc, char **argv)
 	else /* only bother to fetch config if there are png arguments */
 	{
 		struct cfgArguments tmp = {&model_path, &lora_path, &vae_path, 
-			&bin_path, &exe_name, 0};
+			&bin_path, &exe_name, 0, &template_text};
 
 		if (abrv_flags == STI_FALSE)
 		{
@@ -524,34 +2810,213 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if ((template_text != NULL) && (setupTemplate(template_text) != 0))
+	{
+		fprintf(stderr, "Unable to use template \"%s\"\n", 
+			template_text);
+
+		return 1;
+	}
+
 	/* No need to try to act upon the program name, ie: argv[0] */
 	for (i = (ind == 0) ? 1 : ind; i < (size_t) argc; i++)
 	{
 		FILE *handle = NULL;
+		enum imageFormat format;
+		uint64_t file_begin, begin;
 
-		if ((handle = fopen(argv[i], "rb")) == NULL)
+		if ((shard_count != 0) 
+		&& (shardOf(argv[i], shard_count) != shard_index))
+		{
+			continue;
+		}
+
+		traceFile(argv[i]);
+		file_begin = traceNow();
+		ioOpen();
+		handle = fopen(argv[i], "rb");
+		traceSpan(TRACE_OPEN, file_begin);
+
+		if (handle == NULL)
 		{
 			fprintf(stderr, "Error opening %s\n", argv[i]);
 			num_bad_files++;
+			traceSpan(TRACE_FILE, file_begin);
 
 			continue;
 		}
 
-		if (pngValidate(handle) != 1)
+		begin = traceNow();
+		format = imageDetect(handle);
+		traceSpan(TRACE_VALIDATE, begin);
+
+		if (format == IMAGE_UNKNOWN)
 		{
-			fprintf(stderr, "\"%s\" is not a valid PNG file\n", 
-				argv[i]);
+			fprintf(stderr, "\"%s\" is not a PNG, JPEG, or WebP "
+				"file\n", argv[i]);
 			num_bad_files++;
 		}
+		else if (((min_width != 0) || (min_height != 0)) 
+		&& (tooSmall(handle, format, min_width, min_height) 
+			== STI_TRUE))
+		{
+			/* Filtered out, not an error */
+		}
+		else if (catalog_path != NULL)
+		{
+			num_bad_files += catalogInvocation(argv[i], handle, 
+				format, &writer);
+		}
+		else if (summarize == STI_TRUE)
+		{
+			num_bad_files += summaryInvocation(argv[i], handle,
+				format, &sum);
+		}
+		else if (top_terms != 0)
+		{
+			num_bad_files += termsInvocation(argv[i], handle,
+				format, &sketch);
+		}
+		else if (cluster_min > 0)
+		{
+			num_bad_files += clusterInvocation(argv[i], i, handle,
+				format, &clusters);
+		}
+		else if (dedupe == STI_TRUE)
+		{
+			num_bad_files += dedupeInvocation(argv[i], i, handle,
+				format, &pixels);
+		}
+		else if (rewrite_dir != NULL)
+		{
+			num_bad_files += rewriteInvocation(argv[i], handle,
+				format, rewrite_dir, new_texts, num_new_texts);
+		}
+		else if ((script_path != NULL) 
+		|| (collapse_seeds == STI_TRUE))
+		{
+			num_bad_files += queueInvocation(argv[i], handle, 
+				format, &out, &batch, (script_path != NULL));
+		}
+		else if (num_fields != 0)
+		{
+			num_bad_files += fieldsInvocation(argv[i], handle,
+				format, &out);
+		}
+		else if (sort_keys != NULL)
+		{
+			num_bad_files += sortInvocation(argv[i], handle, 
+				format, &out, spool, &spool_len, &sorter, 
+				&pool);
+		}
 		else
 		{
 			fprintf(stdout, "\n%s:\n\n", argv[i]);
-			num_bad_files += dumpSDPrompt(handle);	
+			outputReset(&out);
+
+			if (dumpSDPrompt(argv[i], handle, format, &out, NULL,
+				NULL) == 0)
+			{
+				begin = traceNow();
+				fwrite(out.data, sizeof(char), out.len, 
+					stdout);
+				traceSpan(TRACE_WRITE, begin);
+			}
+			else
+			{
+				num_bad_files++;
+			}
 		}
 
+		ioRelease(handle);
 		fclose(handle);
+		traceSpan(TRACE_FILE, file_begin);
+	}
+
+	if ((collapse_seeds == STI_TRUE)
+	&& (scriptBatchCollapseSeeds(&batch, abrv_flags) != 0))
+	{
+		fprintf(stderr, "Failed to collapse seed variants\n");
+		num_bad_files++;
+	}
+
+	if (script_path != NULL)
+	{
+		if (scriptBatchWrite(&batch, script_path, num_jobs) != 0)
+		{
+			fprintf(stderr, "Failed to write script %s\n",
+				script_path);
+			num_bad_files++;
+		}
+
+	}
+	else
+	{
+		scriptBatchPrint(&batch, stdout);
+
+		if (num_jobs != 1)
+		{
+			fprintf(stderr, "--jobs has no effect without "
+				"--script\n");
+		}
+	}
+
+	/* Same precedence as in the loop above */
+	if (catalog_path != NULL)
+	{
+		num_bad_files += (catalogWriterSave(&writer, catalog_path) 
+			!= 0);
+	}
+	else if (summarize == STI_TRUE)
+	{
+		summaryPrint(&sum, stdout);
+	}
+	else if (top_terms != 0)
+	{
+		if (termSketchPrint(&sketch, stdout) != 0)
+		{
+			fprintf(stderr, "Unable to sort the term counts\n");
+			num_bad_files++;
+		}
+	}
+	else if (cluster_min > 0)
+	{
+		num_bad_files += printClusters(&clusters, argv, &out);
+	}
+	else if (dedupe == STI_TRUE)
+	{
+		printDuplicates(&pixels, argv);
+	}
+	else if (sort_keys != NULL)
+	{
+		num_bad_files += printSorted(&sorter, spool);
+	}
+
+	scriptBatchFree(&batch);
+	catalogWriterFree(&writer);
+	internFree(&pool);
+	summaryFree(&sum);
+	termSketchFree(&sketch);
+	clusterFree(&clusters);
+	outputFree(&pixels);
+	sortRunsFree(&sorter);
+	loraIndexFree(&lora_index);
+
+	if ((model_state == DIR_LISTED) && (modelIndexSave(&model_index) != 0))
+	{
+		fprintf(stderr, "Unable to save model hashes to %s\n", 
+			model_path);
+	}
+
+	modelIndexFree(&model_index);
+
+	if (spool != NULL)
+	{
+		fclose(spool);
 	}
 
+	outputFree(&out);
+
 	if (model_path != NULL)
 	{
 		free(model_path);
@@ -572,6 +3037,10 @@ int main(int argc, char **argv)
 		free(bin_path);
 	}
 
+	free(template_text);
+	templateFree(&output_template);
+	num_bad_files += traceFinish();
+
 	return num_bad_files;
 }
 
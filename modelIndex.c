@@ -0,0 +1,416 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "internPool.h"
+#include "sha256.h"
+#include "dirList.h"
+#include "paramValues.h"
+#include "ioThrottle.h"
+#include "modelIndex.h"
+
+#define MODEL_READ_LEN 65536
+
+#ifndef S_ISREG /* Windows */
+#define S_ISREG(mode) (((mode) & _S_IFMT) == _S_IFREG)
+#endif
+
+/* Whatever sd is able to load as a model */
+static const char *const model_exts[] = {".safetensors", ".ckpt", ".gguf"};
+
+#define MODEL_NUM_EXTS (sizeof(model_exts) / sizeof(model_exts[0]))
+
+/* Either separator may end the directory, same as printModel assumes */
+static char* modelJoin(const char *dir, const char *name)
+{
+	const size_t dir_len = strlen(dir);
+	const size_t name_len = strlen(name);
+	const int sep = (dir_len != 0) && ((dir[dir_len - 1] == '/') 
+		|| (dir[dir_len - 1] == '\\'));
+	char *ret;
+
+	if ((ret = malloc(dir_len + name_len + 2)) != NULL)
+	{
+		memcpy(ret, dir, dir_len);
+
+		if (sep == 0)
+		{
+			ret[dir_len] = '/';
+		}
+
+		memcpy(ret + dir_len + (sep == 0), name, name_len + 1);
+	}
+
+	return ret;
+}
+
+static int modelVisit(const char *name, void *ctx)
+{
+	struct modelIndex *index = (struct modelIndex *) ctx;
+	const size_t len = strlen(name);
+	struct stat info;
+	char *path;
+	size_t i;
+	uint32_t id;
+	int status;
+
+	for (i = 0; (i < MODEL_NUM_EXTS) 
+	&& ((len <= strlen(model_exts[i]))
+	|| (strcmp(name + len - strlen(model_exts[i]), model_exts[i]) != 0));
+		i++);
+
+	if (i == MODEL_NUM_EXTS)
+	{
+		return 0;
+	}
+
+	if ((path = modelJoin(index->dir, name)) == NULL)
+	{
+		return 1;
+	}
+
+	status = stat(path, &info);
+	free(path);
+
+	if ((status != 0) || (S_ISREG(info.st_mode) == 0))
+	{
+		return 0;
+	}
+
+	if (index->len == index->cap)
+	{
+		const size_t new_cap = (index->cap == 0) 
+			? MODEL_GUESS_LEN : index->cap << 1;
+		struct modelFile *tmp = realloc(index->files, 
+			sizeof(struct modelFile) * new_cap);
+
+		if (tmp == NULL)
+		{
+			return 1;
+		}
+
+		index->files = tmp;
+		index->cap = new_cap;
+	}
+
+	if (internString(&index->names, name, len, &id) != 0)
+	{
+		return 1;
+	}
+
+	memset(&index->files[id], 0, sizeof(struct modelFile));
+	index->files[id].size  = (uint64_t) info.st_size;
+	index->files[id].mtime = (uint64_t) info.st_mtime;
+	index->len++;
+
+	return 0;
+}
+
+/* Files them under the full hash and its AutoV2 prefix alike */
+static int modelAddHash(struct modelIndex *index, const uint32_t file)
+{
+	const size_t lens[2] = {MODEL_HEX_LEN, MODEL_AUTOV2_LEN};
+	size_t i;
+
+	for (i = 0; i < 2; i++)
+	{
+		uint32_t id;
+
+		if (internString(&index->hashes, index->files[file].sha256, 
+			lens[i], &id) != 0)
+		{
+			return 1;
+		}
+
+		if (id >= index->hash_cap)
+		{
+			const size_t new_cap = (index->hash_cap == 0) 
+				? MODEL_GUESS_LEN : index->hash_cap << 1;
+			uint32_t *tmp = realloc(index->hash_files, 
+				sizeof(uint32_t) * new_cap);
+
+			if (tmp == NULL)
+			{
+				return 1;
+			}
+
+			index->hash_files = tmp;
+			index->hash_cap = new_cap;
+		}
+
+		index->hash_files[id] = file;
+	}
+
+	return 0;
+}
+
+static int modelIsHex(const char *str, const size_t len)
+{
+	size_t i;
+
+	for (i = 0; (i < len) && (((str[i] >= '0') && (str[i] <= '9'))
+		|| ((str[i] >= 'a') && (str[i] <= 'f'))); i++);
+
+	return (i == len);
+}
+
+/* One "size mtime sha256 name" line per hashed file, only hashes whose file
+ * still has the same size and mtime are taken */
+static void modelLoadCache(struct modelIndex *index)
+{
+	char line[MODEL_HEX_LEN + 4096];
+	char *path = modelJoin(index->dir, MODEL_CACHE_FILE);
+	FILE *fhandle = NULL;
+
+	if ((path == NULL) || ((fhandle = fopen(path, "rb")) == NULL))
+	{
+		free(path);
+
+		return;
+	}
+
+	while (fgets(line, sizeof(line), fhandle) != NULL)
+	{
+		char *size_end = strchr(line, ' ');
+		char *mtime_end = (size_end == NULL) 
+			? NULL : strchr(size_end + 1, ' ');
+		char *name = (mtime_end == NULL) 
+			? NULL : mtime_end + MODEL_HEX_LEN + 2;
+		size_t name_len;
+		uint64_t size, mtime;
+		uint32_t id;
+
+		if ((name == NULL) || (strlen(mtime_end) < MODEL_HEX_LEN + 2)
+		|| (mtime_end[MODEL_HEX_LEN + 1] != ' ')
+		|| (modelIsHex(mtime_end + 1, MODEL_HEX_LEN) == 0)
+		|| (paramParseU64(line, (size_t) (size_end - line), &size) != 0)
+		|| (paramParseU64(size_end + 1, (size_t) (mtime_end - size_end)
+			- 1, &mtime) != 0))
+		{
+			continue;
+		}
+
+		for (name_len = strlen(name); (name_len != 0) 
+			&& ((name[name_len - 1] == '\n') 
+			|| (name[name_len - 1] == '\r')); name_len--);
+
+		if ((internFind(&index->names, name, name_len, &id) == 0)
+		&& (index->files[id].size == size) 
+		&& (index->files[id].mtime == mtime))
+		{
+			memcpy(index->files[id].sha256, mtime_end + 1, 
+				MODEL_HEX_LEN);
+			index->files[id].sha256[MODEL_HEX_LEN] = '\0';
+
+			if (modelAddHash(index, id) != 0)
+			{
+				break;
+			}
+		}
+	}
+
+	fclose(fhandle);
+	free(path);
+}
+
+int modelIndexBuild(struct modelIndex *index, const char *dir)
+{
+	memset(index, 0, sizeof(struct modelIndex));
+
+	if ((index->dir = malloc(strlen(dir) + 1)) == NULL)
+	{
+		return 1;
+	}
+
+	strcpy(index->dir, dir);
+
+	if (dirList(dir, modelVisit, index) != 0)
+	{
+		return 1;
+	}
+
+	modelLoadCache(index);
+
+	return 0;
+}
+
+static int modelHashFile(struct modelIndex *index, const uint32_t file)
+{
+	static const char hex[] = "0123456789abcdef";
+	unsigned char digest[SHA256_DIGEST];
+	struct sha256 hash;
+	unsigned char *chunk = NULL;
+	char *path = modelJoin(index->dir, internGet(&index->names, file, 
+		NULL));
+	FILE *fhandle = NULL;
+	size_t i, len;
+	int ret = 0;
+
+	if ((path != NULL) && ((chunk = malloc(MODEL_READ_LEN)) != NULL))
+	{
+		ioOpen();
+		fhandle = fopen(path, "rb");
+	}
+
+	if (fhandle == NULL)
+	{
+		free(path);
+		free(chunk);
+
+		return 1;
+	}
+
+	fprintf(stderr, "Hashing %s\n", path);
+	sha256Init(&hash);
+
+	while ((len = ioRead(chunk, 1, MODEL_READ_LEN, fhandle)) != 0)
+	{
+		sha256Update(&hash, chunk, len);
+	}
+
+	if (ferror(fhandle) == 0)
+	{
+		sha256Final(&hash, digest);
+
+		for (i = 0; i < SHA256_DIGEST; i++)
+		{
+			index->files[file].sha256[i * 2] = hex[digest[i] >> 4];
+			index->files[file].sha256[i * 2 + 1] 
+				= hex[digest[i] & 0xF];
+		}
+
+		index->files[file].sha256[MODEL_HEX_LEN] = '\0';
+		index->dirty = 1;
+		ret = modelAddHash(index, file);
+	}
+	else
+	{
+		ret = 1;
+	}
+
+	ioRelease(fhandle);
+	fclose(fhandle);
+	free(chunk);
+	free(path);
+
+	return ret;
+}
+
+/* The file name in the directory the image's model turned out to be, NULL 
+ * if it couldn't be found. The image's own name wins over its hash, then 
+ * the name without any directories, and only then the hash */
+const char* modelIndexResolve(struct modelIndex *index, const char *name,
+	const size_t len, const char *hash, const size_t hash_len)
+{
+	char lower[MODEL_HEX_LEN];
+	size_t i, base;
+	uint32_t id;
+
+	if (internFind(&index->names, name, len, &id) == 0)
+	{
+		return internGet(&index->names, id, NULL);
+	}
+
+	for (base = len; (base != 0) && (name[base - 1] != '/') 
+		&& (name[base - 1] != '\\'); base--);
+
+	if ((base != 0) 
+	&& (internFind(&index->names, name + base, len - base, &id) == 0))
+	{
+		return internGet(&index->names, id, NULL);
+	}
+
+	if ((hash == NULL) || ((hash_len != MODEL_HEX_LEN) 
+	&& (hash_len != MODEL_AUTOV2_LEN)))
+	{
+		return NULL;
+	}
+
+	for (i = 0; i < hash_len; i++)
+	{
+		lower[i] = ((hash[i] >= 'A') && (hash[i] <= 'F')) 
+			? (char) (hash[i] - 'A' + 'a') : hash[i];
+	}
+
+	/* Everything not in the cache gets hashed the first time round */
+	if ((internFind(&index->hashes, lower, hash_len, &id) != 0)
+	&& (index->all_hashed == 0))
+	{
+		for (i = 0; i < index->len; i++)
+		{
+			if ((index->files[i].sha256[0] == '\0')
+			&& (modelHashFile(index, (uint32_t) i) != 0))
+			{
+				fprintf(stderr, "Unable to hash %s\n", 
+					internGet(&index->names, i, NULL));
+			}
+		}
+
+		index->all_hashed = 1;
+	}
+
+	if (internFind(&index->hashes, lower, hash_len, &id) == 0)
+	{
+		return internGet(&index->names, index->hash_files[id], NULL);
+	}
+
+	return NULL;
+}
+
+/* Only written when something new was hashed */
+int modelIndexSave(struct modelIndex *index)
+{
+	char *path;
+	FILE *fhandle = NULL;
+	size_t i;
+	int ret = 0;
+
+	if (index->dirty == 0)
+	{
+		return 0;
+	}
+
+	if (((path = modelJoin(index->dir, MODEL_CACHE_FILE)) == NULL)
+	|| ((fhandle = fopen(path, "wb")) == NULL))
+	{
+		free(path);
+
+		return 1;
+	}
+
+	for (i = 0; i < index->len; i++)
+	{
+		if (index->files[i].sha256[0] != '\0')
+		{
+			fprintf(fhandle, "%llu %llu %s %s\n", 
+				(unsigned long long) index->files[i].size,
+				(unsigned long long) index->files[i].mtime, 
+				index->files[i].sha256, 
+				internGet(&index->names, i, NULL));
+		}
+	}
+
+	ret = (ferror(fhandle) != 0);
+	ret |= (fclose(fhandle) != 0);
+	free(path);
+	index->dirty = 0;
+
+	return ret;
+}
+
+void modelIndexFree(struct modelIndex *index)
+{
+	if (index == NULL)
+	{
+		return;
+	}
+
+	free(index->dir);
+	free(index->files);
+	free(index->hash_files);
+	internFree(&index->names);
+	internFree(&index->hashes);
+	memset(index, 0, sizeof(struct modelIndex));
+}
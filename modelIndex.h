@@ -0,0 +1,49 @@
+#ifndef MODEL_INDEX_H
+#define MODEL_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "internPool.h"
+#include "sha256.h"
+
+/* Maps what an image says its model was to a file that's actually in the
+ * model directory, by name first and then by SHA-256, in full or cut to 
+ * the ten digit AutoV2 form other front ends write as "Model hash". Files 
+ * are only hashed the first time a hash fails to match, and the hashes are
+ * kept in a cache file in the directory along with each file's size and 
+ * mtime, so a checkpoint is never hashed again until it changes */
+
+#define MODEL_CACHE_FILE "sdPromptDumper.hashes"
+#define MODEL_HEX_LEN    (SHA256_DIGEST * 2)
+#define MODEL_AUTOV2_LEN 10
+#define MODEL_GUESS_LEN  64
+
+struct modelFile
+{
+	uint64_t size;
+	uint64_t mtime;
+	char sha256[MODEL_HEX_LEN + 1]; /* Empty until it's hashed */
+};
+
+struct modelIndex
+{
+	char *dir;
+	struct internPool names; /* Ids line up with files */
+	struct modelFile *files;
+	size_t len;
+	size_t cap;
+	struct internPool hashes; /* Both forms of every hash */
+	uint32_t *hash_files;     /* Hash id to file */
+	size_t hash_cap;
+	int all_hashed;
+	int dirty;
+};
+
+int modelIndexBuild(struct modelIndex *index, const char *dir);
+const char* modelIndexResolve(struct modelIndex *index, const char *name,
+	const size_t len, const char *hash, const size_t hash_len);
+int modelIndexSave(struct modelIndex *index);
+void modelIndexFree(struct modelIndex *index);
+
+#endif /* MODEL_INDEX_H */
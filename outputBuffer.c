@@ -0,0 +1,127 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "outputBuffer.h"
+
+/* Grows geometrically so formatting a long prompt a character at a time
+ * doesn't turn into a realloc per character */
+static int outputReserve(struct outputBuffer *buf, const size_t extra)
+{
+	size_t new_cap;
+	char *tmp = NULL;
+
+	if (buf->error != 0)
+	{
+		return 1;
+	}
+
+	if (buf->len + extra <= buf->cap)
+	{
+		return 0;
+	}
+
+	new_cap = (buf->cap == 0) ? OUTPUT_GUESS_LEN : buf->cap;
+
+	while (new_cap < buf->len + extra)
+	{
+		new_cap <<= 1;
+	}
+
+	if ((tmp = realloc(buf->data, new_cap)) == NULL)
+	{
+		buf->error = 1;
+
+		return 1;
+	}
+
+	buf->data = tmp;
+	buf->cap  = new_cap;
+
+	return 0;
+}
+
+int outputAppend(struct outputBuffer *buf, const char *str, const size_t len)
+{
+	if ((buf == NULL) || (str == NULL))
+	{
+		return 1;
+	}
+
+	if (len == 0)
+	{
+		return 0;
+	}
+
+	if (outputReserve(buf, len) != 0)
+	{
+		return 1;
+	}
+
+	memcpy(buf->data + buf->len, str, len);
+	buf->len += len;
+
+	return 0;
+}
+
+int outputPuts(struct outputBuffer *buf, const char *str)
+{
+	return (str == NULL) ? 1 : outputAppend(buf, str, strlen(str));
+}
+
+int outputPutc(struct outputBuffer *buf, const char ch)
+{
+	if ((buf == NULL) || (outputReserve(buf, 1) != 0))
+	{
+		return 1;
+	}
+
+	buf->data[buf->len++] = ch;
+
+	return 0;
+}
+
+/* Keeps the allocation around so the next image can reuse it */
+void outputReset(struct outputBuffer *buf)
+{
+	if (buf != NULL)
+	{
+		buf->len   = 0;
+		buf->error = 0;
+	}
+}
+
+/* Hands ownership of a null terminated copy of the contents to the caller
+ * and leaves the buffer empty, returns NULL on failure */
+char* outputDetach(struct outputBuffer *buf)
+{
+	char *ret = NULL;
+
+	if ((buf == NULL) || (outputPutc(buf, '\0') != 0))
+	{
+		return NULL;
+	}
+
+	if ((ret = realloc(buf->data, buf->len)) == NULL)
+	{
+		ret = buf->data;
+	}
+
+	buf->data  = NULL;
+	buf->len   = 0;
+	buf->cap   = 0;
+	buf->error = 0;
+
+	return ret;
+}
+
+void outputFree(struct outputBuffer *buf)
+{
+	if (buf != NULL)
+	{
+		free(buf->data);
+		buf->data  = NULL;
+		buf->len   = 0;
+		buf->cap   = 0;
+		buf->error = 0;
+	}
+}
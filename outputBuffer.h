@@ -0,0 +1,27 @@
+#ifndef OUTPUT_BUFFER_H
+#define OUTPUT_BUFFER_H
+
+#include <stddef.h>
+
+#define OUTPUT_GUESS_LEN 512
+
+/* Growable byte buffer that invocations are formatted into before they are
+ * either written straight to stdout or held onto for batch output. Append
+ * failures are sticky so callers can check once after formatting instead of
+ * after every single character */
+struct outputBuffer
+{
+	char *data;
+	size_t len;
+	size_t cap;
+	int error;
+};
+
+int outputAppend(struct outputBuffer *buf, const char *str, const size_t len);
+int outputPuts(struct outputBuffer *buf, const char *str);
+int outputPutc(struct outputBuffer *buf, const char ch);
+void outputReset(struct outputBuffer *buf);
+char* outputDetach(struct outputBuffer *buf);
+void outputFree(struct outputBuffer *buf);
+
+#endif /* OUTPUT_BUFFER_H */
@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "outputBuffer.h"
+#include "outputTemplate.h"
+
+/* Adjacent literal characters are merged into the op before them so an 
+ * escape doesn't split a run in two */
+static void templateLiteral(struct outputTemplate *tpl, size_t *text_len,
+	const char ch)
+{
+	struct templateOp *last = (tpl->num_ops == 0) 
+		? NULL : &tpl->ops[tpl->num_ops - 1];
+
+	if ((last == NULL) || (last->kind != TEMPLATE_LITERAL))
+	{
+		last = &tpl->ops[tpl->num_ops++];
+		last->kind  = TEMPLATE_LITERAL;
+		last->field = 0;
+		last->start = *text_len;
+		last->len   = 0;
+	}
+
+	tpl->text[(*text_len)++] = ch;
+	last->len++;
+}
+
+static int templateField(struct outputTemplate *tpl, const char *name,
+	const size_t len, const char * const *names, const size_t num_names)
+{
+	size_t i;
+
+	for (i = 0; i < num_names; i++)
+	{
+		if ((strlen(names[i]) == len) 
+		&& (strncmp(names[i], name, len) == 0))
+		{
+			struct templateOp *op = &tpl->ops[tpl->num_ops++];
+
+			op->kind  = TEMPLATE_FIELD;
+			op->field = i;
+			op->start = 0;
+			op->len   = 0;
+
+			return 0;
+		}
+	}
+
+	fprintf(stderr, "Unknown template field {%.*s}\n", (int) len, name);
+
+	return 1;
+}
+
+int templateCompile(struct outputTemplate *tpl, const char *src, 
+	const char * const *names, const size_t num_names)
+{
+	const size_t src_len = strlen(src);
+	size_t i, text_len = 0;
+
+	memset(tpl, 0, sizeof(struct outputTemplate));
+
+	/* Every op uses up at least one character of the source */
+	if (((tpl->text = malloc(src_len + 1)) == NULL)
+	|| ((tpl->ops = malloc(sizeof(struct templateOp) * (src_len + 1))) 
+		== NULL))
+	{
+		templateFree(tpl);
+
+		return 1;
+	}
+
+	for (i = 0; i < src_len; i++)
+	{
+		const char *close;
+
+		if (((src[i] == '{') || (src[i] == '}')) 
+		&& (src[i + 1] == src[i]))
+		{
+			templateLiteral(tpl, &text_len, src[i++]);
+		}
+		else if (src[i] == '{')
+		{
+			if ((close = strchr(src + i + 1, '}')) == NULL)
+			{
+				fprintf(stderr, "Template field at %lu is never "
+					"closed\n", (unsigned long) i);
+				templateFree(tpl);
+
+				return 1;
+			}
+
+			if (templateField(tpl, src + i + 1, 
+				(size_t) (close - src) - i - 1, names, 
+				num_names) != 0)
+			{
+				templateFree(tpl);
+
+				return 1;
+			}
+
+			i = (size_t) (close - src);
+		}
+		else if (src[i] == '}')
+		{
+			fprintf(stderr, "Stray } at %lu in template, use }} for "
+				"a literal one\n", (unsigned long) i);
+			templateFree(tpl);
+
+			return 1;
+		}
+		else if ((src[i] == '\\') && (src[i + 1] == 'n'))
+		{
+			templateLiteral(tpl, &text_len, '\n');
+			i++;
+		}
+		else if ((src[i] == '\\') && (src[i + 1] == 't'))
+		{
+			templateLiteral(tpl, &text_len, '\t');
+			i++;
+		}
+		else if ((src[i] == '\\') && (src[i + 1] == '\\'))
+		{
+			templateLiteral(tpl, &text_len, '\\');
+			i++;
+		}
+		else
+		{
+			templateLiteral(tpl, &text_len, src[i]);
+		}
+	}
+
+	return 0;
+}
+
+int templateEmit(const struct outputTemplate *tpl, struct outputBuffer *out,
+	TemplateFieldFunc *emit, void *ctx)
+{
+	size_t i;
+
+	for (i = 0; i < tpl->num_ops; i++)
+	{
+		const struct templateOp *op = &tpl->ops[i];
+
+		if (op->kind == TEMPLATE_LITERAL)
+		{
+			outputAppend(out, tpl->text + op->start, op->len);
+		}
+		else
+		{
+			emit(out, op->field, ctx);
+		}
+	}
+
+	return out->error;
+}
+
+void templateFree(struct outputTemplate *tpl)
+{
+	if (tpl == NULL)
+	{
+		return;
+	}
+
+	free(tpl->text);
+	free(tpl->ops);
+	memset(tpl, 0, sizeof(struct outputTemplate));
+}
@@ -0,0 +1,45 @@
+#ifndef OUTPUT_TEMPLATE_H
+#define OUTPUT_TEMPLATE_H
+
+#include <stddef.h>
+
+#include "outputBuffer.h"
+
+/* User supplied output lines, eg: "{exe} {args} -o out/{basename}". The
+ * template is parsed once into a flat list of ops, each either a literal
+ * run or a placeholder, and formatting an image is then just walking the 
+ * list. The caller decides which names exist and writes their values, ops
+ * only carry the index of the name they matched. {{ and }} stand for { and
+ * }, while \n, \t and \\ are the usual escapes */
+
+enum templateOpKind
+{
+	TEMPLATE_LITERAL = 0,
+	TEMPLATE_FIELD
+};
+
+struct templateOp
+{
+	enum templateOpKind kind;
+	size_t field; /* Index into the names given to templateCompile */
+	size_t start; /* Literal run within the template's text */
+	size_t len;
+};
+
+struct outputTemplate
+{
+	char *text; /* Literals with their escapes already undone */
+	struct templateOp *ops;
+	size_t num_ops;
+};
+
+typedef void (TemplateFieldFunc)(struct outputBuffer *out, 
+	const size_t field, void *ctx);
+
+int templateCompile(struct outputTemplate *tpl, const char *src, 
+	const char * const *names, const size_t num_names);
+int templateEmit(const struct outputTemplate *tpl, struct outputBuffer *out,
+	TemplateFieldFunc *emit, void *ctx);
+void templateFree(struct outputTemplate *tpl);
+
+#endif /* OUTPUT_TEMPLATE_H */
@@ -0,0 +1,282 @@
+#include <stdint.h>
+#include <string.h>
+#include <float.h>
+
+#include "paramValues.h"
+
+/* Significant digits a u64 mantissa can always hold */
+#define PARAM_DIGITS_MAX 19
+/* Past this a float is long since infinite or zero */
+#define PARAM_EXP_MAX    400
+
+static const char *param_names[PARAM_NUM_FIELDS] =
+{
+	"Steps",
+	"CFG scale",
+	"Seed",
+	"Width",
+	"Height"
+};
+
+/* Every power of ten a double holds exactly */
+static const double param_pow10[] =
+{
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+	1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+	1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define PARAM_POW10_MAX \
+	((int) (sizeof(param_pow10) / sizeof(param_pow10[0])) - 1)
+
+static int paramIsDigit(const char ch)
+{
+	return ((ch >= '0') && (ch <= '9'));
+}
+
+int paramParseU64(const char *str, const size_t len, uint64_t *val)
+{
+	size_t i;
+
+	*val = 0;
+
+	for (i = 0; i < len; i++)
+	{
+		if ((paramIsDigit(str[i]) == 0)
+		|| (*val > (UINT64_MAX - (uint64_t) (str[i] - '0')) / 10))
+		{
+			return 1;
+		}
+
+		*val = *val * 10 + (uint64_t) (str[i] - '0');
+	}
+
+	return (len == 0);
+}
+
+int paramParseU32(const char *str, const size_t len, uint32_t *val)
+{
+	uint64_t tmp;
+
+	if ((paramParseU64(str, len, &tmp) != 0) || (tmp > UINT32_MAX))
+	{
+		return 1;
+	}
+
+	*val = (uint32_t) tmp;
+
+	return 0;
+}
+
+/* Plain decimal with an optional exponent, when the digits fit in 53 bits
+ * and the exponent in the table above the answer is exact, otherwise it's
+ * near enough for a cfg scale */
+int paramParseFloat(const char *str, const size_t len, float *val)
+{
+	uint64_t mantissa = 0;
+	size_t i = 0, digits = 0, significant = 0;
+	int negative = 0, exponent = 0, exp_sign = 1, exp_value = 0;
+	double result;
+
+	if ((i < len) && ((str[i] == '-') || (str[i] == '+')))
+	{
+		negative = (str[i++] == '-');
+	}
+
+	for (; (i < len) && (paramIsDigit(str[i]) != 0); i++, digits++)
+	{
+		if ((significant == 0) && (str[i] == '0'))
+		{
+			continue;
+		}
+
+		if (significant < PARAM_DIGITS_MAX)
+		{
+			mantissa = mantissa * 10 + (uint64_t) (str[i] - '0');
+			significant++;
+		}
+		else
+		{
+			exponent++;
+		}
+	}
+
+	if ((i < len) && (str[i] == '.'))
+	{
+		for (i++; (i < len) && (paramIsDigit(str[i]) != 0);
+			i++, digits++)
+		{
+			if ((significant == 0) && (str[i] == '0'))
+			{
+				exponent--;
+			}
+			else if (significant < PARAM_DIGITS_MAX)
+			{
+				mantissa = mantissa * 10
+					+ (uint64_t) (str[i] - '0');
+				significant++;
+				exponent--;
+			}
+		}
+	}
+
+	if (digits == 0)
+	{
+		return 1;
+	}
+
+	if ((i < len) && ((str[i] == 'e') || (str[i] == 'E')))
+	{
+		i++;
+
+		if ((i < len) && ((str[i] == '-') || (str[i] == '+')))
+		{
+			exp_sign = (str[i++] == '-') ? -1 : 1;
+		}
+
+		if ((i == len) || (paramIsDigit(str[i]) == 0))
+		{
+			return 1;
+		}
+
+		for (; (i < len) && (paramIsDigit(str[i]) != 0); i++)
+		{
+			if (exp_value < PARAM_EXP_MAX)
+			{
+				exp_value = exp_value * 10 + (str[i] - '0');
+			}
+		}
+
+		exponent += exp_sign * exp_value;
+	}
+
+	if (i != len)
+	{
+		return 1;
+	}
+
+	result = (double) mantissa;
+
+	if (mantissa == 0)
+	{
+		exponent = 0;
+	}
+	else if ((exponent < -PARAM_EXP_MAX) || (exponent > PARAM_EXP_MAX))
+	{
+		return 1;
+	}
+
+	for (; exponent > PARAM_POW10_MAX; exponent -= PARAM_POW10_MAX)
+	{
+		result *= param_pow10[PARAM_POW10_MAX];
+	}
+
+	for (; exponent < -PARAM_POW10_MAX; exponent += PARAM_POW10_MAX)
+	{
+		result /= param_pow10[PARAM_POW10_MAX];
+	}
+
+	result = (exponent < 0)
+		? result / param_pow10[-exponent]
+		: result * param_pow10[exponent];
+
+	if (result > FLT_MAX)
+	{
+		return 1;
+	}
+
+	*val = (float) ((negative != 0) ? -result : result);
+
+	return 0;
+}
+
+/* "<width>x<height>" as the webui writes it */
+int paramParseSize(const char *str, const size_t len, uint32_t *width,
+	uint32_t *height)
+{
+	size_t split;
+
+	for (split = 0; (split < len) && (str[split] != 'x'); split++);
+
+	return ((split == len)
+	|| (paramParseU32(str, split, width) != 0)
+	|| (paramParseU32(str + split + 1, len - split - 1, height) != 0));
+}
+
+/* Skips the blanks either side of a value, len is updated to match */
+const char* paramTrim(const char *value, size_t *len)
+{
+	for (; (*len != 0) && ((*value == ' ') || (*value == '\t')); value++)
+	{
+		(*len)--;
+	}
+
+	for (; (*len != 0) && ((value[*len - 1] == ' ')
+	|| (value[*len - 1] == '\t') || (value[*len - 1] == '\r')); (*len)--);
+
+	return value;
+}
+
+/* Decodes a labelled value if it's one of the numeric settings, returns 1
+ * if it was but couldn't be parsed, anything else is quietly ignored */
+int paramDecode(struct paramValues *values, const char *label,
+	const char *value, size_t len)
+{
+	uint32_t fields;
+	int ret;
+
+	value = paramTrim(value, &len);
+
+	if (strcmp(label, "Steps") == 0)
+	{
+		fields = PARAM_BIT(PARAM_STEPS);
+		ret = paramParseU32(value, len, &values->steps);
+	}
+	else if (strcmp(label, "CFG scale") == 0)
+	{
+		fields = PARAM_BIT(PARAM_CFG);
+		ret = paramParseFloat(value, len, &values->cfg);
+	}
+	else if (strcmp(label, "Seed") == 0)
+	{
+		fields = PARAM_BIT(PARAM_SEED);
+		ret = paramParseU64(value, len, &values->seed);
+	}
+	else if (strcmp(label, "Size") == 0)
+	{
+		fields = PARAM_BIT(PARAM_WIDTH) | PARAM_BIT(PARAM_HEIGHT);
+		ret = paramParseSize(value, len, &values->width,
+			&values->height);
+	}
+	else if (strcmp(label, "Width") == 0)
+	{
+		fields = PARAM_BIT(PARAM_WIDTH);
+		ret = paramParseU32(value, len, &values->width);
+	}
+	else if (strcmp(label, "Height") == 0)
+	{
+		fields = PARAM_BIT(PARAM_HEIGHT);
+		ret = paramParseU32(value, len, &values->height);
+	}
+	else
+	{
+		return 0;
+	}
+
+	if (ret == 0)
+	{
+		values->present   |= fields;
+		values->malformed &= ~fields;
+	}
+	else
+	{
+		values->malformed |= fields;
+	}
+
+	return ret;
+}
+
+const char* paramFieldName(const enum paramField field)
+{
+	return (field < PARAM_NUM_FIELDS) ? param_names[field] : "Unknown";
+}
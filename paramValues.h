@@ -0,0 +1,45 @@
+#ifndef PARAM_VALUES_H
+#define PARAM_VALUES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Typed copies of the numeric generation settings, decoded once per image
+ * so anything that wants to compare, sort, or add them up doesn't have to
+ * go back to the text. Parsing never looks at the locale, a cfg of "7.5"
+ * is 7.5 no matter what LC_NUMERIC says */
+
+enum paramField
+{
+	PARAM_STEPS = 0,
+	PARAM_CFG,
+	PARAM_SEED,
+	PARAM_WIDTH,
+	PARAM_HEIGHT,
+	PARAM_NUM_FIELDS
+};
+
+#define PARAM_BIT(field) ((uint32_t) 1 << (field))
+
+struct paramValues
+{
+	uint32_t steps;
+	float cfg;
+	uint64_t seed;
+	uint32_t width;
+	uint32_t height;
+	uint32_t present;   /* PARAM_BIT of every field that decoded */
+	uint32_t malformed; /* Likewise for those that were there but bad */
+};
+
+int paramParseU64(const char *str, const size_t len, uint64_t *val);
+int paramParseU32(const char *str, const size_t len, uint32_t *val);
+int paramParseFloat(const char *str, const size_t len, float *val);
+int paramParseSize(const char *str, const size_t len, uint32_t *width,
+	uint32_t *height);
+const char* paramTrim(const char *value, size_t *len);
+int paramDecode(struct paramValues *values, const char *label,
+	const char *value, size_t len);
+const char* paramFieldName(const enum paramField field);
+
+#endif /* PARAM_VALUES_H */
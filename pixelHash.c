@@ -0,0 +1,111 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "pixelHash.h"
+
+/* Same primes as xxHash64, the round below is its as well */
+#define PIXEL_PRIME_1 0x9E3779B185EBCA87ull
+#define PIXEL_PRIME_2 0xC2B2AE3D27D4EB4Full
+#define PIXEL_PRIME_3 0x165667B19E3779F9ull
+
+#define PIXEL_ROTL(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+/* Assembled a byte at a time so it's the same on every host, compilers
+ * turn this back into a single load where that's allowed */
+static uint64_t pixelLoad(const unsigned char *bytes)
+{
+	return (uint64_t) bytes[0]         | ((uint64_t) bytes[1] << 8)
+		| ((uint64_t) bytes[2] << 16) | ((uint64_t) bytes[3] << 24)
+		| ((uint64_t) bytes[4] << 32) | ((uint64_t) bytes[5] << 40)
+		| ((uint64_t) bytes[6] << 48) | ((uint64_t) bytes[7] << 56);
+}
+
+static uint64_t pixelRound(uint64_t lane, const uint64_t word)
+{
+	lane += word * PIXEL_PRIME_2;
+	lane  = PIXEL_ROTL(lane, 31);
+
+	return lane * PIXEL_PRIME_1;
+}
+
+static void pixelStripe(struct pixelHash *hash, const unsigned char *stripe)
+{
+	size_t i;
+
+	for (i = 0; i < PIXEL_LANES; i++)
+	{
+		hash->lanes[i] = pixelRound(hash->lanes[i],
+			pixelLoad(stripe + i * sizeof(uint64_t)));
+	}
+}
+
+void pixelHashInit(struct pixelHash *hash)
+{
+	size_t i;
+
+	memset(hash, 0, sizeof(struct pixelHash));
+
+	for (i = 0; i < PIXEL_LANES; i++)
+	{
+		hash->lanes[i] = PIXEL_PRIME_3 * (i + 1);
+	}
+}
+
+void pixelHashUpdate(struct pixelHash *hash, const unsigned char *data,
+	size_t len)
+{
+	hash->len += len;
+
+	/* Tops up a stripe left over from last time first */
+	if (hash->tail_len != 0)
+	{
+		const size_t want = PIXEL_STRIPE - hash->tail_len;
+		const size_t take = (len < want) ? len : want;
+
+		memcpy(hash->tail + hash->tail_len, data, take);
+		hash->tail_len += take;
+		data += take;
+		len  -= take;
+
+		if (hash->tail_len < PIXEL_STRIPE)
+		{
+			return;
+		}
+
+		pixelStripe(hash, hash->tail);
+		hash->tail_len = 0;
+	}
+
+	for (; len >= PIXEL_STRIPE; data += PIXEL_STRIPE, len -= PIXEL_STRIPE)
+	{
+		pixelStripe(hash, data);
+	}
+
+	memcpy(hash->tail, data, len);
+	hash->tail_len = len;
+}
+
+uint64_t pixelHashFinal(const struct pixelHash *hash)
+{
+	uint64_t ret = hash->len * PIXEL_PRIME_1;
+	size_t i;
+
+	for (i = 0; i < PIXEL_LANES; i++)
+	{
+		ret = PIXEL_ROTL(ret, 27) ^ pixelRound(0, hash->lanes[i]);
+		ret = ret * PIXEL_PRIME_1 + PIXEL_PRIME_3;
+	}
+
+	for (i = 0; i < hash->tail_len; i++)
+	{
+		ret = (ret ^ (hash->tail[i] * PIXEL_PRIME_3)) * PIXEL_PRIME_1;
+		ret = PIXEL_ROTL(ret, 11);
+	}
+
+	ret ^= ret >> 33;
+	ret *= PIXEL_PRIME_2;
+	ret ^= ret >> 29;
+	ret *= PIXEL_PRIME_3;
+
+	return ret ^ (ret >> 32);
+}
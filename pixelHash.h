@@ -0,0 +1,29 @@
+#ifndef PIXEL_HASH_H
+#define PIXEL_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Streaming, non-cryptographic 64 bit hash for telling image data apart.
+ * Input is taken in 32 byte stripes across four independent lanes, so the
+ * compiler can keep them all in flight at once, and how the input is split
+ * across calls never changes the result. Only meant for spotting copies,
+ * not for anything an adversary gets a say in */
+
+#define PIXEL_LANES  4
+#define PIXEL_STRIPE (PIXEL_LANES * sizeof(uint64_t))
+
+struct pixelHash
+{
+	uint64_t lanes[PIXEL_LANES];
+	unsigned char tail[PIXEL_STRIPE];
+	size_t tail_len;
+	uint64_t len;
+};
+
+void pixelHashInit(struct pixelHash *hash);
+void pixelHashUpdate(struct pixelHash *hash, const unsigned char *data,
+	size_t len);
+uint64_t pixelHashFinal(const struct pixelHash *hash);
+
+#endif /* PIXEL_HASH_H */
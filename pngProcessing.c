@@ -3,6 +3,10 @@
 #include <string.h>
 
 #include "portegg.h"
+#include "pixelHash.h"
+#include "fileCopy.h"
+#include "ioThrottle.h"
+#include "pngProcessing.h"
 
 #define CHUNK_TRAILER 4
 #define TYPE_LEN      4
@@ -14,7 +18,7 @@ int pngValidate(FILE *fhandle)
 	unsigned char tmp[8] = {0};
 
 	if ((fhandle == NULL)
-	|| (fread(&tmp, sizeof(char), 8, fhandle) != 8)
+	|| (ioRead(&tmp, sizeof(char), 8, fhandle) != 8)
 	|| (strncmp((const char *)tmp, (const char *)file_signature, 8) != 0))
 	{
 		return 0;
@@ -23,6 +27,39 @@ int pngValidate(FILE *fhandle)
 	return 1;
 }
 
+/* Decodes IHDR, which has to follow the signature, out of the first 29 
+ * bytes of the file without disturbing the file position. Returns 1 if it
+ * isn't there or is malformed */
+int pngReadHeader(FILE *fhandle, struct pngHeader *header)
+{
+	unsigned char data[TYPE_LEN * 2 + 13];
+	const long int initial_pos = ftell(fhandle);
+	int ret = 1;
+
+	if ((initial_pos != -1) && (fseek(fhandle, 8, SEEK_SET) == 0)
+	&& (ioRead(data, sizeof(char), sizeof(data), fhandle) == sizeof(data))
+	&& (memcmp(data, "\0\0\0\x0D" "IHDR", TYPE_LEN * 2) == 0))
+	{
+		header->width = ((uint32_t) data[8] << 24) 
+			| ((uint32_t) data[9] << 16)
+			| ((uint32_t) data[10] << 8) | (uint32_t) data[11];
+		header->height = ((uint32_t) data[12] << 24) 
+			| ((uint32_t) data[13] << 16)
+			| ((uint32_t) data[14] << 8) | (uint32_t) data[15];
+		header->bit_depth  = data[16];
+		header->color_type = data[17];
+		header->interlace  = data[20];
+		ret = (header->width == 0) || (header->height == 0);
+	}
+
+	if ((initial_pos != -1) && (fseek(fhandle, initial_pos, SEEK_SET) != 0))
+	{
+		ret = 1;
+	}
+
+	return ret;
+}
+
 /* Returns the size of the chunk, 0 on failure, strictly speaking because of
  * how the file functions are defined this could return a long int instead and
  * use -1 as an error but it's a moot point because there shouldn't be zero
@@ -35,8 +72,8 @@ size_t pngFindChunk(FILE *fhandle, const char *chunk_target)
 		? ftell(fhandle)
 		: -1;
 
-	if ((fread(&chunk_length, sizeof(uint32_t), 1, fhandle) != 1)
-	|| (fread(&chunk_type, sizeof(char), TYPE_LEN, fhandle) != TYPE_LEN))
+	if ((ioRead(&chunk_length, sizeof(uint32_t), 1, fhandle) != 1)
+	|| (ioRead(&chunk_type, sizeof(char), TYPE_LEN, fhandle) != TYPE_LEN))
 	{
 		fseek(fhandle, initial_pos, SEEK_SET);
 		fprintf(stderr, "Failure to read IHDR information\n");
@@ -58,8 +95,8 @@ size_t pngFindChunk(FILE *fhandle, const char *chunk_target)
 		return 0;
 	}
 
-	while ((fread(&chunk_length, sizeof(uint32_t), 1, fhandle) == 1)
-	&& (fread(&chunk_type, sizeof(char), TYPE_LEN, fhandle) == TYPE_LEN))
+	while ((ioRead(&chunk_length, sizeof(uint32_t), 1, fhandle) == 1)
+	&& (ioRead(&chunk_type, sizeof(char), TYPE_LEN, fhandle) == TYPE_LEN))
 	{
 		porteggBeToSysCopy(uint32_t, chunk_length, chunk_length);
 
@@ -88,3 +125,480 @@ size_t pngFindChunk(FILE *fhandle, const char *chunk_target)
 	return 0;
 }
 
+/* Fills in where the text of a tEXt, zTXt, or iTXt chunk actually starts by
+ * reading just its header, returns 0 if the chunk is malformed. The file
+ * position is left somewhere inside the chunk */
+static int pngReadTextHeader(FILE *fhandle, const long int data_start,
+	const uint32_t chunk_length, struct pngTextChunk *entry)
+{
+	char header[PNG_KEYWORD_MAX + 3] = {0};
+	const size_t want = (chunk_length < sizeof(header))
+		? chunk_length : sizeof(header);
+	size_t got, kw_len, skip = 0;
+
+	if ((got = ioRead(header, sizeof(char), want, fhandle)) != want)
+	{
+		return 0;
+	}
+
+	for (kw_len = 0; (kw_len < got) && (header[kw_len] != '\0'); kw_len++);
+
+	if ((kw_len == 0) || (kw_len > PNG_KEYWORD_MAX) || (kw_len == got))
+	{
+		return 0;
+	}
+
+	memcpy(entry->keyword, header, kw_len);
+	entry->keyword[kw_len] = '\0';
+	entry->compressed = 0;
+	skip = kw_len + 1;
+
+	switch (entry->type)
+	{
+		case PNG_TEXT_PLAIN:
+			break;
+		case PNG_TEXT_ZIPPED:
+			/* Zero is the only compression method defined */
+			if ((skip >= got) || (header[skip] != 0))
+			{
+				return 0;
+			}
+
+			entry->compressed = 1;
+			skip++;
+			break;
+		case PNG_TEXT_INTL:
+		{
+			int nulls = 0, ch;
+
+			if ((skip + 2 > chunk_length) 
+			|| (skip + 2 > got) || (header[skip + 1] != 0))
+			{
+				return 0;
+			}
+
+			entry->compressed = (header[skip] != 0);
+			skip += 2;
+
+			/* Language tag and translated keyword are both null
+			 * terminated and of no interest here */
+			if (fseek(fhandle, data_start + (long int) skip, 
+				SEEK_SET) != 0)
+			{
+				return 0;
+			}
+
+			while ((nulls < 2) && (skip < chunk_length)
+			&& ((ch = ioGetc(fhandle)) != EOF))
+			{
+				nulls += (ch == '\0');
+				skip++;
+			}
+
+			if (nulls != 2)
+			{
+				return 0;
+			}
+
+			break;
+		}
+		default:
+			return 0;
+	}
+
+	if (skip > chunk_length)
+	{
+		return 0;
+	}
+
+	entry->text_offset = data_start + (long int) skip;
+	entry->text_length = chunk_length - skip;
+
+	return 1;
+}
+
+/* Walks the chunk list once from just past the signature recording where 
+ * every text chunk is. Stops early once every one of keys has been seen, if
+ * num_keys isn't 0, or at the first IDAT if the layout hint says text comes 
+ * first. Returns 0 on success, including when no text chunks were found, 
+ * the file is left positioned where the walk stopped */
+int pngScanText(FILE *fhandle, struct pngTextTable *table, 
+	const char * const *keys, const size_t num_keys, 
+	const enum pngLayout layout)
+{
+	const char *types[PNG_NUM_TEXT_TYPES] = {"tEXt", "zTXt", "iTXt"};
+	uint32_t chunk_length;
+	char chunk_type[TYPE_LEN] = {0};
+	size_t i, keys_found = 0;
+
+	if ((fhandle == NULL) || (table == NULL))
+	{
+		return 1;
+	}
+
+	table->len = 0;
+
+	while ((ioRead(&chunk_length, sizeof(uint32_t), 1, fhandle) == 1)
+	&& (ioRead(&chunk_type, sizeof(char), TYPE_LEN, fhandle) == TYPE_LEN))
+	{
+		const long int data_start = ftell(fhandle);
+
+		porteggBeToSysCopy(uint32_t, chunk_length, chunk_length);
+
+		if (data_start == -1)
+		{
+			return 1;
+		}
+
+		if (memcmp(chunk_type, "IEND", TYPE_LEN) == 0)
+		{
+			break;
+		}
+
+		if ((layout == PNG_LAYOUT_TEXT_FIRST)
+		&& (memcmp(chunk_type, "IDAT", TYPE_LEN) == 0))
+		{
+			break;
+		}
+
+		for (i = 0; (i < PNG_NUM_TEXT_TYPES) 
+		&& (memcmp(chunk_type, types[i], TYPE_LEN) != 0); i++);
+
+		if ((i != PNG_NUM_TEXT_TYPES) && (table->len < PNG_TEXT_MAX))
+		{
+			struct pngTextChunk *entry = &table->chunks[table->len];
+
+			entry->type = (enum pngTextType) i;
+
+			if (pngReadTextHeader(fhandle, data_start, 
+				chunk_length, entry) == 1)
+			{
+				table->len++;
+
+				for (i = 0; i < num_keys; i++)
+				{
+					if ((strcmp(keys[i], entry->keyword) 
+						== 0)
+					&& (pngFindText(table, keys[i]) 
+						== entry))
+					{
+						keys_found++;
+					}
+				}
+			}
+		}
+
+		if (fseek(fhandle, data_start + (long int) chunk_length 
+			+ CHUNK_TRAILER, SEEK_SET) != 0)
+		{
+			fprintf(stderr, "fseek failed, cannot seek %u bytes\n",
+				chunk_length + CHUNK_TRAILER);
+
+			return 1;
+		}
+
+		if ((num_keys != 0) && (keys_found == num_keys))
+		{
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/* Streams count bytes of chunk data from the current position into hash */
+static int pngHashData(FILE *fhandle, struct pixelHash *hash, 
+	uint32_t count)
+{
+	unsigned char window[PNG_HASH_WINDOW];
+
+	while (count != 0)
+	{
+		const size_t want = (count < PNG_HASH_WINDOW) 
+			? count : PNG_HASH_WINDOW;
+
+		if (ioRead(window, sizeof(char), want, fhandle) != want)
+		{
+			return 1;
+		}
+
+		pixelHashUpdate(hash, window, want);
+		count -= (uint32_t) want;
+	}
+
+	return 0;
+}
+
+/* Hashes the header and the image data joined end to end, so the result is
+ * the same however the data was split into IDAT chunks and whatever other
+ * chunks came and went around it. has_params is set if a text chunk that 
+ * might hold generation parameters was passed along the way. Expects the 
+ * file to be positioned just past the signature, returns 1 if there was no 
+ * image data or the file couldn't be read */
+int pngHashPixels(FILE *fhandle, uint64_t *hash_out, int *has_params)
+{
+	const char *types[PNG_NUM_TEXT_TYPES] = {"tEXt", "zTXt", "iTXt"};
+	struct pixelHash hash;
+	uint32_t chunk_length;
+	char chunk_type[TYPE_LEN] = {0};
+	size_t i, num_idat = 0;
+
+	if ((fhandle == NULL) || (hash_out == NULL) || (has_params == NULL))
+	{
+		return 1;
+	}
+
+	pixelHashInit(&hash);
+	*has_params = 0;
+
+	while ((ioRead(&chunk_length, sizeof(uint32_t), 1, fhandle) == 1)
+	&& (ioRead(&chunk_type, sizeof(char), TYPE_LEN, fhandle) == TYPE_LEN))
+	{
+		const long int data_start = ftell(fhandle);
+
+		porteggBeToSysCopy(uint32_t, chunk_length, chunk_length);
+
+		if ((data_start == -1) 
+		|| (memcmp(chunk_type, "IEND", TYPE_LEN) == 0))
+		{
+			break;
+		}
+
+		for (i = 0; (i < PNG_NUM_TEXT_TYPES) 
+		&& (memcmp(chunk_type, types[i], TYPE_LEN) != 0); i++);
+
+		if ((memcmp(chunk_type, "IHDR", TYPE_LEN) == 0)
+		|| (memcmp(chunk_type, "IDAT", TYPE_LEN) == 0))
+		{
+			if (pngHashData(fhandle, &hash, chunk_length) != 0)
+			{
+				return 1;
+			}
+
+			num_idat += (chunk_type[1] == 'D');
+		}
+		else if (i != PNG_NUM_TEXT_TYPES)
+		{
+			char keyword[sizeof("parameters")] = {0};
+			const size_t want = (chunk_length < sizeof(keyword))
+				? chunk_length : sizeof(keyword);
+
+			if (ioRead(keyword, sizeof(char), want, fhandle) != want)
+			{
+				return 1;
+			}
+
+			/* Keywords are null terminated so these can't be 
+			 * prefixes of something longer */
+			*has_params |= (memcmp(keyword, "parameters", 
+				sizeof("parameters")) == 0)
+				|| (memcmp(keyword, "prompt", 
+				sizeof("prompt")) == 0);
+		}
+
+		if (fseek(fhandle, data_start + (long int) chunk_length 
+			+ CHUNK_TRAILER, SEEK_SET) != 0)
+		{
+			fprintf(stderr, "fseek failed, cannot seek %u bytes\n",
+				chunk_length + CHUNK_TRAILER);
+
+			return 1;
+		}
+	}
+
+	*hash_out = pixelHashFinal(&hash);
+
+	return (num_idat == 0);
+}
+
+/* The CRC-32 every chunk ends with, over its type and data */
+static uint32_t pngCrc(uint32_t crc, const unsigned char *data, 
+	const size_t len)
+{
+	static uint32_t table[256];
+	size_t i;
+
+	if (table[1] == 0)
+	{
+		uint32_t n, k;
+
+		for (n = 0; n < 256; n++)
+		{
+			uint32_t c = n;
+
+			for (k = 0; k < 8; k++)
+			{
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+
+			table[n] = c;
+		}
+	}
+
+	for (i = 0; i < len; i++)
+	{
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+
+	return crc;
+}
+
+static void pngPutU32(FILE *out, const uint32_t val)
+{
+	putc((int) (val >> 24) & 0xFF, out);
+	putc((int) (val >> 16) & 0xFF, out);
+	putc((int) (val >> 8) & 0xFF, out);
+	putc((int) val & 0xFF, out);
+}
+
+static void pngWriteText(FILE *out, const struct pngNewText *text)
+{
+	const size_t key_len = strlen(text->keyword) + 1;
+	const size_t text_len = strlen(text->text);
+	uint32_t crc = 0xFFFFFFFFu;
+
+	pngPutU32(out, (uint32_t) (key_len + text_len));
+	fwrite("tEXt", sizeof(char), TYPE_LEN, out);
+	fwrite(text->keyword, sizeof(char), key_len, out);
+	fwrite(text->text, sizeof(char), text_len, out);
+
+	crc = pngCrc(crc, (const unsigned char *) "tEXt", TYPE_LEN);
+	crc = pngCrc(crc, (const unsigned char *) text->keyword, key_len);
+	crc = pngCrc(crc, (const unsigned char *) text->text, text_len);
+	pngPutU32(out, crc ^ 0xFFFFFFFFu);
+}
+
+/* Whether a text chunk's keyword is one of those being stripped or 
+ * replaced, leaves the file position inside the chunk */
+static int pngTextMatches(FILE *fhandle, const uint32_t chunk_length,
+	const char * const *strip, const size_t num_strip,
+	const struct pngNewText *texts, const size_t num_texts)
+{
+	char keyword[PNG_KEYWORD_MAX + 2] = {0};
+	const size_t want = (chunk_length < sizeof(keyword) - 1) 
+		? chunk_length : sizeof(keyword) - 1;
+	size_t i;
+
+	if (ioRead(keyword, sizeof(char), want, fhandle) != want)
+	{
+		return 0;
+	}
+
+	for (i = 0; i < num_strip; i++)
+	{
+		if (strcmp(keyword, strip[i]) == 0)
+		{
+			return 1;
+		}
+	}
+
+	for (i = 0; i < num_texts; i++)
+	{
+		if (strcmp(keyword, texts[i].keyword) == 0)
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* Writes a copy of the PNG to out minus any text chunk with a keyword in 
+ * strip or texts, and with texts added as tEXt chunks ahead of the image 
+ * data. Every chunk kept is copied byte for byte, CRC and all, so only the
+ * new chunks ever need a CRC worked out. Expects the file to be positioned
+ * just past the signature, returns 1 if it couldn't be read through to 
+ * IEND or out couldn't be written */
+int pngRewrite(FILE *fhandle, FILE *out, const char * const *strip, 
+	const size_t num_strip, const struct pngNewText *texts, 
+	const size_t num_texts, size_t *num_stripped)
+{
+	const unsigned char file_signature[] 
+		= {137, 80, 78, 71, 13, 10, 26, 10}; 
+	const char *types[PNG_NUM_TEXT_TYPES] = {"tEXt", "zTXt", "iTXt"};
+	uint32_t chunk_length;
+	char chunk_type[TYPE_LEN] = {0};
+	int texts_written = 0;
+	size_t i;
+
+	*num_stripped = 0;
+	fwrite(file_signature, sizeof(char), sizeof(file_signature), out);
+
+	while ((ioRead(&chunk_length, sizeof(uint32_t), 1, fhandle) == 1)
+	&& (ioRead(&chunk_type, sizeof(char), TYPE_LEN, fhandle) == TYPE_LEN))
+	{
+		const long int data_start = ftell(fhandle);
+		const int is_end = (memcmp(chunk_type, "IEND", TYPE_LEN) == 0);
+
+		porteggBeToSysCopy(uint32_t, chunk_length, chunk_length);
+
+		if (data_start == -1)
+		{
+			return 1;
+		}
+
+		if ((texts_written == 0) && ((is_end != 0)
+		|| (memcmp(chunk_type, "IDAT", TYPE_LEN) == 0)))
+		{
+			for (i = 0; i < num_texts; i++)
+			{
+				pngWriteText(out, &texts[i]);
+			}
+
+			texts_written = 1;
+		}
+
+		for (i = 0; (i < PNG_NUM_TEXT_TYPES) 
+		&& (memcmp(chunk_type, types[i], TYPE_LEN) != 0); i++);
+
+		if ((i != PNG_NUM_TEXT_TYPES) && (pngTextMatches(fhandle, 
+			chunk_length, strip, num_strip, texts, num_texts) != 0))
+		{
+			(*num_stripped)++;
+		}
+		else if (fileCopyRange(fhandle, data_start - TYPE_LEN 
+			- (long int) sizeof(uint32_t), (uint64_t) chunk_length 
+			+ TYPE_LEN + sizeof(uint32_t) + CHUNK_TRAILER, out) != 0)
+		{
+			return 1;
+		}
+
+		if (is_end != 0)
+		{
+			return (ferror(out) != 0);
+		}
+
+		if (fseek(fhandle, data_start + (long int) chunk_length 
+			+ CHUNK_TRAILER, SEEK_SET) != 0)
+		{
+			fprintf(stderr, "fseek failed, cannot seek %u bytes\n",
+				chunk_length + CHUNK_TRAILER);
+
+			return 1;
+		}
+	}
+
+	return 1;
+}
+
+/* First text chunk with the given keyword, NULL if there isn't one */
+const struct pngTextChunk* pngFindText(const struct pngTextTable *table,
+	const char *keyword)
+{
+	size_t i;
+
+	if ((table == NULL) || (keyword == NULL))
+	{
+		return NULL;
+	}
+
+	for (i = 0; i < table->len; i++)
+	{
+		if (strcmp(table->chunks[i].keyword, keyword) == 0)
+		{
+			return &table->chunks[i];
+		}
+	}
+
+	return NULL;
+}
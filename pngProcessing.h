@@ -1,8 +1,77 @@
 #ifndef PNG_PROCESSING_H 
 #define PNG_PROCESSING_H
 
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* The spec caps keywords at 79 bytes */
+#define PNG_KEYWORD_MAX 79
+/* More text chunks than this in one file is unheard of, any extras are just
+ * ignored rather than growing the table */
+#define PNG_TEXT_MAX    16
+/* Image data is hashed this much at a time */
+#define PNG_HASH_WINDOW 65536
+
+enum pngTextType
+{
+	PNG_TEXT_PLAIN = 0, /* tEXt */
+	PNG_TEXT_ZIPPED,    /* zTXt */
+	PNG_TEXT_INTL,      /* iTXt */
+	PNG_NUM_TEXT_TYPES
+};
+
+/* How far pngScanText has to look, most writers put their text ahead of the
+ * image data but the spec allows it after as well */
+enum pngLayout
+{
+	PNG_LAYOUT_ANY = 0,
+	PNG_LAYOUT_TEXT_FIRST
+};
+
+struct pngTextChunk
+{
+	char keyword[PNG_KEYWORD_MAX + 1];
+	enum pngTextType type;
+	int compressed;
+	long int text_offset; /* Start of the text itself, past any header */
+	size_t text_length;
+};
+
+/* What IHDR says about the image, which the spec puts first */
+struct pngHeader
+{
+	uint32_t width;
+	uint32_t height;
+	unsigned char bit_depth;
+	unsigned char color_type;
+	unsigned char interlace;
+};
+
+/* A tEXt chunk to write out, the keyword has to meet the spec already */
+struct pngNewText
+{
+	const char *keyword;
+	const char *text;
+};
+
+struct pngTextTable
+{
+	struct pngTextChunk chunks[PNG_TEXT_MAX];
+	size_t len;
+};
+
 size_t pngFindChunk(FILE *fhandle, const char *chunk_target);
-char pngValidate(FILE *fhandle);
+int pngValidate(FILE *fhandle);
+int pngReadHeader(FILE *fhandle, struct pngHeader *header);
+int pngScanText(FILE *fhandle, struct pngTextTable *table, 
+	const char * const *keys, const size_t num_keys, 
+	const enum pngLayout layout);
+int pngHashPixels(FILE *fhandle, uint64_t *hash_out, int *has_params);
+int pngRewrite(FILE *fhandle, FILE *out, const char * const *strip, 
+	const size_t num_strip, const struct pngNewText *texts, 
+	const size_t num_texts, size_t *num_stripped);
+const struct pngTextChunk* pngFindText(const struct pngTextTable *table,
+	const char *keyword);
 
 #endif /* PNG_PROCESSING_H */
-
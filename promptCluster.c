@@ -0,0 +1,327 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "stiTokenizer.h"
+#include "termSketch.h"
+#include "promptCluster.h"
+
+#define CLUSTER_DELIMS ",\n"
+
+struct clusterBucket
+{
+	uint64_t key;
+	size_t member;
+};
+
+/* splitmix64, spreads FNV's weak low bits and seeds the hash family */
+static uint64_t clusterMix(uint64_t x)
+{
+	x += 0x9E3779B97F4A7C15ull;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+
+	return x ^ (x >> 31);
+}
+
+/* FNV-1a */
+static uint64_t clusterHash(const char *str, const size_t len)
+{
+	uint64_t hash = 14695981039346656037ull;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		hash = (hash ^ (unsigned char) str[i]) * 1099511628211ull;
+	}
+
+	return clusterMix(hash);
+}
+
+/* Two prompts with similarity s share a band with the chance 
+ * 1 - (1 - s^rows)^bands, which climbs steepest near (1 / bands)^(1 / rows).
+ * Fewer, longer bands push that point up, so this takes the fewest bands 
+ * that still keep it at or below the threshold, ie bands * t^rows >= 1, 
+ * anything let through below the threshold is caught by the comparison */
+static void clusterBands(struct clusterSet *set, const float threshold)
+{
+	for (set->bands = 1; set->bands < CLUSTER_HASHES; set->bands <<= 1)
+	{
+		double chance = set->bands;
+		size_t i;
+
+		set->rows = CLUSTER_HASHES / set->bands;
+
+		for (i = 0; i < set->rows; i++)
+		{
+			chance *= threshold;
+		}
+
+		if (chance >= 1)
+		{
+			return;
+		}
+	}
+
+	set->rows = 1;
+}
+
+int clusterInit(struct clusterSet *set, const float threshold)
+{
+	uint64_t state = 0x53445044434C5553ull;
+	size_t i;
+
+	memset(set, 0, sizeof(struct clusterSet));
+	set->threshold = threshold;
+	clusterBands(set, threshold);
+
+	/* Fixed seeds so the same inputs always cluster the same way */
+	for (i = 0; i < CLUSTER_HASHES; i++)
+	{
+		set->mul[i] = clusterMix(state++) | 1;
+		set->add[i] = clusterMix(state++);
+	}
+
+	return 0;
+}
+
+/* The inner loop has no branches and no dependence between hashes so the
+ * compiler is free to vectorize it */
+static void clusterSign(const struct clusterSet *set, uint32_t *signature,
+	const uint64_t term)
+{
+	size_t i;
+
+	for (i = 0; i < CLUSTER_HASHES; i++)
+	{
+		const uint32_t val
+			= (uint32_t) ((set->mul[i] * term + set->add[i]) >> 32);
+
+		signature[i] = (val < signature[i]) ? val : signature[i];
+	}
+}
+
+/* Prompts without a single term aren't added, they'd all look alike */
+int clusterAddPrompt(struct clusterSet *set, const size_t id,
+	const char *prompt, const size_t len)
+{
+	struct stiToken *tokens = NULL;
+	uint32_t *signature = NULL;
+	size_t i, num_tokens = 0, num_terms = 0;
+
+	if (set->len == set->cap)
+	{
+		const size_t new_cap = (set->cap == 0)
+			? CLUSTER_GUESS_LEN : set->cap << 1;
+		uint32_t *sigs = realloc(set->signatures,
+			sizeof(uint32_t) * CLUSTER_HASHES * new_cap);
+		size_t *ids;
+
+		if (sigs == NULL)
+		{
+			return 1;
+		}
+
+		set->signatures = sigs;
+
+		if ((ids = realloc(set->ids, sizeof(size_t) * new_cap)) == NULL)
+		{
+			return 1;
+		}
+
+		set->ids = ids;
+		set->cap = new_cap;
+	}
+
+	if ((tokens = stiNewTokenStack(prompt, len, GO_TILL_LEN,
+		CLUSTER_DELIMS, &num_tokens)) == NULL)
+	{
+		return (len != 0);
+	}
+
+	signature = set->signatures + set->len * CLUSTER_HASHES;
+	memset(signature, 0xFF, sizeof(uint32_t) * CLUSTER_HASHES);
+
+	for (i = 0; i < num_tokens; i++)
+	{
+		char term[TERM_MAX];
+		const size_t term_len = termNormalize(
+			prompt + tokens[i].token_start,
+			tokens[i].token_end - tokens[i].token_start, term);
+
+		if (term_len != 0)
+		{
+			clusterSign(set, signature, clusterHash(term, term_len));
+			num_terms++;
+		}
+	}
+
+	free(tokens);
+
+	if (num_terms != 0)
+	{
+		set->ids[set->len++] = id;
+	}
+
+	return 0;
+}
+
+static size_t clusterFind(size_t *roots, size_t member)
+{
+	while (roots[member] != member)
+	{
+		roots[member] = roots[roots[member]];
+		member = roots[member];
+	}
+
+	return member;
+}
+
+/* The smaller index stays the root so a cluster is led by its first image */
+static void clusterUnion(size_t *roots, const size_t left,
+	const size_t right)
+{
+	const size_t l = clusterFind(roots, left);
+	const size_t r = clusterFind(roots, right);
+
+	if (l < r)
+	{
+		roots[r] = l;
+	}
+	else if (r < l)
+	{
+		roots[l] = r;
+	}
+}
+
+static float clusterSimilarity(const struct clusterSet *set,
+	const size_t left, const size_t right)
+{
+	const uint32_t *l = set->signatures + left * CLUSTER_HASHES;
+	const uint32_t *r = set->signatures + right * CLUSTER_HASHES;
+	size_t i, same = 0;
+
+	for (i = 0; i < CLUSTER_HASHES; i++)
+	{
+		same += (l[i] == r[i]);
+	}
+
+	return (float) same / CLUSTER_HASHES;
+}
+
+static int clusterBucketCmp(const void *left, const void *right)
+{
+	const struct clusterBucket *l = (const struct clusterBucket *) left;
+	const struct clusterBucket *r = (const struct clusterBucket *) right;
+
+	if (l->key != r->key)
+	{
+		return (l->key < r->key) ? -1 : 1;
+	}
+
+	return (l->member < r->member) ? -1 : (l->member > r->member);
+}
+
+/* One band at a time, members agreeing on every row of a band land in the
+ * same bucket and every pair in it not already joined is compared, so a 
+ * cluster doesn't hinge on whichever member happened to sort first */
+int clusterBuild(struct clusterSet *set)
+{
+	struct clusterBucket *buckets = NULL;
+	size_t band, i, j, first;
+
+	free(set->order);
+	free(set->roots);
+	set->order = NULL;
+
+	if (((set->roots = malloc(sizeof(size_t) * (set->len + 1))) == NULL)
+	|| ((set->order = malloc(sizeof(size_t) * (set->len + 1))) == NULL)
+	|| ((buckets = malloc(sizeof(struct clusterBucket) * (set->len + 1)))
+		== NULL))
+	{
+		return 1;
+	}
+
+	for (i = 0; i < set->len; i++)
+	{
+		set->roots[i] = i;
+	}
+
+	for (band = 0; (band < set->bands) && (set->len > 1); band++)
+	{
+		for (i = 0; i < set->len; i++)
+		{
+			const char *rows = (const char *) (set->signatures
+				+ i * CLUSTER_HASHES + band * set->rows);
+
+			buckets[i].key = clusterHash(rows,
+				sizeof(uint32_t) * set->rows);
+			buckets[i].member = i;
+		}
+
+		qsort(buckets, set->len, sizeof(struct clusterBucket),
+			clusterBucketCmp);
+
+		for (first = 0; first < set->len; first = i)
+		{
+			for (i = first + 1; (i < set->len) 
+			&& (buckets[i].key == buckets[first].key); i++)
+			{
+				const size_t right = buckets[i].member;
+
+				for (j = first; j < i; j++)
+				{
+					const size_t left = buckets[j].member;
+
+					if ((clusterFind(set->roots, left)
+						!= clusterFind(set->roots, 
+						right))
+					&& (clusterSimilarity(set, left, 
+						right) >= set->threshold))
+					{
+						clusterUnion(set->roots, left,
+							right);
+					}
+				}
+			}
+		}
+	}
+
+	/* Roots are each cluster's first member so sorting on root then
+	 * member keeps both the clusters and their members in order added */
+	for (i = 0; i < set->len; i++)
+	{
+		set->roots[i] = clusterFind(set->roots, i);
+		buckets[i].key = set->roots[i];
+		buckets[i].member = i;
+	}
+
+	if (set->len != 0)
+	{
+		qsort(buckets, set->len, sizeof(struct clusterBucket),
+			clusterBucketCmp);
+	}
+
+	for (i = 0; i < set->len; i++)
+	{
+		set->order[i] = buckets[i].member;
+	}
+
+	free(buckets);
+
+	return 0;
+}
+
+void clusterFree(struct clusterSet *set)
+{
+	if (set == NULL)
+	{
+		return;
+	}
+
+	free(set->signatures);
+	free(set->ids);
+	free(set->order);
+	free(set->roots);
+	memset(set, 0, sizeof(struct clusterSet));
+}
@@ -0,0 +1,43 @@
+#ifndef PROMPT_CLUSTER_H
+#define PROMPT_CLUSTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Groups images whose prompts share most of their comma separated terms.
+ * Each prompt is boiled down to a MinHash signature, the fraction of
+ * signature values two prompts agree on estimates the Jaccard similarity
+ * of their term sets. Signatures are cut into bands and only prompts that
+ * match on a whole band are ever compared, so there's no all pairs pass.
+ * How the signature is cut follows from the threshold, so that pairs at
+ * the threshold have at least an even chance of sharing some band and more
+ * similar ones almost always do. Only the signatures and the caller's ids
+ * are kept per image */
+
+#define CLUSTER_HASHES 64
+#define CLUSTER_GUESS_LEN 256
+
+struct clusterSet
+{
+	uint32_t *signatures; /* CLUSTER_HASHES per member */
+	size_t *ids;
+	size_t len;
+	size_t cap;
+	float threshold;
+	size_t bands;
+	size_t rows; /* bands * rows is always CLUSTER_HASHES */
+	uint64_t mul[CLUSTER_HASHES];
+	uint64_t add[CLUSTER_HASHES];
+	/* Filled in by clusterBuild, members sorted so that every cluster is
+	 * a run with the same root, in the order they were added */
+	size_t *order;
+	size_t *roots;
+};
+
+int clusterInit(struct clusterSet *set, const float threshold);
+int clusterAddPrompt(struct clusterSet *set, const size_t id,
+	const char *prompt, const size_t len);
+int clusterBuild(struct clusterSet *set);
+void clusterFree(struct clusterSet *set);
+
+#endif /* PROMPT_CLUSTER_H */
@@ -0,0 +1,1050 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "scriptOutput.h"
+#include "outputBuffer.h"
+
+#define SCRIPT_GUESS_LEN 64
+#define SCRIPT_PATH_MAX  2048
+
+#define SCRIPT_FNV_OFFSET 14695981039346656037ULL
+#define SCRIPT_FNV_PRIME  1099511628211ULL
+
+/* A run of sorted entries sharing the same keys that all go to one job file,
+ * a group only gets broken into several pieces when it alone is bigger than 
+ * a job's fair share */
+struct scriptPiece
+{
+	size_t first;
+	size_t count;
+	size_t job;
+};
+
+static char* lazyStrdup(const char *src)
+{
+	char *dst = NULL;
+
+	if (src != NULL)
+	{
+		const size_t len = strlen(src) + 1;
+
+		if ((dst = malloc(sizeof(char) * (len))) != NULL)
+		{
+			dst = strncpy(dst, src, len);
+		}
+	}
+
+	return dst;
+}
+
+/* Takes ownership of command on success only, seed and output may be NULL
+ * but then the entry can never be collapsed into a batched invocation */
+int scriptBatchAdd(struct scriptBatch *batch, const char *path, 
+	char *command, const size_t command_len, 
+	const struct scriptSpan *keys, const struct scriptSpan *seed,
+	const struct scriptSpan *output, const struct paramValues *values)
+{
+	struct scriptEntry *entry = NULL;
+
+	if ((batch == NULL) || (path == NULL) || (command == NULL))
+	{
+		return 1;
+	}
+
+	if (batch->len == batch->cap)
+	{
+		const size_t new_cap = (batch->cap == 0) 
+			? SCRIPT_GUESS_LEN : batch->cap << 1;
+		struct scriptEntry *tmp = realloc(batch->entries, 
+			sizeof(struct scriptEntry) * new_cap);
+
+		if (tmp == NULL)
+		{
+			return 1;
+		}
+
+		batch->entries = tmp;
+		batch->cap     = new_cap;
+	}
+
+	entry = &batch->entries[batch->len];
+	memset(entry, 0, sizeof(struct scriptEntry));
+
+	if ((entry->path = lazyStrdup(path)) == NULL)
+	{
+		return 1;
+	}
+
+	entry->command     = command;
+	entry->command_len = command_len;
+	entry->order       = batch->len;
+
+	if (keys != NULL)
+	{
+		memcpy(entry->keys, keys, sizeof(entry->keys));
+	}
+
+	if (seed != NULL)
+	{
+		entry->seed = *seed;
+	}
+
+	if (output != NULL)
+	{
+		entry->output = *output;
+	}
+
+	if (values != NULL)
+	{
+		entry->values = *values;
+	}
+
+	batch->len++;
+
+	return 0;
+}
+
+static int scriptKeyCmp(const struct scriptEntry *left, 
+	const struct scriptEntry *right)
+{
+	size_t i;
+
+	for (i = 0; i < SCRIPT_NUM_KEYS; i++)
+	{
+		const struct scriptSpan l = left->keys[i];
+		const struct scriptSpan r = right->keys[i];
+		const int ret = memcmp(left->command + l.start, 
+			right->command + r.start, (l.len < r.len) ? l.len : r.len);
+
+		if (ret != 0)
+		{
+			return ret;
+		}
+
+		if (l.len != r.len)
+		{
+			return (l.len < r.len) ? -1 : 1;
+		}
+	}
+
+	return 0;
+}
+
+/* qsort isn't stable so fall back to argument order on ties */
+static int scriptEntryCmp(const void *left, const void *right)
+{
+	const struct scriptEntry *l = (const struct scriptEntry *) left;
+	const struct scriptEntry *r = (const struct scriptEntry *) right;
+	const int ret = scriptKeyCmp(l, r);
+
+	if (ret != 0)
+	{
+		return ret;
+	}
+
+	return (l->order < r->order) ? -1 : (l->order > r->order);
+}
+
+/* Biggest pieces first, the usual longest-processing-time heuristic */
+static int scriptPieceCmp(const void *left, const void *right)
+{
+	const struct scriptPiece *l = *(const struct scriptPiece * const *) left;
+	const struct scriptPiece *r = *(const struct scriptPiece * const *) right;
+
+	if (l->count != r->count)
+	{
+		return (l->count > r->count) ? -1 : 1;
+	}
+
+	return (l->first < r->first) ? -1 : (l->first > r->first);
+}
+
+static size_t scriptBuildPieces(const struct scriptBatch *batch, 
+	const size_t share, struct scriptPiece *pieces)
+{
+	size_t i, num_pieces = 0;
+
+	for (i = 0; i < batch->len; i++)
+	{
+		if ((i == 0)
+		|| (scriptKeyCmp(&batch->entries[i - 1], 
+			&batch->entries[i]) != 0)
+		|| (pieces[num_pieces - 1].count == share))
+		{
+			pieces[num_pieces].first = i;
+			pieces[num_pieces].count = 0;
+			pieces[num_pieces].job   = 0;
+			num_pieces++;
+		}
+
+		pieces[num_pieces - 1].count++;
+	}
+
+	return num_pieces;
+}
+
+/* Greedily hands the largest remaining piece to the least loaded job */
+static int scriptAssignJobs(struct scriptPiece *pieces, 
+	const size_t num_pieces, const size_t num_jobs)
+{
+	struct scriptPiece **order = NULL;
+	size_t *load = NULL;
+	size_t i, j;
+
+	if (((order = malloc(sizeof(struct scriptPiece *) 
+		* (num_pieces + 1))) == NULL)
+	|| ((load = calloc(num_jobs, sizeof(size_t))) == NULL))
+	{
+		free(order);
+
+		return 1;
+	}
+
+	for (i = 0; i < num_pieces; i++)
+	{
+		order[i] = &pieces[i];
+	}
+
+	qsort(order, num_pieces, sizeof(struct scriptPiece *), scriptPieceCmp);
+
+	for (i = 0; i < num_pieces; i++)
+	{
+		size_t lightest = 0;
+
+		for (j = 1; j < num_jobs; j++)
+		{
+			if (load[j] < load[lightest])
+			{
+				lightest = j;
+			}
+		}
+
+		order[i]->job = lightest;
+		load[lightest] += order[i]->count;
+	}
+
+	free(load);
+	free(order);
+
+	return 0;
+}
+
+/* Comments hold file names and models straight out of the images, a 
+ * newline in one would otherwise start a line the shell runs */
+static void scriptPutComment(FILE *fhandle, const char *text, 
+	const size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		const unsigned char ch = (unsigned char) text[i];
+
+		fputc(((ch < 0x20) || (ch == 0x7F)) ? '?' : ch, fhandle);
+	}
+}
+
+static int scriptSameModel(const struct scriptEntry *left, 
+	const struct scriptEntry *right)
+{
+	const struct scriptSpan l = left->keys[SCRIPT_KEY_MODEL];
+	const struct scriptSpan r = right->keys[SCRIPT_KEY_MODEL];
+
+	return (l.len == r.len) && (memcmp(left->command + l.start, 
+		right->command + r.start, l.len) == 0);
+}
+
+static int scriptWriteJob(const struct scriptBatch *batch, 
+	const struct scriptPiece *pieces, const size_t num_pieces,
+	const char *path, const size_t job, const size_t num_jobs)
+{
+	FILE *fhandle = NULL;
+	const struct scriptEntry *last = NULL;
+	size_t i, j, num_entries = 0, num_loads = 0;
+
+	if ((fhandle = fopen(path, "wb")) == NULL)
+	{
+		fprintf(stderr, "Unable to open %s for writing\n", path);
+
+		return 1;
+	}
+
+	/* A job can be handed neighbouring pieces of one group, only a change
+	 * of model between one command and the next costs a load */
+	for (i = 0; i < num_pieces; i++)
+	{
+		if (pieces[i].job != job)
+		{
+			continue;
+		}
+
+		for (j = 0; j < pieces[i].count; j++)
+		{
+			const struct scriptEntry *entry 
+				= &batch->entries[pieces[i].first + j];
+
+			num_loads += ((last == NULL) 
+				|| (scriptSameModel(last, entry) == 0));
+			last = entry;
+		}
+
+		num_entries += pieces[i].count;
+	}
+
+	fprintf(fhandle, "#!/bin/sh\n"
+		"# sdPromptDumper regeneration script, job %lu of %lu\n"
+		"# %lu invocations, %lu model loads\n\n"
+		"SDPD_OUT_DIR=\"${SDPD_OUT_DIR:-./regen}\"\n"
+		"mkdir -p \"$SDPD_OUT_DIR\" || exit 1\n",
+		(unsigned long) job + 1, (unsigned long) num_jobs, 
+		(unsigned long) num_entries, (unsigned long) num_loads);
+
+	/* Pieces were built in sorted order so walking them in order keeps 
+	 * every group a job received contiguous */
+	for (i = 0; i < num_pieces; i++)
+	{
+		const struct scriptEntry *head = NULL;
+
+		if (pieces[i].job != job)
+		{
+			continue;
+		}
+
+		head = &batch->entries[pieces[i].first];
+		fputs("\n# Model: ", fhandle);
+
+		if (head->keys[SCRIPT_KEY_MODEL].len == 0)
+		{
+			fputs("(none)", fhandle);
+		}
+
+		scriptPutComment(fhandle, 
+			head->command + head->keys[SCRIPT_KEY_MODEL].start, 
+			head->keys[SCRIPT_KEY_MODEL].len);
+		fputc('\n', fhandle);
+
+		for (j = 0; j < pieces[i].count; j++)
+		{
+			const struct scriptEntry *entry 
+				= &batch->entries[pieces[i].first + j];
+
+			fputs("\n# ", fhandle);
+			scriptPutComment(fhandle, entry->path, 
+				strlen(entry->path));
+			fputc('\n', fhandle);
+			fwrite(entry->command, sizeof(char), 
+				entry->command_len, fhandle);
+		}
+	}
+
+	if (fclose(fhandle) != 0)
+	{
+		fprintf(stderr, "Error finishing %s\n", path);
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Sorts the batch so invocations sharing a model, VAE, and LoRA directory 
+ * run consecutively and then writes them out as num_jobs shell scripts of
+ * roughly equal length, file_path is used as is for a single job otherwise
+ * the job number is appended to it, ie: regen.sh.1, regen.sh.2, ... */
+int scriptBatchWrite(struct scriptBatch *batch, const char *file_path,
+	const size_t num_jobs)
+{
+	struct scriptPiece *pieces = NULL;
+	size_t i, num_pieces, share;
+	int ret = 0;
+
+	if ((batch == NULL) || (file_path == NULL) || (num_jobs == 0))
+	{
+		return 1;
+	}
+
+	if (strlen(file_path) + 24 >= SCRIPT_PATH_MAX)
+	{
+		fprintf(stderr, "Script path too long: %s\n", file_path);
+
+		return 1;
+	}
+
+	/* An empty batch still gets its script, entries is NULL though */
+	if (batch->len != 0)
+	{
+		qsort(batch->entries, batch->len, sizeof(struct scriptEntry),
+			scriptEntryCmp);
+	}
+
+	if ((pieces = malloc(sizeof(struct scriptPiece) 
+		* (batch->len + 1))) == NULL)
+	{
+		return 1;
+	}
+
+	share = (batch->len + num_jobs - 1) / num_jobs;
+	num_pieces = scriptBuildPieces(batch, (share == 0) ? 1 : share, 
+		pieces);
+
+	if (scriptAssignJobs(pieces, num_pieces, num_jobs) != 0)
+	{
+		free(pieces);
+
+		return 1;
+	}
+
+	for (i = 0; (i < num_jobs) && (ret == 0); i++)
+	{
+		char path[SCRIPT_PATH_MAX] = {0};
+
+		if (num_jobs == 1)
+		{
+			strcpy(path, file_path);
+		}
+		else
+		{
+			sprintf(path, "%s.%lu", file_path, (unsigned long) i + 1);
+		}
+
+		ret = scriptWriteJob(batch, pieces, num_pieces, path, i, 
+			num_jobs);
+	}
+
+	free(pieces);
+
+	return ret;
+}
+
+/* Per entry bookkeeping for the seed collapse, groups are kept as singly 
+ * linked lists threaded through this array so no per group allocation is
+ * needed */
+struct scriptSeedInfo
+{
+	unsigned long long seed;
+	uint64_t hash;
+	size_t head;
+	size_t next;
+	int valid;
+};
+
+struct scriptSeedMember
+{
+	unsigned long long seed;
+	size_t order;
+	size_t index;
+};
+
+/* A piece of text to swap in for a span of an entry's command */
+struct scriptSplice
+{
+	struct scriptSpan span;
+	const char *text;
+	size_t text_len;
+};
+
+/* Everything but the seed and output name, which is what has to match for
+ * two invocations to be folded together */
+static void scriptMaskSegments(const struct scriptEntry *entry, 
+	struct scriptSpan *segs)
+{
+	segs[0].start = 0;
+	segs[0].len   = entry->seed.start;
+	segs[1].start = entry->seed.start + entry->seed.len;
+	segs[1].len   = entry->output.start - segs[1].start;
+	segs[2].start = entry->output.start + entry->output.len;
+	segs[2].len   = entry->command_len - segs[2].start;
+}
+
+static int scriptParseSeed(const struct scriptEntry *entry, 
+	unsigned long long *seed)
+{
+	const char *str = entry->command + entry->seed.start;
+	unsigned long long tmp = 0;
+	size_t i;
+
+	if ((entry->seed.len == 0) || (entry->seed.len > 19)
+	|| (entry->output.len == 0)
+	|| (entry->seed.start + entry->seed.len > entry->output.start))
+	{
+		return 0;
+	}
+
+	for (i = 0; i < entry->seed.len; i++)
+	{
+		if ((str[i] < '0') || (str[i] > '9'))
+		{
+			return 0;
+		}
+
+		tmp = (tmp * 10) + (unsigned long long) (str[i] - '0');
+	}
+
+	*seed = tmp;
+
+	return 1;
+}
+
+/* FNV-1a over the masked command */
+static uint64_t scriptHashMasked(const struct scriptEntry *entry)
+{
+	struct scriptSpan segs[3];
+	uint64_t hash = SCRIPT_FNV_OFFSET;
+	size_t i, j;
+
+	scriptMaskSegments(entry, segs);
+
+	for (i = 0; i < 3; i++)
+	{
+		const unsigned char *str = (const unsigned char *) 
+			entry->command + segs[i].start;
+
+		for (j = 0; j < segs[i].len; j++)
+		{
+			hash = (hash ^ str[j]) * SCRIPT_FNV_PRIME;
+		}
+
+		hash = (hash ^ 0xFF) * SCRIPT_FNV_PRIME;
+	}
+
+	return hash;
+}
+
+static int scriptMaskedEqual(const struct scriptEntry *left, 
+	const struct scriptEntry *right)
+{
+	struct scriptSpan l[3], r[3];
+	size_t i;
+
+	scriptMaskSegments(left, l);
+	scriptMaskSegments(right, r);
+
+	for (i = 0; i < 3; i++)
+	{
+		if ((l[i].len != r[i].len)
+		|| (memcmp(left->command + l[i].start, 
+			right->command + r[i].start, l[i].len) != 0))
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int scriptMemberCmp(const void *left, const void *right)
+{
+	const struct scriptSeedMember *l 
+		= (const struct scriptSeedMember *) left;
+	const struct scriptSeedMember *r 
+		= (const struct scriptSeedMember *) right;
+
+	if (l->seed != r->seed)
+	{
+		return (l->seed < r->seed) ? -1 : 1;
+	}
+
+	return (l->order < r->order) ? -1 : (l->order > r->order);
+}
+
+/* Threads every collapsible entry onto the list of the first entry with the
+ * same masked command using an open addressed table of group heads, one pass
+ * over the batch regardless of how it is ordered */
+static int scriptGroupSeeds(const struct scriptBatch *batch, 
+	struct scriptSeedInfo *info)
+{
+	size_t *table = NULL;
+	size_t *tails = NULL;
+	size_t i, table_len = 16;
+
+	while (table_len < (batch->len << 1))
+	{
+		table_len <<= 1;
+	}
+
+	if (((table = calloc(table_len, sizeof(size_t))) == NULL)
+	|| ((tails = malloc(sizeof(size_t) * batch->len)) == NULL))
+	{
+		free(table);
+
+		return 1;
+	}
+
+	for (i = 0; i < batch->len; i++)
+	{
+		const struct scriptEntry *entry = &batch->entries[i];
+		size_t slot;
+
+		info[i].head  = i;
+		info[i].next  = batch->len;
+		info[i].valid = scriptParseSeed(entry, &info[i].seed);
+		tails[i] = i;
+
+		if (info[i].valid == 0)
+		{
+			continue;
+		}
+
+		info[i].hash = scriptHashMasked(entry);
+
+		/* Slots hold index + 1 so zero can mean empty */
+		for (slot = (size_t) info[i].hash & (table_len - 1);
+			table[slot] != 0; slot = (slot + 1) & (table_len - 1))
+		{
+			const size_t head = table[slot] - 1;
+
+			if ((info[head].hash == info[i].hash)
+			&& (scriptMaskedEqual(&batch->entries[head], entry)))
+			{
+				info[i].head = head;
+				info[tails[head]].next = i;
+				tails[head] = i;
+
+				break;
+			}
+		}
+
+		if (table[slot] == 0)
+		{
+			table[slot] = i + 1;
+		}
+	}
+
+	free(tails);
+	free(table);
+
+	return 0;
+}
+
+/* Rebuilds an entry's command with the splices applied, which must be in
+ * ascending order, wrapping the result in prefix and suffix. The key spans
+ * are shifted to match, the seed and output spans are cleared since the 
+ * result can't be collapsed any further */
+static int scriptSpliceEntry(struct scriptEntry *entry, 
+	const struct scriptSplice *splices, const size_t num_splices,
+	const char *prefix, const char *suffix)
+{
+	struct outputBuffer out = {0};
+	struct scriptSpan keys[SCRIPT_NUM_KEYS];
+	size_t i, k, cursor = 0;
+	char *command = NULL;
+
+	/* Shifted keys are only ever tested where they started, one moved 
+	 * past the next splice mustn't be moved again */
+	memcpy(keys, entry->keys, sizeof(keys));
+	outputPuts(&out, prefix);
+
+	for (i = 0; i < num_splices; i++)
+	{
+		const struct scriptSpan span = splices[i].span;
+		const long delta = (long) out.len - (long) cursor;
+
+		for (k = 0; k < SCRIPT_NUM_KEYS; k++)
+		{
+			if ((keys[k].start >= cursor) 
+			&& (keys[k].start < span.start))
+			{
+				entry->keys[k].start = keys[k].start + delta;
+			}
+		}
+
+		outputAppend(&out, entry->command + cursor, 
+			span.start - cursor);
+		outputAppend(&out, splices[i].text, splices[i].text_len);
+		cursor = span.start + span.len;
+	}
+
+	for (k = 0; k < SCRIPT_NUM_KEYS; k++)
+	{
+		if (keys[k].start >= cursor)
+		{
+			entry->keys[k].start = keys[k].start + out.len - cursor;
+		}
+	}
+
+	outputAppend(&out, entry->command + cursor, 
+		entry->command_len - cursor);
+	outputPuts(&out, suffix);
+
+	if (out.error != 0)
+	{
+		outputFree(&out);
+
+		return 1;
+	}
+
+	entry->command_len = out.len;
+
+	if ((command = outputDetach(&out)) == NULL)
+	{
+		return 1;
+	}
+
+	free(entry->command);
+	entry->command = command;
+	memset(&entry->seed, 0, sizeof(struct scriptSpan));
+	memset(&entry->output, 0, sizeof(struct scriptSpan));
+
+	return 0;
+}
+
+/* Folds members[first..last) into whichever came first on the command line,
+ * its path becomes every member's path joined in one go, returns that 
+ * entry's index or batch->len on failure */
+static size_t scriptFoldRange(struct scriptBatch *batch, 
+	const struct scriptSeedMember *members, const size_t first, 
+	const size_t last)
+{
+	struct scriptEntry *head = NULL;
+	size_t i, survivor = first, len = 0;
+	char *joined = NULL, *cursor = NULL;
+
+	for (i = first; i < last; i++)
+	{
+		if (members[i].order < members[survivor].order)
+		{
+			survivor = i;
+		}
+
+		len += strlen(batch->entries[members[i].index].path) + 2;
+	}
+
+	if ((joined = malloc(len)) == NULL)
+	{
+		return batch->len;
+	}
+
+	head = &batch->entries[members[survivor].index];
+	cursor = joined + strlen(head->path);
+	memcpy(joined, head->path, strlen(head->path));
+
+	for (i = first; i < last; i++)
+	{
+		struct scriptEntry *victim = &batch->entries[members[i].index];
+		size_t v_len;
+
+		if (i == survivor)
+		{
+			continue;
+		}
+
+		v_len = strlen(victim->path);
+		memcpy(cursor, ", ", 2);
+		memcpy(cursor + 2, victim->path, v_len);
+		cursor += v_len + 2;
+		free(victim->path);
+		free(victim->command);
+		victim->path    = NULL;
+		victim->command = NULL;
+	}
+
+	*cursor = '\0';
+	free(head->path);
+	head->path = joined;
+
+	return members[survivor].index;
+}
+
+/* A run of consecutive seeds is exactly what --batch-count generates */
+static int scriptEmitBatchCount(struct scriptEntry *entry, 
+	const unsigned long long seed, const size_t count, const int abrv)
+{
+	struct scriptSplice splice;
+	char text[64] = {0};
+
+	splice.span     = entry->seed;
+	splice.text     = text;
+	splice.text_len = (size_t) sprintf(text, "%llu %s %lu", seed, 
+		(abrv != 0) ? "-b" : "--batch-count", (unsigned long) count);
+
+	return scriptSpliceEntry(entry, &splice, 1, "", "");
+}
+
+/* Seeds that don't line up still get a single compact loop, the output name
+ * gets the seed inserted ahead of its extension so they don't clobber each
+ * other, ie: "a.png" becomes "a"_${seed}".png". The seed is put outside the
+ * name's own quotes since single quotes wouldn't expand it */
+static int scriptEmitSeedLoop(struct scriptEntry *entry, 
+	const struct scriptSeedMember *members, const size_t *picks,
+	const size_t num_picks)
+{
+	const char *name = entry->command + entry->output.start;
+	const size_t name_len = entry->output.len;
+	struct outputBuffer prefix = {0};
+	struct outputBuffer output = {0};
+	struct scriptSplice splices[2];
+	const char quote = ((name_len > 0) && ((name[name_len - 1] == '"') 
+		|| (name[name_len - 1] == '\''))) ? name[name_len - 1] : '\0';
+	size_t i, cut = name_len;
+	int ret;
+
+	outputPuts(&prefix, "for seed in");
+
+	for (i = 0; i < num_picks; i++)
+	{
+		char tmp[32] = {0};
+
+		sprintf(tmp, " %llu", members[picks[i]].seed);
+		outputPuts(&prefix, tmp);
+	}
+
+	outputPuts(&prefix, "\ndo\n\t");
+
+	for (i = name_len; i > 0; i--)
+	{
+		if ((name[i - 1] == '/') || (name[i - 1] == '\\'))
+		{
+			break;
+		}
+
+		if (name[i - 1] == '.')
+		{
+			cut = i - 1;
+
+			break;
+		}
+	}
+
+	if ((cut == name_len) && (name_len > 0)
+	&& ((quote != '\0') || (name[name_len - 1] == '>')))
+	{
+		cut = name_len - 1;
+	}
+
+	outputAppend(&output, name, cut);
+
+	if (quote != '\0')
+	{
+		outputPutc(&output, quote);
+		outputPuts(&output, "_${seed}");
+		outputPutc(&output, quote);
+	}
+	else
+	{
+		outputPuts(&output, "_${seed}");
+	}
+
+	outputAppend(&output, name + cut, name_len - cut);
+	outputPutc(&prefix, '\0');
+
+	if ((prefix.error != 0) || (output.error != 0))
+	{
+		outputFree(&prefix);
+		outputFree(&output);
+
+		return 1;
+	}
+
+	splices[0].span     = entry->seed;
+	splices[0].text     = "$seed";
+	splices[0].text_len = sizeof("$seed") - 1;
+	splices[1].span     = entry->output;
+	splices[1].text     = output.data;
+	splices[1].text_len = output.len;
+	ret = scriptSpliceEntry(entry, splices, 2, prefix.data, "done\n");
+	outputFree(&prefix);
+	outputFree(&output);
+
+	return ret;
+}
+
+static int scriptCollapseGroup(struct scriptBatch *batch, 
+	struct scriptSeedMember *members, const size_t num_members, 
+	const int abrv)
+{
+	size_t *picks = NULL;
+	size_t i, run_start, num_picks = 0;
+
+	qsort(members, num_members, sizeof(struct scriptSeedMember),
+		scriptMemberCmp);
+
+	if ((picks = malloc(sizeof(size_t) * num_members)) == NULL)
+	{
+		return 1;
+	}
+
+	for (run_start = 0; run_start < num_members; run_start = i)
+	{
+		size_t distinct = 1, survivor;
+
+		for (i = run_start + 1; (i < num_members)
+		&& (members[i].seed - members[i - 1].seed <= 1); i++)
+		{
+			distinct += (members[i].seed != members[i - 1].seed);
+		}
+
+		/* Identical invocations just get folded together, the seed 
+		 * would only reproduce the same image again */
+		if ((survivor = scriptFoldRange(batch, members, run_start, 
+			i)) == batch->len)
+		{
+			free(picks);
+
+			return 1;
+		}
+
+		if (distinct > 1)
+		{
+			if (scriptEmitBatchCount(&batch->entries[survivor], 
+				members[run_start].seed, distinct, abrv) != 0)
+			{
+				free(picks);
+
+				return 1;
+			}
+		}
+		else
+		{
+			size_t j;
+
+			for (j = run_start; members[j].index != survivor; j++);
+
+			picks[num_picks++] = j;
+		}
+	}
+
+	if (num_picks > 1)
+	{
+		struct scriptSeedMember *tmp = NULL;
+		size_t survivor;
+
+		/* Fold the leftovers down to one entry then loop over them,
+		 * the member list is reused to keep them in seed order */
+		if ((tmp = malloc(sizeof(struct scriptSeedMember) 
+			* num_picks)) == NULL)
+		{
+			free(picks);
+
+			return 1;
+		}
+
+		for (i = 0; i < num_picks; i++)
+		{
+			tmp[i] = members[picks[i]];
+			picks[i] = i;
+		}
+
+		if (((survivor = scriptFoldRange(batch, tmp, 0, num_picks)) 
+			== batch->len)
+		|| (scriptEmitSeedLoop(&batch->entries[survivor], tmp, picks,
+			num_picks) != 0))
+		{
+			free(tmp);
+			free(picks);
+
+			return 1;
+		}
+
+		free(tmp);
+	}
+
+	free(picks);
+
+	return 0;
+}
+
+/* Finds sets of invocations that are identical but for their seed and folds
+ * each into a single command, consecutive seeds become one --batch-count 
+ * invocation so sd loads the model and encodes the prompt once for the lot,
+ * whatever is left over becomes a shell loop over the remaining seeds. 
+ * Surviving entries keep the position of their earliest member */
+int scriptBatchCollapseSeeds(struct scriptBatch *batch, const int abrv)
+{
+	struct scriptSeedInfo *info = NULL;
+	struct scriptSeedMember *members = NULL;
+	size_t i, j, kept = 0;
+	int ret = 0;
+
+	if ((batch == NULL) || (batch->len < 2))
+	{
+		return 0;
+	}
+
+	if (((info = malloc(sizeof(struct scriptSeedInfo) 
+		* batch->len)) == NULL)
+	|| ((members = malloc(sizeof(struct scriptSeedMember) 
+		* batch->len)) == NULL)
+	|| (scriptGroupSeeds(batch, info) != 0))
+	{
+		free(members);
+		free(info);
+
+		return 1;
+	}
+
+	for (i = 0; (i < batch->len) && (ret == 0); i++)
+	{
+		size_t num_members = 0;
+
+		if ((info[i].valid == 0) || (info[i].head != i) 
+		|| (info[i].next == batch->len))
+		{
+			continue;
+		}
+
+		for (j = i; j != batch->len; j = info[j].next)
+		{
+			members[num_members].seed  = info[j].seed;
+			members[num_members].order = batch->entries[j].order;
+			members[num_members].index = j;
+			num_members++;
+		}
+
+		ret = scriptCollapseGroup(batch, members, num_members, abrv);
+	}
+
+	for (i = 0; i < batch->len; i++)
+	{
+		if (batch->entries[i].command != NULL)
+		{
+			batch->entries[kept++] = batch->entries[i];
+		}
+	}
+
+	batch->len = kept;
+	free(members);
+	free(info);
+
+	return ret;
+}
+
+/* Same layout the per file output uses */
+void scriptBatchPrint(const struct scriptBatch *batch, FILE *fhandle)
+{
+	size_t i;
+
+	if ((batch == NULL) || (fhandle == NULL))
+	{
+		return;
+	}
+
+	for (i = 0; i < batch->len; i++)
+	{
+		fprintf(fhandle, "\n%s:\n\n", batch->entries[i].path);
+		fwrite(batch->entries[i].command, sizeof(char), 
+			batch->entries[i].command_len, fhandle);
+	}
+}
+
+void scriptBatchFree(struct scriptBatch *batch)
+{
+	size_t i;
+
+	if (batch == NULL)
+	{
+		return;
+	}
+
+	for (i = 0; i < batch->len; i++)
+	{
+		free(batch->entries[i].path);
+		free(batch->entries[i].command);
+	}
+
+	free(batch->entries);
+	batch->entries = NULL;
+	batch->len     = 0;
+	batch->cap     = 0;
+}
@@ -0,0 +1,56 @@
+#ifndef SCRIPT_OUTPUT_H
+#define SCRIPT_OUTPUT_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "paramValues.h"
+
+/* The values that decide which weights sd has to load for an invocation, 
+ * commands sharing all three of these can run back to back without any 
+ * reloading in between */
+enum scriptKey
+{
+	SCRIPT_KEY_MODEL = 0,
+	SCRIPT_KEY_VAE,
+	SCRIPT_KEY_LORA,
+	SCRIPT_NUM_KEYS
+};
+
+/* Offsets into an entry's command rather than copies of the values */
+struct scriptSpan
+{
+	size_t start;
+	size_t len;
+};
+
+struct scriptEntry
+{
+	char *path;
+	char *command; /* Newline terminated sd invocation */
+	size_t command_len;
+	struct scriptSpan keys[SCRIPT_NUM_KEYS];
+	struct scriptSpan seed;   /* Value only, not the switch */
+	struct scriptSpan output; /* Likewise */
+	struct paramValues values;
+	size_t order;  /* Argument order, keeps the sort stable */
+};
+
+struct scriptBatch
+{
+	struct scriptEntry *entries;
+	size_t len;
+	size_t cap;
+};
+
+int scriptBatchAdd(struct scriptBatch *batch, const char *path, 
+	char *command, const size_t command_len, 
+	const struct scriptSpan *keys, const struct scriptSpan *seed,
+	const struct scriptSpan *output, const struct paramValues *values);
+int scriptBatchCollapseSeeds(struct scriptBatch *batch, const int abrv);
+void scriptBatchPrint(const struct scriptBatch *batch, FILE *fhandle);
+int scriptBatchWrite(struct scriptBatch *batch, const char *file_path,
+	const size_t num_jobs);
+void scriptBatchFree(struct scriptBatch *batch);
+
+#endif /* SCRIPT_OUTPUT_H */
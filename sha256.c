@@ -0,0 +1,153 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sha256.h"
+
+#define SHA256_ROTR(x, r) (((x) >> (r)) | ((x) << (32 - (r))))
+
+static const uint32_t sha256_k[64] =
+{
+	0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1,
+	0x923F82A4, 0xAB1C5ED5, 0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3,
+	0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174, 0xE49B69C1, 0xEFBE4786,
+	0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+	0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147,
+	0x06CA6351, 0x14292967, 0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13,
+	0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85, 0xA2BFE8A1, 0xA81A664B,
+	0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+	0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A,
+	0x5B9CCA4F, 0x682E6FF3, 0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208,
+	0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+static void sha256Block(uint32_t *state, const unsigned char *block)
+{
+	uint32_t w[64], s[8];
+	size_t i;
+
+	for (i = 0; i < 16; i++)
+	{
+		w[i] = ((uint32_t) block[i * 4] << 24) 
+			| ((uint32_t) block[i * 4 + 1] << 16)
+			| ((uint32_t) block[i * 4 + 2] << 8) 
+			| (uint32_t) block[i * 4 + 3];
+	}
+
+	for (; i < 64; i++)
+	{
+		const uint32_t s0 = SHA256_ROTR(w[i - 15], 7) 
+			^ SHA256_ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		const uint32_t s1 = SHA256_ROTR(w[i - 2], 17) 
+			^ SHA256_ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	memcpy(s, state, sizeof(s));
+
+	for (i = 0; i < 64; i++)
+	{
+		const uint32_t e1 = SHA256_ROTR(s[4], 6) ^ SHA256_ROTR(s[4], 11) 
+			^ SHA256_ROTR(s[4], 25);
+		const uint32_t ch = (s[4] & s[5]) ^ (~s[4] & s[6]);
+		const uint32_t t1 = s[7] + e1 + ch + sha256_k[i] + w[i];
+		const uint32_t e0 = SHA256_ROTR(s[0], 2) ^ SHA256_ROTR(s[0], 13) 
+			^ SHA256_ROTR(s[0], 22);
+		const uint32_t maj = (s[0] & s[1]) ^ (s[0] & s[2]) 
+			^ (s[1] & s[2]);
+
+		s[7] = s[6];
+		s[6] = s[5];
+		s[5] = s[4];
+		s[4] = s[3] + t1;
+		s[3] = s[2];
+		s[2] = s[1];
+		s[1] = s[0];
+		s[0] = t1 + e0 + maj;
+	}
+
+	for (i = 0; i < 8; i++)
+	{
+		state[i] += s[i];
+	}
+}
+
+void sha256Init(struct sha256 *hash)
+{
+	static const uint32_t initial[8] =
+	{
+		0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+		0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+	};
+
+	memset(hash, 0, sizeof(struct sha256));
+	memcpy(hash->state, initial, sizeof(initial));
+}
+
+void sha256Update(struct sha256 *hash, const unsigned char *data, 
+	size_t len)
+{
+	hash->len += len;
+
+	if (hash->block_len != 0)
+	{
+		const size_t want = SHA256_BLOCK - hash->block_len;
+		const size_t take = (len < want) ? len : want;
+
+		memcpy(hash->block + hash->block_len, data, take);
+		hash->block_len += take;
+		data += take;
+		len  -= take;
+
+		if (hash->block_len < SHA256_BLOCK)
+		{
+			return;
+		}
+
+		sha256Block(hash->state, hash->block);
+		hash->block_len = 0;
+	}
+
+	for (; len >= SHA256_BLOCK; data += SHA256_BLOCK, len -= SHA256_BLOCK)
+	{
+		sha256Block(hash->state, data);
+	}
+
+	memcpy(hash->block, data, len);
+	hash->block_len = len;
+}
+
+void sha256Final(struct sha256 *hash, unsigned char *digest)
+{
+	const uint64_t bits = hash->len << 3;
+	size_t i;
+
+	hash->block[hash->block_len++] = 0x80;
+
+	if (hash->block_len > SHA256_BLOCK - 8)
+	{
+		memset(hash->block + hash->block_len, 0, 
+			SHA256_BLOCK - hash->block_len);
+		sha256Block(hash->state, hash->block);
+		hash->block_len = 0;
+	}
+
+	memset(hash->block + hash->block_len, 0, 
+		SHA256_BLOCK - 8 - hash->block_len);
+
+	for (i = 0; i < 8; i++)
+	{
+		hash->block[SHA256_BLOCK - 1 - i] 
+			= (unsigned char) (bits >> (i * 8));
+	}
+
+	sha256Block(hash->state, hash->block);
+
+	for (i = 0; i < 8; i++)
+	{
+		digest[i * 4]     = (unsigned char) (hash->state[i] >> 24);
+		digest[i * 4 + 1] = (unsigned char) (hash->state[i] >> 16);
+		digest[i * 4 + 2] = (unsigned char) (hash->state[i] >> 8);
+		digest[i * 4 + 3] = (unsigned char) hash->state[i];
+	}
+}
@@ -0,0 +1,26 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Plain FIPS 180-4 SHA-256, only here to match the model hashes other
+ * front ends write into their images */
+
+#define SHA256_BLOCK  64
+#define SHA256_DIGEST 32
+
+struct sha256
+{
+	uint32_t state[8];
+	unsigned char block[SHA256_BLOCK];
+	size_t block_len;
+	uint64_t len;
+};
+
+void sha256Init(struct sha256 *hash);
+void sha256Update(struct sha256 *hash, const unsigned char *data, 
+	size_t len);
+void sha256Final(struct sha256 *hash, unsigned char *digest);
+
+#endif /* SHA256_H */
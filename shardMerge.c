@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "outputBuffer.h"
+#include "shardMerge.h"
+
+struct mergeInput
+{
+	FILE *fhandle;
+	const char *path;
+	struct outputBuffer line;
+	struct outputBuffer prev;
+	size_t num_lines;
+};
+
+/* Takes "i/N", returns 1 unless 0 <= i < N <= SHARD_MAX */
+int shardParse(const char *arg, size_t *index, size_t *count)
+{
+	size_t *dst = index;
+
+	*index = *count = 0;
+
+	if ((*arg < '0') || (*arg > '9'))
+	{
+		return 1;
+	}
+
+	for (; *arg != '\0'; arg++)
+	{
+		if ((*arg == '/') && (dst == index) && (arg[1] >= '0') 
+		&& (arg[1] <= '9'))
+		{
+			dst = count;
+		}
+		else if ((*arg < '0') || (*arg > '9') || (*dst > SHARD_MAX))
+		{
+			return 1;
+		}
+		else
+		{
+			*dst = *dst * 10 + (size_t) (*arg - '0');
+		}
+	}
+
+	return ((dst != count) || (*count == 0) || (*count > SHARD_MAX)
+		|| (*index >= *count));
+}
+
+/* FNV-1a with a splitmix64 finish, fixed so every host agrees on it */
+size_t shardOf(const char *path, const size_t count)
+{
+	uint64_t hash = 14695981039346656037ull;
+
+	for (; *path != '\0'; path++)
+	{
+		hash = (hash ^ (unsigned char) *path) * 1099511628211ull;
+	}
+
+	hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+	hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+	hash ^= hash >> 31;
+
+	return (size_t) (hash % count);
+}
+
+/* Reads the next line into input->line without its newline, returns 1 at
+ * the end of the file, -1 on an error */
+static int mergeNextLine(struct mergeInput *input)
+{
+	struct outputBuffer tmp = input->prev;
+	int ch;
+
+	input->prev = input->line;
+	input->line = tmp;
+	outputReset(&input->line);
+
+	if ((ch = getc(input->fhandle)) == EOF)
+	{
+		return (ferror(input->fhandle) != 0) ? -1 : 1;
+	}
+
+	for (; (ch != EOF) && (ch != '\n'); ch = getc(input->fhandle))
+	{
+		outputPutc(&input->line, (char) ch);
+	}
+
+	if ((outputPutc(&input->line, '\0') != 0) 
+	|| (ferror(input->fhandle) != 0))
+	{
+		return -1;
+	}
+
+	input->num_lines++;
+
+	/* A shard out of order would quietly make the merge out of order */
+	if ((input->num_lines > 1) 
+	&& (strcmp(input->prev.data, input->line.data) > 0))
+	{
+		fprintf(stderr, "%s: Line %lu is out of order, shard outputs "
+			"have to be sorted\n", input->path, 
+			(unsigned long) input->num_lines);
+
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Ties go to the earlier file so the result never depends on timing */
+static int mergeLess(const struct mergeInput *inputs, const size_t left,
+	const size_t right)
+{
+	const int cmp = strcmp(inputs[left].line.data, 
+		inputs[right].line.data);
+
+	return (cmp < 0) || ((cmp == 0) && (left < right));
+}
+
+static void mergeSiftDown(const struct mergeInput *inputs, size_t *heap,
+	const size_t len, size_t pos)
+{
+	for (;;)
+	{
+		const size_t left = 2 * pos + 1;
+		const size_t right = left + 1;
+		size_t min = pos, tmp;
+
+		if ((left < len) && (mergeLess(inputs, heap[left], heap[min])))
+		{
+			min = left;
+		}
+
+		if ((right < len) 
+		&& (mergeLess(inputs, heap[right], heap[min])))
+		{
+			min = right;
+		}
+
+		if (min == pos)
+		{
+			return;
+		}
+
+		tmp = heap[pos];
+		heap[pos] = heap[min];
+		heap[min] = tmp;
+		pos = min;
+	}
+}
+
+/* k-way merge of the files' lines by byte order, only one line per file is
+ * ever held in memory */
+int shardMerge(char **paths, const size_t num_paths, FILE *out)
+{
+	struct mergeInput *inputs = NULL;
+	size_t *heap = NULL;
+	size_t i, len = 0;
+	int ret = 0;
+
+	if (((inputs = calloc(num_paths + 1, sizeof(struct mergeInput))) 
+		== NULL)
+	|| ((heap = malloc(sizeof(size_t) * (num_paths + 1))) == NULL))
+	{
+		fprintf(stderr, "Unable to allocate merge state\n");
+		free(inputs);
+
+		return 1;
+	}
+
+	for (i = 0; i < num_paths; i++)
+	{
+		int status;
+
+		inputs[i].path = paths[i];
+
+		if ((inputs[i].fhandle = fopen(paths[i], "rb")) == NULL)
+		{
+			fprintf(stderr, "Error opening %s\n", paths[i]);
+			ret = 1;
+
+			break;
+		}
+
+		if ((status = mergeNextLine(&inputs[i])) < 0)
+		{
+			ret = 1;
+
+			break;
+		}
+		else if (status == 0)
+		{
+			heap[len++] = i;
+		}
+	}
+
+	for (i = len / 2; (ret == 0) && (i-- > 0);)
+	{
+		mergeSiftDown(inputs, heap, len, i);
+	}
+
+	while ((ret == 0) && (len != 0))
+	{
+		struct mergeInput *top = &inputs[heap[0]];
+		int status;
+
+		fputs(top->line.data, out);
+		putc('\n', out);
+
+		if ((status = mergeNextLine(top)) < 0)
+		{
+			ret = 1;
+		}
+		else if (status == 1)
+		{
+			heap[0] = heap[--len];
+		}
+
+		mergeSiftDown(inputs, heap, len, 0);
+	}
+
+	if ((ret == 0) && (ferror(out) != 0))
+	{
+		fprintf(stderr, "Unable to write the merged output\n");
+		ret = 1;
+	}
+
+	for (i = 0; i < num_paths; i++)
+	{
+		if (inputs[i].fhandle != NULL)
+		{
+			fclose(inputs[i].fhandle);
+		}
+
+		outputFree(&inputs[i].line);
+		outputFree(&inputs[i].prev);
+	}
+
+	free(heap);
+	free(inputs);
+
+	return ret;
+}
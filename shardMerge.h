@@ -0,0 +1,20 @@
+#ifndef SHARD_MERGE_H
+#define SHARD_MERGE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Splitting a scan over several processes or hosts. Each input goes to the
+ * shard picked by a fixed hash of its path as given, so N runs handed the
+ * same arguments with --shard 0/N through N-1/N cover every input exactly
+ * once with no coordination. Their outputs, each sorted by line, are then
+ * merged back into the one result a single run would have given */
+
+#define SHARD_MAX 65536
+
+int shardParse(const char *arg, size_t *index, size_t *count);
+size_t shardOf(const char *path, const size_t count);
+int shardMerge(char **paths, const size_t num_paths, FILE *out);
+
+#endif /* SHARD_MERGE_H */
@@ -0,0 +1,149 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "outputBuffer.h"
+#include "shellQuote.h"
+
+#define QUOTE_ONES  0x0101010101010101ull
+#define QUOTE_HIGHS 0x8080808080808080ull
+#define QUOTE_WORD  sizeof(uint64_t)
+
+/* Every byte of the word set to ch */
+#define QUOTE_SPLAT(ch) (QUOTE_ONES * (unsigned char) (ch))
+
+/* Non-zero if any byte of x is zero, exact as a yes or no even though it
+ * can't say which byte */
+#define QUOTE_HAS_ZERO(x) (((x) - QUOTE_ONES) & ~(x) & QUOTE_HIGHS)
+
+static const char double_specials[] = {'"', '$', '`', '\\'};
+static const char single_specials[] = {'\''};
+
+static const struct
+{
+	const char *name;
+	enum shellStyle style;
+} shell_styles[] =
+{
+	{"double", SHELL_DOUBLE},
+	{"single", SHELL_SINGLE}
+};
+
+int shellStyleParse(const char *name, enum shellStyle *style)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(shell_styles) / sizeof(shell_styles[0]); i++)
+	{
+		if (strcmp(name, shell_styles[i].name) == 0)
+		{
+			*style = shell_styles[i].style;
+
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* Length of the run before the first special, words are loaded with 
+ * memcpy so the string can start anywhere */
+static size_t shellScan(const char *str, const size_t len, 
+	const char *specials, const size_t num_specials)
+{
+	size_t i, j;
+
+	for (i = 0; i + QUOTE_WORD <= len; i += QUOTE_WORD)
+	{
+		uint64_t word, hits = 0;
+
+		memcpy(&word, str + i, QUOTE_WORD);
+
+		for (j = 0; j < num_specials; j++)
+		{
+			hits |= QUOTE_HAS_ZERO(word ^ QUOTE_SPLAT(specials[j]));
+		}
+
+		if (hits != 0)
+		{
+			break;
+		}
+	}
+
+	for (; i < len; i++)
+	{
+		if (memchr(specials, str[i], num_specials) != NULL)
+		{
+			break;
+		}
+	}
+
+	return i;
+}
+
+int shellQuote(struct outputBuffer *out, const char *str, const size_t len,
+	const enum shellStyle style)
+{
+	const char quote = (style == SHELL_SINGLE) ? '\'' : '"';
+	const char *specials = (style == SHELL_SINGLE) 
+		? single_specials : double_specials;
+	const size_t num_specials = (style == SHELL_SINGLE)
+		? sizeof(single_specials) : sizeof(double_specials);
+	size_t i = 0;
+
+	outputPutc(out, quote);
+
+	while (i < len)
+	{
+		const size_t run = shellScan(str + i, len - i, specials, 
+			num_specials);
+
+		outputAppend(out, str + i, run);
+
+		if ((i += run) == len)
+		{
+			break;
+		}
+
+		/* A single quote can't be escaped inside single quotes, so the
+		 * quoting is closed, an escaped one written, and reopened */
+		if (style == SHELL_SINGLE)
+		{
+			outputAppend(out, "'\\''", 4);
+		}
+		else
+		{
+			outputPutc(out, '\\');
+			outputPutc(out, str[i]);
+		}
+
+		i++;
+	}
+
+	return outputPutc(out, quote) | out->error;
+}
+
+/* Nothing a shell would split on, expand, or glob */
+static int shellIsPlain(const char ch)
+{
+	return ((ch >= 'a') && (ch <= 'z')) || ((ch >= 'A') && (ch <= 'Z'))
+		|| ((ch >= '0') && (ch <= '9')) 
+		|| ((ch != '\0') && (strchr("_-.,:+=@%/", ch) != NULL));
+}
+
+/* Values made only of plain characters go out as they are, so the usual 
+ * numbers and file names aren't cluttered with quotes, anything else is 
+ * quoted like a prompt */
+int shellQuoteWord(struct outputBuffer *out, const char *str, 
+	const size_t len, const enum shellStyle style)
+{
+	size_t i;
+
+	for (i = 0; (i < len) && (shellIsPlain(str[i]) != 0); i++);
+
+	if ((i == len) && (len != 0))
+	{
+		return outputAppend(out, str, len);
+	}
+
+	return shellQuote(out, str, len, style);
+}
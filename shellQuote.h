@@ -0,0 +1,25 @@
+#ifndef SHELL_QUOTE_H
+#define SHELL_QUOTE_H
+
+#include <stddef.h>
+
+#include "outputBuffer.h"
+
+/* Quotes a string so a POSIX shell reads it back exactly as is. Text is
+ * checked eight bytes at a time for anything needing an escape and the
+ * clean runs in between are copied over whole, so a long prompt with
+ * nothing to escape costs about as much as a memcpy */
+
+enum shellStyle
+{
+	SHELL_DOUBLE = 0, /* "...", with \ before ", $, `, and \ */
+	SHELL_SINGLE      /* '...', with ' written as '\'' */
+};
+
+int shellStyleParse(const char *name, enum shellStyle *style);
+int shellQuote(struct outputBuffer *out, const char *str, const size_t len,
+	const enum shellStyle style);
+int shellQuoteWord(struct outputBuffer *out, const char *str, 
+	const size_t len, const enum shellStyle style);
+
+#endif /* SHELL_QUOTE_H */
@@ -0,0 +1,410 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "internPool.h"
+#include "sortRuns.h"
+
+/* Records per run at the very least, whatever the budget */
+#define SORT_MIN_LEN   1024
+#define SORT_GUESS_LEN 256
+
+static const char *const sort_key_names[SORT_NUM_KEYS] =
+{
+	"model", "seed", "steps", "cfg", "size", "mtime"
+};
+
+static int sortParseKeys(struct sortRuns *sorter, const char *arg)
+{
+	while (*arg != '\0')
+	{
+		size_t i, len;
+
+		for (len = 0; (arg[len] != ',') && (arg[len] != '\0'); len++);
+
+		for (i = 0; (i < SORT_NUM_KEYS) 
+		&& ((strncmp(sort_key_names[i], arg, len) != 0)
+		|| (sort_key_names[i][len] != '\0')); i++);
+
+		if ((i == SORT_NUM_KEYS) || (sorter->num_keys == SORT_NUM_KEYS))
+		{
+			fprintf(stderr, "Unknown sort key \"%.*s\", expected one"
+				" of model, seed, steps, cfg, size, or mtime\n",
+				(int) len, arg);
+
+			return 1;
+		}
+
+		sorter->keys[sorter->num_keys++] = (enum sortKey) i;
+		arg += (arg[len] == ',') ? len + 1 : len;
+	}
+
+	return (sorter->num_keys == 0);
+}
+
+int sortRunsInit(struct sortRuns *sorter, const char *keys, 
+	const size_t budget, const struct internPool *pool)
+{
+	memset(sorter, 0, sizeof(struct sortRuns));
+	sorter->pool = pool;
+	sorter->cap = budget / sizeof(struct sortRecord);
+
+	if (sorter->cap < SORT_MIN_LEN)
+	{
+		sorter->cap = SORT_MIN_LEN;
+	}
+
+	return sortParseKeys(sorter, keys);
+}
+
+#define SORT_CMP(l, r) (((l) > (r)) - ((l) < (r)))
+
+static int sortModelCmp(const struct internPool *pool, const uint32_t left,
+	const uint32_t right)
+{
+	size_t l_len, r_len;
+	const char *l = internGet(pool, left, &l_len);
+	const char *r = internGet(pool, right, &r_len);
+	const int cmp = memcmp(l, r, (l_len < r_len) ? l_len : r_len);
+
+	return (cmp != 0) ? cmp : SORT_CMP(l_len, r_len);
+}
+
+static int sortCmp(const struct sortRuns *sorter, 
+	const struct sortRecord *l, const struct sortRecord *r)
+{
+	size_t i;
+
+	for (i = 0; i < sorter->num_keys; i++)
+	{
+		const uint32_t bit = SORT_BIT(sorter->keys[i]);
+		int cmp = 0;
+
+		if ((l->present & bit) != (r->present & bit))
+		{
+			return ((l->present & bit) != 0) ? -1 : 1;
+		}
+		else if ((l->present & bit) == 0)
+		{
+			continue;
+		}
+
+		switch (sorter->keys[i])
+		{
+			case SORT_KEY_MODEL:
+				cmp = (l->model == r->model) ? 0 
+					: sortModelCmp(sorter->pool, l->model, 
+						r->model);
+				break;
+			case SORT_KEY_SEED:
+				cmp = SORT_CMP(l->seed, r->seed);
+				break;
+			case SORT_KEY_STEPS:
+				cmp = SORT_CMP(l->steps, r->steps);
+				break;
+			case SORT_KEY_CFG:
+				cmp = SORT_CMP(l->cfg, r->cfg);
+				break;
+			case SORT_KEY_SIZE:
+				cmp = SORT_CMP(l->size, r->size);
+				break;
+			case SORT_KEY_MTIME:
+				cmp = SORT_CMP(l->mtime, r->mtime);
+				break;
+			default: /* fallthrough */
+				break;
+		}
+
+		if (cmp != 0)
+		{
+			return cmp;
+		}
+	}
+
+	return SORT_CMP(l->order, r->order);
+}
+
+/* Heapsort rather than qsort since the comparison needs the sorter, and it
+ * doesn't ask for any more memory than the budget already holds */
+static void sortSiftDown(const struct sortRuns *sorter, 
+	struct sortRecord *records, const size_t len, size_t pos)
+{
+	for (;;)
+	{
+		const size_t left = 2 * pos + 1;
+		const size_t right = left + 1;
+		size_t max = pos;
+		struct sortRecord tmp;
+
+		if ((left < len) 
+		&& (sortCmp(sorter, &records[left], &records[max]) > 0))
+		{
+			max = left;
+		}
+
+		if ((right < len)
+		&& (sortCmp(sorter, &records[right], &records[max]) > 0))
+		{
+			max = right;
+		}
+
+		if (max == pos)
+		{
+			return;
+		}
+
+		tmp = records[pos];
+		records[pos] = records[max];
+		records[max] = tmp;
+		pos = max;
+	}
+}
+
+static void sortRecords(const struct sortRuns *sorter, 
+	struct sortRecord *records, const size_t len)
+{
+	size_t i;
+
+	for (i = len / 2; i-- > 0;)
+	{
+		sortSiftDown(sorter, records, len, i);
+	}
+
+	for (i = len; i-- > 1;)
+	{
+		const struct sortRecord tmp = records[0];
+
+		records[0] = records[i];
+		records[i] = tmp;
+		sortSiftDown(sorter, records, i, 0);
+	}
+}
+
+static int sortSpill(struct sortRuns *sorter)
+{
+	FILE **runs = NULL;
+	FILE *run = NULL;
+
+	if ((runs = realloc(sorter->runs, 
+		sizeof(FILE*) * (sorter->num_runs + 1))) == NULL)
+	{
+		return 1;
+	}
+
+	sorter->runs = runs;
+
+	if ((run = tmpfile()) == NULL)
+	{
+		fprintf(stderr, "Unable to create a temporary file to sort "
+			"in\n");
+
+		return 1;
+	}
+
+	sorter->runs[sorter->num_runs++] = run;
+	sortRecords(sorter, sorter->records, sorter->len);
+
+	if (fwrite(sorter->records, sizeof(struct sortRecord), sorter->len,
+		run) != sorter->len)
+	{
+		fprintf(stderr, "Unable to write a sorted run\n");
+
+		return 1;
+	}
+
+	sorter->len = 0;
+
+	return 0;
+}
+
+int sortRunsAdd(struct sortRuns *sorter, struct sortRecord *record)
+{
+	if ((sorter->len == sorter->cap) && (sortSpill(sorter) != 0))
+	{
+		return 1;
+	}
+
+	/* Grows toward the budget rather than taking all of it up front */
+	if (sorter->len == sorter->alloc)
+	{
+		size_t new_alloc = (sorter->alloc == 0) 
+			? SORT_GUESS_LEN : sorter->alloc << 1;
+		struct sortRecord *tmp;
+
+		new_alloc = (new_alloc > sorter->cap) ? sorter->cap : new_alloc;
+
+		if ((tmp = realloc(sorter->records, 
+			sizeof(struct sortRecord) * new_alloc)) == NULL)
+		{
+			return 1;
+		}
+
+		sorter->records = tmp;
+		sorter->alloc = new_alloc;
+	}
+
+	record->order = sorter->num_added++;
+	sorter->records[sorter->len++] = *record;
+
+	return 0;
+}
+
+static int sortRead(FILE *run, struct sortRecord *record)
+{
+	if (fread(record, sizeof(struct sortRecord), 1, run) == 1)
+	{
+		return 0;
+	}
+
+	return (ferror(run) != 0) ? -1 : 1;
+}
+
+static void sortMergeSiftDown(struct sortRuns *sorter, size_t pos)
+{
+	size_t *heap = sorter->heap;
+
+	for (;;)
+	{
+		const size_t left = 2 * pos + 1;
+		const size_t right = left + 1;
+		size_t min = pos, tmp;
+
+		if ((left < sorter->heap_len) && (sortCmp(sorter, 
+			&sorter->heads[heap[left]], &sorter->heads[heap[min]]) 
+			< 0))
+		{
+			min = left;
+		}
+
+		if ((right < sorter->heap_len) && (sortCmp(sorter,
+			&sorter->heads[heap[right]], &sorter->heads[heap[min]])
+			< 0))
+		{
+			min = right;
+		}
+
+		if (min == pos)
+		{
+			return;
+		}
+
+		tmp = heap[pos];
+		heap[pos] = heap[min];
+		heap[min] = tmp;
+		pos = min;
+	}
+}
+
+/* Everything fitting in the budget never touches the disk at all */
+int sortRunsFinish(struct sortRuns *sorter)
+{
+	size_t i;
+
+	if (sorter->num_runs == 0)
+	{
+		sortRecords(sorter, sorter->records, sorter->len);
+		sorter->next = 0;
+
+		return 0;
+	}
+
+	if (((sorter->len != 0) && (sortSpill(sorter) != 0))
+	|| ((sorter->heads = malloc(sizeof(struct sortRecord) 
+		* sorter->num_runs)) == NULL)
+	|| ((sorter->heap = malloc(sizeof(size_t) * sorter->num_runs)) 
+		== NULL))
+	{
+		return 1;
+	}
+
+	/* Done with the in memory records, the runs hold them all now */
+	free(sorter->records);
+	sorter->records = NULL;
+	sorter->alloc = 0;
+
+	for (i = 0; i < sorter->num_runs; i++)
+	{
+		int status;
+
+		rewind(sorter->runs[i]);
+
+		if ((status = sortRead(sorter->runs[i], &sorter->heads[i])) < 0)
+		{
+			return 1;
+		}
+		else if (status == 0)
+		{
+			sorter->heap[sorter->heap_len++] = i;
+		}
+	}
+
+	for (i = sorter->heap_len / 2; i-- > 0;)
+	{
+		sortMergeSiftDown(sorter, i);
+	}
+
+	return 0;
+}
+
+/* Returns 0 with the next record in order, 1 after the last, -1 if a run 
+ * couldn't be read */
+int sortRunsNext(struct sortRuns *sorter, struct sortRecord *record)
+{
+	size_t top;
+	int status;
+
+	if (sorter->num_runs == 0)
+	{
+		if (sorter->next == sorter->len)
+		{
+			return 1;
+		}
+
+		*record = sorter->records[sorter->next++];
+
+		return 0;
+	}
+
+	if (sorter->heap_len == 0)
+	{
+		return 1;
+	}
+
+	top = sorter->heap[0];
+	*record = sorter->heads[top];
+
+	if ((status = sortRead(sorter->runs[top], &sorter->heads[top])) < 0)
+	{
+		return -1;
+	}
+	else if (status == 1)
+	{
+		sorter->heap[0] = sorter->heap[--sorter->heap_len];
+	}
+
+	sortMergeSiftDown(sorter, 0);
+
+	return 0;
+}
+
+void sortRunsFree(struct sortRuns *sorter)
+{
+	size_t i;
+
+	if (sorter == NULL)
+	{
+		return;
+	}
+
+	for (i = 0; i < sorter->num_runs; i++)
+	{
+		fclose(sorter->runs[i]);
+	}
+
+	free(sorter->runs);
+	free(sorter->records);
+	free(sorter->heads);
+	free(sorter->heap);
+	memset(sorter, 0, sizeof(struct sortRuns));
+}
@@ -0,0 +1,71 @@
+#ifndef SORT_RUNS_H
+#define SORT_RUNS_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "internPool.h"
+
+/* Sorts small fixed size records standing in for formatted output kept 
+ * elsewhere, the output itself is never moved. Records pile up in memory 
+ * until the budget is reached, then get sorted and spilled to a temporary 
+ * file as a run. Once everything is in the runs are merged back together, 
+ * so only the budget plus one record per run is ever held in memory */
+
+enum sortKey
+{
+	SORT_KEY_MODEL = 0,
+	SORT_KEY_SEED,
+	SORT_KEY_STEPS,
+	SORT_KEY_CFG,
+	SORT_KEY_SIZE,
+	SORT_KEY_MTIME,
+	SORT_NUM_KEYS
+};
+
+#define SORT_BIT(key) ((uint32_t) 1 << (key))
+#define SORT_DEFAULT_BUDGET ((size_t) 64 << 20)
+
+/* Keys a record doesn't have sort after all those that do */
+struct sortRecord
+{
+	uint64_t seed;
+	uint64_t size;   /* Width times height */
+	uint64_t mtime;
+	uint64_t offset; /* Where the caller's output is */
+	uint64_t order;  /* Ties go to the record added first */
+	float cfg;
+	uint32_t steps;
+	uint32_t model;  /* From the pool */
+	uint32_t len;
+	uint32_t present; /* SORT_BIT of every key it has */
+};
+
+struct sortRuns
+{
+	struct sortRecord *records;
+	size_t len;
+	size_t alloc;
+	size_t cap; /* Most records held at once, set by the budget */
+	enum sortKey keys[SORT_NUM_KEYS];
+	size_t num_keys;
+	const struct internPool *pool;
+	uint64_t num_added;
+	FILE **runs;
+	size_t num_runs;
+	/* Merge state, one current record per run */
+	struct sortRecord *heads;
+	size_t *heap;
+	size_t heap_len;
+	size_t next; /* Into records when nothing was spilled */
+};
+
+int sortRunsInit(struct sortRuns *sorter, const char *keys, 
+	const size_t budget, const struct internPool *pool);
+int sortRunsAdd(struct sortRuns *sorter, struct sortRecord *record);
+int sortRunsFinish(struct sortRuns *sorter);
+int sortRunsNext(struct sortRuns *sorter, struct sortRecord *record);
+void sortRunsFree(struct sortRuns *sorter);
+
+#endif /* SORT_RUNS_H */
@@ -247,40 +247,68 @@ size_t stiTokenizeExplicitString(const char *str, const size_t str_len,
 	return num_tokens;
 }
 
-#ifdef STI_INCLUDE_FILE_TOKENIZER
-
-/* Unused and untested, just thought it was an interesting idea to tokenize
- * file contents in-place */
+/* Tokenizes len bytes of a file from the current position in-place, reading
+ * through a fixed window so memory use is the same however long the span is.
+ * Tokens are absolute file offsets, stiReadToken can fetch their contents.
+ * Unlike the string tokenizers this stops as soon as the stack is full 
+ * rather than counting on, re-reading a file just to count is a great deal
+ * more expensive than re-scanning memory. Callers wanting more tokens can 
+ * pick up from one past the end of the last token returned. If 'stack' is 
+ * NULL, or stack_len 0, the whole span is counted. The file position is 
+ * restored before returning */
 size_t stiTokenizeFile(FILE *fhandle, const long int len, const char *delims, 
-	struct stiToken *stack, const size_t stack_len)
+	struct stiToken *stack, const size_t stack_len, STI_READ_FUNC *reader)
 {
+	char window[STI_FILE_WINDOW];
 	struct stiToken dummy = {0};
-	size_t i, num_tokens = 0;
-	long int f_start;
-	int tmp;
+	const STI_BOOL counting = ((stack == NULL) || (stack_len == 0))
+		? STI_TRUE : STI_FALSE;
+	size_t i, got, num_tokens = 0;
+	long int f_start, done = 0;
 
-	if ((fhandle == NULL) || (delims == NULL) 
+	if ((fhandle == NULL) || (delims == NULL) || (len < 0)
 	|| ((f_start = ftell(fhandle)) == -1))
 	{
 		return 0;
 	}
 
-	dummy.token_start = f_start;
+	dummy.token_start = (size_t) f_start;
+	reader = (reader == NULL) ? fread : reader;
 
-	for (i = 0; (i < len) && ((tmp = fgetc(fhandle)) != EOF); i++)
+	while (done < len)
 	{
-		size_t j;
+		const size_t want = (len - done < STI_FILE_WINDOW)
+			? (size_t) (len - done) : STI_FILE_WINDOW;
 
-		for (j = 0; delims[j] != '\0'; j++)
+		if ((got = reader(window, sizeof(char), want, fhandle)) == 0)
 		{
-			if (str[i] == delims[j])
+			break;
+		}
+
+		for (i = 0; i < got; i++)
+		{
+			size_t j;
+
+			for (j = 0; delims[j] != '\0'; j++)
 			{
-				dummy.token_end = f_start + i;
+				if (window[i] != delims[j])
+				{
+					continue;
+				}
 
-				if ((stack != NULL) 
-				&& (num_tokens < stack_len))
+				dummy.token_end = (size_t) (f_start + done) + i;
+
+				if (counting == STI_FALSE)
 				{
 					stack[num_tokens] = dummy;
+
+					if (num_tokens + 1 == stack_len)
+					{
+						fseek(fhandle, f_start, 
+							SEEK_SET);
+
+						return stack_len;
+					}
 				}
 
 				num_tokens++;
@@ -289,12 +317,13 @@ size_t stiTokenizeFile(FILE *fhandle, const long int len, const char *delims,
 				break;
 			}
 		}
+
+		done += (long int) got;
 	}
 
-	dummy.token_end = f_start + i;
+	dummy.token_end = (size_t) (f_start + done);
 
-	if ((stack != NULL)
-	&& (num_tokens < stack_len))
+	if (counting == STI_FALSE)
 	{
 		stack[num_tokens] = dummy;
 	}
@@ -305,4 +334,32 @@ size_t stiTokenizeFile(FILE *fhandle, const long int len, const char *delims,
 	return num_tokens;
 }
 
-#endif /* STI_INCLUDE_FILE_TOKENIZER */
+/* Copies up to dst_len bytes of a file token into dst, returns the number of
+ * bytes copied. The file position is restored before returning */
+size_t stiReadToken(FILE *fhandle, const struct stiToken *token, char *dst,
+	const size_t dst_len, STI_READ_FUNC *reader)
+{
+	size_t want, got;
+	long int f_start;
+
+	if ((fhandle == NULL) || (token == NULL) || (dst == NULL)
+	|| (token->token_end < token->token_start)
+	|| ((f_start = ftell(fhandle)) == -1))
+	{
+		return 0;
+	}
+
+	want = token->token_end - token->token_start;
+	want = (want < dst_len) ? want : dst_len;
+
+	if (fseek(fhandle, (long int) token->token_start, SEEK_SET) != 0)
+	{
+		return 0;
+	}
+
+	reader = (reader == NULL) ? fread : reader;
+	got = reader(dst, sizeof(char), want, fhandle);
+	fseek(fhandle, f_start, SEEK_SET);
+
+	return got;
+}
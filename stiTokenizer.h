@@ -31,12 +31,23 @@ size_t stiTokenizeNullString(const char *str, const char *delims,
 size_t stiTokenizeExplicitString(const char *str, const size_t str_len,
 	const char *delims, struct stiToken *stack, const size_t stack_len);
 
-#ifdef STI_INCLUDE_FILE_TOKENIZER
+/* Size of the read window used by the file tokenizer, the only memory it 
+ * needs beyond the caller's stack */
+#ifndef STI_FILE_WINDOW
+#define STI_FILE_WINDOW 4096
+#endif /* STI_FILE_WINDOW */
+
 #include <stdio.h>
 
+/* Stands in for fread, for callers that need to see every read, NULL is
+ * plain fread */
+typedef size_t (STI_READ_FUNC)(void *dst, size_t size, size_t count, 
+	FILE *fhandle);
+
 size_t stiTokenizeFile(FILE *fhandle, const long int len, const char *delims,
-	struct stiToken *stack, const size_t stack_len);
-#endif
+	struct stiToken *stack, const size_t stack_len, STI_READ_FUNC *reader);
+size_t stiReadToken(FILE *fhandle, const struct stiToken *token, char *dst,
+	const size_t dst_len, STI_READ_FUNC *reader);
 
 #endif /* STI_TOKENIZER_H */
 
@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "summary.h"
+
+static const struct
+{
+	const char *name;
+	enum paramField field;
+	double width; /* Of each bucket, the first starts at 0 */
+} summary_numbers[SUMMARY_NUM_NUMBERS] =
+{
+	{"steps",  PARAM_STEPS,  5},
+	{"cfg",    PARAM_CFG,    1},
+	{"width",  PARAM_WIDTH,  128},
+	{"height", PARAM_HEIGHT, 128}
+};
+
+static const struct
+{
+	const char *name;
+	const char *label;
+} summary_categories[SUMMARY_NUM_CATEGORIES] =
+{
+	{"model",   "Model"},
+	{"sampler", "Sampler"},
+	{"rng",     "RNG"}
+};
+
+/* Counts a labelled value if it's one of the categories, anything else is
+ * quietly ignored */
+int summaryField(struct summary *sum, const char *label, const char *value,
+	size_t len)
+{
+	struct summaryCounts *cat = NULL;
+	uint32_t id;
+	size_t i;
+
+	for (i = 0; (i < SUMMARY_NUM_CATEGORIES)
+	&& (strcmp(summary_categories[i].label, label) != 0); i++);
+
+	if (i == SUMMARY_NUM_CATEGORIES)
+	{
+		return 0;
+	}
+
+	cat   = &sum->categories[i];
+	value = paramTrim(value, &len);
+
+	if (internString(&cat->pool, value, len, &id) != 0)
+	{
+		return 1;
+	}
+
+	if (id >= cat->cap)
+	{
+		const size_t new_cap = (cat->cap == 0)
+			? INTERN_GUESS_LEN : cat->cap << 1;
+		uint64_t *tmp = realloc(cat->counts,
+			sizeof(uint64_t) * new_cap);
+
+		if (tmp == NULL)
+		{
+			return 1;
+		}
+
+		memset(tmp + cat->cap, 0,
+			sizeof(uint64_t) * (new_cap - cat->cap));
+		cat->counts = tmp;
+		cat->cap = new_cap;
+	}
+
+	cat->counts[id]++;
+
+	return 0;
+}
+
+/* Adds one image's decoded settings, also counts the image itself */
+void summaryValues(struct summary *sum, const struct paramValues *values)
+{
+	size_t i;
+
+	for (i = 0; i < SUMMARY_NUM_NUMBERS; i++)
+	{
+		struct summaryStats *stats = &sum->numbers[i];
+		double val, bucket;
+
+		if ((values->present & PARAM_BIT(summary_numbers[i].field)) == 0)
+		{
+			continue;
+		}
+
+		switch (summary_numbers[i].field)
+		{
+			case PARAM_STEPS:
+				val = values->steps;
+				break;
+			case PARAM_CFG:
+				val = values->cfg;
+				break;
+			case PARAM_WIDTH:
+				val = values->width;
+				break;
+			case PARAM_HEIGHT: /* fallthrough */
+			default:
+				val = values->height;
+				break;
+		}
+
+		stats->min = ((stats->count == 0) || (val < stats->min))
+			? val : stats->min;
+		stats->max = ((stats->count == 0) || (val > stats->max))
+			? val : stats->max;
+		stats->sum += val;
+		stats->count++;
+
+		bucket = val / summary_numbers[i].width;
+		stats->buckets[(bucket < 0) ? 0 : (bucket >= SUMMARY_BUCKETS - 1)
+			? SUMMARY_BUCKETS - 1 : (size_t) bucket]++;
+	}
+
+	sum->num_images++;
+}
+
+static void summaryPrintStats(const struct summaryStats *stats,
+	const size_t number, FILE *out)
+{
+	const double width = summary_numbers[number].width;
+	uint64_t most = 0;
+	size_t i, first = SUMMARY_BUCKETS, last = 0;
+
+	fprintf(out, "%-8s %llu values", summary_numbers[number].name,
+		(unsigned long long) stats->count);
+
+	if (stats->count == 0)
+	{
+		fputc('\n', out);
+
+		return;
+	}
+
+	fprintf(out, ", min %.15g, max %.15g, mean %.4g\n", stats->min,
+		stats->max, stats->sum / (double) stats->count);
+
+	for (i = 0; i < SUMMARY_BUCKETS; i++)
+	{
+		if (stats->buckets[i] != 0)
+		{
+			first = (first == SUMMARY_BUCKETS) ? i : first;
+			last  = i;
+			most  = (stats->buckets[i] > most)
+				? stats->buckets[i] : most;
+		}
+	}
+
+	/* Empty buckets at either end aren't worth a line */
+	for (i = first; i <= last; i++)
+	{
+		char range[32];
+		size_t bar = (size_t) (stats->buckets[i] * SUMMARY_BAR_LEN
+			/ most);
+
+		if (i == SUMMARY_BUCKETS - 1)
+		{
+			sprintf(range, "%g+", width * (double) i);
+		}
+		else
+		{
+			sprintf(range, "%g-%g", width * (double) i,
+				width * (double) (i + 1));
+		}
+
+		fprintf(out, "  %-11s %10llu  ", range,
+			(unsigned long long) stats->buckets[i]);
+
+		for (; bar != 0; bar--)
+		{
+			fputc('#', out);
+		}
+
+		fputc('\n', out);
+	}
+}
+
+static int summaryPrintCounts(const struct summaryCounts *cat,
+	const size_t category, FILE *out)
+{
+	const uint32_t num_ids = cat->pool.len;
+	uint64_t *counts = NULL;
+	size_t k;
+
+	fprintf(out, "\n%s: %lu distinct\n", summary_categories[category].name,
+		(unsigned long) num_ids);
+
+	if (num_ids == 0)
+	{
+		return 0;
+	}
+
+	if ((counts = malloc(sizeof(uint64_t) * num_ids)) == NULL)
+	{
+		return 1;
+	}
+
+	memcpy(counts, cat->counts, sizeof(uint64_t) * num_ids);
+
+	/* Only the top few are wanted so picking them out one at a time
+	 * beats sorting them all */
+	for (k = 0; k < SUMMARY_TOP_MAX; k++)
+	{
+		uint32_t id, best = 0;
+		const char *str;
+		size_t len;
+
+		for (id = 1; id < num_ids; id++)
+		{
+			best = (counts[id] > counts[best]) ? id : best;
+		}
+
+		if (counts[best] == 0)
+		{
+			break;
+		}
+
+		str = internGet(&cat->pool, best, &len);
+		fprintf(out, "%10llu  %.*s\n", (unsigned long long) counts[best],
+			(str == NULL) ? 0 : (int) len, (str == NULL) ? "" : str);
+		counts[best] = 0;
+	}
+
+	free(counts);
+
+	return 0;
+}
+
+void summaryPrint(const struct summary *sum, FILE *out)
+{
+	size_t i;
+
+	fprintf(out, "Images: %llu\n\n", (unsigned long long) sum->num_images);
+
+	for (i = 0; i < SUMMARY_NUM_NUMBERS; i++)
+	{
+		summaryPrintStats(&sum->numbers[i], i, out);
+	}
+
+	for (i = 0; i < SUMMARY_NUM_CATEGORIES; i++)
+	{
+		if (summaryPrintCounts(&sum->categories[i], i, out) != 0)
+		{
+			fprintf(stderr, "Unable to list %s counts\n",
+				summary_categories[i].name);
+		}
+	}
+}
+
+void summaryFree(struct summary *sum)
+{
+	size_t i;
+
+	if (sum == NULL)
+	{
+		return;
+	}
+
+	for (i = 0; i < SUMMARY_NUM_CATEGORIES; i++)
+	{
+		internFree(&sum->categories[i].pool);
+		free(sum->categories[i].counts);
+	}
+
+	memset(sum, 0, sizeof(struct summary));
+}
@@ -0,0 +1,69 @@
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "internPool.h"
+#include "paramValues.h"
+
+/* Running totals over a whole library of images, nothing is kept per image
+ * so memory only grows with the number of distinct models, samplers, and
+ * RNGs seen rather than with the number of files */
+
+/* Fixed width buckets per numeric setting, the last one is open ended */
+#define SUMMARY_BUCKETS  16
+#define SUMMARY_BAR_LEN  40
+/* Categories listed per key, the rest are only counted */
+#define SUMMARY_TOP_MAX  10
+
+enum summaryNumber
+{
+	SUMMARY_STEPS = 0,
+	SUMMARY_CFG,
+	SUMMARY_WIDTH,
+	SUMMARY_HEIGHT,
+	SUMMARY_NUM_NUMBERS
+};
+
+enum summaryCategory
+{
+	SUMMARY_MODEL = 0,
+	SUMMARY_SAMPLER,
+	SUMMARY_RNG,
+	SUMMARY_NUM_CATEGORIES
+};
+
+struct summaryStats
+{
+	uint64_t count;
+	double min;
+	double max;
+	double sum;
+	uint64_t buckets[SUMMARY_BUCKETS];
+};
+
+/* Counts are indexed by pool id */
+struct summaryCounts
+{
+	struct internPool pool;
+	uint64_t *counts;
+	size_t cap;
+};
+
+/* A zeroed summary is ready for use */
+struct summary
+{
+	uint64_t num_images;
+	struct summaryStats numbers[SUMMARY_NUM_NUMBERS];
+	struct summaryCounts categories[SUMMARY_NUM_CATEGORIES];
+};
+
+int summaryField(struct summary *sum, const char *label, const char *value,
+	size_t len);
+void summaryValues(struct summary *sum, const struct paramValues *values);
+void summaryPrint(const struct summary *sum, FILE *out);
+void summaryFree(struct summary *sum);
+
+#endif /* SUMMARY_H */
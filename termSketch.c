@@ -0,0 +1,372 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "stiTokenizer.h"
+#include "paramValues.h"
+#include "termSketch.h"
+
+#define TERM_DELIMS ", \t\r\n"
+
+/* FNV-1a */
+static size_t termHash(const char *str, const size_t len)
+{
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		hash = (hash ^ (unsigned char) str[i]) * 16777619u;
+	}
+
+	return hash;
+}
+
+static int termIsOpen(const char ch)
+{
+	return ((ch == '(') || (ch == '[') || (ch == '{') || (ch == '<'));
+}
+
+static int termIsClose(const char ch)
+{
+	return ((ch == ')') || (ch == ']') || (ch == '}') || (ch == '>'));
+}
+
+/* "((Red Hat:1.2))" and "red hat" are the same term, blanks and brackets are
+ * peeled off both ends and a trailing numeric weight dropped until nothing
+ * changes, dst needs TERM_MAX bytes and 0 means there was no term at all */
+size_t termNormalize(const char *src, size_t len, char *dst)
+{
+	size_t i, old_len;
+	float weight;
+
+	do
+	{
+		old_len = len;
+		src = paramTrim(src, &len);
+
+		for (; (len != 0) && (termIsOpen(*src) != 0); src++, len--);
+		for (; (len != 0) && (termIsClose(src[len - 1]) != 0); len--);
+
+		for (i = len; (i != 0) && (src[i - 1] != ':'); i--);
+
+		if ((i != 0)
+		&& (paramParseFloat(src + i, len - i, &weight) == 0))
+		{
+			len = i - 1;
+		}
+
+		for (; (len != 0) && (src[len - 1] == ':'); len--);
+	} while (len != old_len);
+
+	/* A weight split off from its term by a space isn't a term */
+	if ((len == 0) || (paramParseFloat(src, len, &weight) == 0))
+	{
+		return 0;
+	}
+
+	if (len > TERM_MAX - 1)
+	{
+		len = TERM_MAX - 1;
+	}
+
+	for (i = 0; i < len; i++)
+	{
+		dst[i] = ((src[i] >= 'A') && (src[i] <= 'Z'))
+			? (char) (src[i] - 'A' + 'a') : src[i];
+	}
+
+	dst[len] = '\0';
+
+	return len;
+}
+
+int termSketchInit(struct termSketch *sketch, const size_t top_k)
+{
+	memset(sketch, 0, sizeof(struct termSketch));
+
+	sketch->top_k = top_k;
+	sketch->num_counters = (top_k > TERM_SKETCH_MIN / TERM_SKETCH_FACTOR)
+		? top_k * TERM_SKETCH_FACTOR : TERM_SKETCH_MIN;
+
+	/* Kept at most half full */
+	for (sketch->num_slots = 1;
+		sketch->num_slots < sketch->num_counters << 1;
+		sketch->num_slots <<= 1);
+
+	if (((sketch->counters = malloc(sizeof(struct termCounter)
+		* sketch->num_counters)) == NULL)
+	|| ((sketch->heap = malloc(sizeof(size_t) * sketch->num_counters))
+		== NULL)
+	|| ((sketch->slots = calloc(sketch->num_slots, sizeof(size_t)))
+		== NULL))
+	{
+		termSketchFree(sketch);
+
+		return 1;
+	}
+
+	return 0;
+}
+
+static void termHeapSwap(struct termSketch *sketch, const size_t a,
+	const size_t b)
+{
+	const size_t tmp = sketch->heap[a];
+
+	sketch->heap[a] = sketch->heap[b];
+	sketch->heap[b] = tmp;
+	sketch->counters[sketch->heap[a]].heap_pos = a;
+	sketch->counters[sketch->heap[b]].heap_pos = b;
+}
+
+/* Counts only ever go up so a counter only ever needs to move down */
+static void termHeapDown(struct termSketch *sketch, size_t pos)
+{
+	for (;;)
+	{
+		const size_t left = (pos << 1) + 1;
+		size_t least = pos;
+
+		if ((left < sketch->len)
+		&& (sketch->counters[sketch->heap[left]].count
+			< sketch->counters[sketch->heap[least]].count))
+		{
+			least = left;
+		}
+
+		if ((left + 1 < sketch->len)
+		&& (sketch->counters[sketch->heap[left + 1]].count
+			< sketch->counters[sketch->heap[least]].count))
+		{
+			least = left + 1;
+		}
+
+		if (least == pos)
+		{
+			return;
+		}
+
+		termHeapSwap(sketch, pos, least);
+		pos = least;
+	}
+}
+
+static void termHeapUp(struct termSketch *sketch, size_t pos)
+{
+	while ((pos != 0)
+	&& (sketch->counters[sketch->heap[pos]].count
+		< sketch->counters[sketch->heap[(pos - 1) >> 1]].count))
+	{
+		termHeapSwap(sketch, pos, (pos - 1) >> 1);
+		pos = (pos - 1) >> 1;
+	}
+}
+
+static size_t termFindSlot(const struct termSketch *sketch,
+	const char *term, const size_t len)
+{
+	const size_t mask = sketch->num_slots - 1;
+	size_t slot = termHash(term, len) & mask;
+
+	for (; sketch->slots[slot] != 0; slot = (slot + 1) & mask)
+	{
+		const char *other 
+			= sketch->counters[sketch->slots[slot] - 1].term;
+
+		if ((strncmp(other, term, len) == 0) && (other[len] == '\0'))
+		{
+			break;
+		}
+	}
+
+	return slot;
+}
+
+/* Backward shift deletion, leaves no tombstones behind for the probes */
+static void termRemoveSlot(struct termSketch *sketch, size_t slot)
+{
+	const size_t mask = sketch->num_slots - 1;
+	size_t next = (slot + 1) & mask;
+
+	sketch->slots[slot] = 0;
+
+	for (; sketch->slots[next] != 0; next = (next + 1) & mask)
+	{
+		const char *term 
+			= sketch->counters[sketch->slots[next] - 1].term;
+		const size_t home = termHash(term, strlen(term)) & mask;
+
+		/* Moves back only if its home isn't in the gap it'd jump */
+		if (((next - home) & mask) >= ((next - slot) & mask))
+		{
+			sketch->slots[slot] = sketch->slots[next];
+			sketch->slots[next] = 0;
+			slot = next;
+		}
+	}
+}
+
+/* Counts one already normalized term */
+int termSketchAdd(struct termSketch *sketch, const char *term, size_t len)
+{
+	struct termCounter *counter = NULL;
+	size_t slot, index;
+
+	if ((sketch == NULL) || (sketch->counters == NULL) || (term == NULL))
+	{
+		return 1;
+	}
+
+	len = (len > TERM_MAX - 1) ? TERM_MAX - 1 : len;
+	sketch->num_terms++;
+
+	if (sketch->slots[slot = termFindSlot(sketch, term, len)] != 0)
+	{
+		counter = &sketch->counters[sketch->slots[slot] - 1];
+		counter->count++;
+		termHeapDown(sketch, counter->heap_pos);
+
+		return 0;
+	}
+
+	if (sketch->len < sketch->num_counters)
+	{
+		index = sketch->len;
+		counter = &sketch->counters[index];
+		counter->count = 0;
+		counter->heap_pos = sketch->len;
+		sketch->heap[sketch->len++] = index;
+	}
+	else /* The least counted term gives up its counter */
+	{
+		index = sketch->heap[0];
+		counter = &sketch->counters[index];
+		termRemoveSlot(sketch, termFindSlot(sketch, counter->term,
+			strlen(counter->term)));
+		slot = termFindSlot(sketch, term, len);
+	}
+
+	memcpy(counter->term, term, len);
+	counter->term[len] = '\0';
+	counter->error = counter->count;
+	counter->count++;
+	sketch->slots[slot] = index + 1;
+	termHeapUp(sketch, counter->heap_pos);
+	termHeapDown(sketch, counter->heap_pos);
+
+	return 0;
+}
+
+/* Splits a prompt on commas and whitespace and counts every term in it */
+int termSketchPrompt(struct termSketch *sketch, const char *prompt,
+	const size_t len)
+{
+	struct stiToken *tokens = NULL;
+	size_t i, num_tokens = 0;
+	int ret = 0;
+
+	if ((tokens = stiNewTokenStack(prompt, len, GO_TILL_LEN, TERM_DELIMS,
+		&num_tokens)) == NULL)
+	{
+		return (len != 0);
+	}
+
+	for (i = 0; (i < num_tokens) && (ret == 0); i++)
+	{
+		char term[TERM_MAX];
+		const size_t term_len = termNormalize(
+			prompt + tokens[i].token_start,
+			tokens[i].token_end - tokens[i].token_start, term);
+
+		if (term_len != 0)
+		{
+			ret = termSketchAdd(sketch, term, term_len);
+		}
+	}
+
+	free(tokens);
+
+	return ret;
+}
+
+static int termCounterCmp(const void *left, const void *right)
+{
+	const struct termCounter *l 
+		= *(const struct termCounter * const *) left;
+	const struct termCounter *r
+		= *(const struct termCounter * const *) right;
+
+	if (l->count != r->count)
+	{
+		return (l->count > r->count) ? -1 : 1;
+	}
+
+	return strcmp(l->term, r->term);
+}
+
+/* Each count is followed by how far it may be over, a term is certainly in
+ * the top K when even its lowest possible count beats the highest possible
+ * count of the first term left out, the rest are marked with a '?' */
+int termSketchPrint(const struct termSketch *sketch, FILE *out)
+{
+	const struct termCounter **sorted = NULL;
+	const size_t num_shown = (sketch->top_k < sketch->len)
+		? sketch->top_k : sketch->len;
+	uint64_t cutoff;
+	size_t i;
+
+	if ((sketch->len != 0)
+	&& ((sorted = malloc(sizeof(struct termCounter*) * sketch->len))
+		== NULL))
+	{
+		return 1;
+	}
+
+	for (i = 0; i < sketch->len; i++)
+	{
+		sorted[i] = &sketch->counters[i];
+	}
+
+	if (sketch->len != 0)
+	{
+		qsort(sorted, sketch->len, sizeof(struct termCounter*),
+			termCounterCmp);
+	}
+
+	cutoff = (num_shown < sketch->len) ? sorted[num_shown]->count : 0;
+
+	fprintf(out, "Terms: %llu, counts are over by at most %llu\n\n",
+		(unsigned long long) sketch->num_terms,
+		(unsigned long long) ((sketch->len < sketch->num_counters) ? 0
+		: sketch->counters[sketch->heap[0]].count));
+
+	for (i = 0; i < num_shown; i++)
+	{
+		const struct termCounter *counter = sorted[i];
+
+		fprintf(out, "%10llu  -%-8llu %c %s\n",
+			(unsigned long long) counter->count,
+			(unsigned long long) counter->error,
+			(counter->count - counter->error >= cutoff) ? ' ' : '?',
+			counter->term);
+	}
+
+	free(sorted);
+
+	return 0;
+}
+
+void termSketchFree(struct termSketch *sketch)
+{
+	if (sketch == NULL)
+	{
+		return;
+	}
+
+	free(sketch->counters);
+	free(sketch->heap);
+	free(sketch->slots);
+	memset(sketch, 0, sizeof(struct termSketch));
+}
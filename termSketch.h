@@ -0,0 +1,48 @@
+#ifndef TERM_SKETCH_H
+#define TERM_SKETCH_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Space-Saving sketch of the most common prompt terms. Only a fixed number
+ * of counters are ever kept, when a new term turns up and they're all in
+ * use it takes over the smallest one and inherits its count as an error.
+ * A term's true count is somewhere between count - error and count, and
+ * no error is ever more than terms seen / counters kept */
+
+/* Counters kept per term asked for, more makes the top K more exact */
+#define TERM_SKETCH_FACTOR 8
+#define TERM_SKETCH_MIN    64
+/* Longer terms are cut short, they're rarely tags anyway */
+#define TERM_MAX           48
+
+struct termCounter
+{
+	char term[TERM_MAX];
+	uint64_t count;
+	uint64_t error;
+	size_t heap_pos;
+};
+
+struct termSketch
+{
+	struct termCounter *counters;
+	size_t num_counters;
+	size_t len;
+	size_t top_k;
+	size_t *heap;  /* Counter indices, smallest count first */
+	size_t *slots; /* Counter index + 1, 0 for an empty slot */
+	size_t num_slots;
+	uint64_t num_terms;
+};
+
+size_t termNormalize(const char *src, size_t len, char *dst);
+int termSketchInit(struct termSketch *sketch, const size_t top_k);
+int termSketchAdd(struct termSketch *sketch, const char *term, size_t len);
+int termSketchPrompt(struct termSketch *sketch, const char *prompt,
+	const size_t len);
+int termSketchPrint(const struct termSketch *sketch, FILE *out);
+void termSketchFree(struct termSketch *sketch);
+
+#endif /* TERM_SKETCH_H */
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../scriptOutput.h"
+
+/* Invocations differing only in seed, with seeds that don't line up, have
+ * to become a loop that still writes one file per seed. The names have no
+ * extension so the seed goes on the end, which has to be outside the name's
+ * quotes whichever style they're in. The model comes after the seed, as it
+ * does in a real invocation, and has to be found again once the loop's 
+ * prefix pushes it further along than the output splice */
+
+#define SEED_LOOP_LEN 40
+
+struct seedLoopCase
+{
+	const char *name;   /* As queueInvocation writes it */
+	const char *expect; /* The loop's --output value */
+};
+
+static int addCommand(struct scriptBatch *batch, const char *path,
+	const char *seed, const char *name)
+{
+	static const char model[] = "m";
+	struct scriptSpan keys[SCRIPT_NUM_KEYS] = {{0, 0}};
+	struct scriptSpan seed_span, output_span;
+	const size_t len = strlen(seed) + strlen(name) + 64;
+	char *command = malloc(len);
+
+	if (command == NULL)
+	{
+		return 1;
+	}
+
+	strcpy(command, "sd --prompt 'a cat' --seed ");
+	seed_span.start = strlen(command);
+	seed_span.len = strlen(seed);
+	strcat(command, seed);
+	strcat(command, " --model ");
+	keys[SCRIPT_KEY_MODEL].start = strlen(command);
+	keys[SCRIPT_KEY_MODEL].len = strlen(model);
+	strcat(command, model);
+	strcat(command, " --output ");
+	output_span.start = strlen(command);
+	output_span.len = strlen(name);
+	strcat(command, name);
+	strcat(command, "\n");
+
+	if (scriptBatchAdd(batch, path, command, strlen(command), keys,
+		&seed_span, &output_span, NULL) != 0)
+	{
+		free(command);
+
+		return 1;
+	}
+
+	return 0;
+}
+
+static int runCase(const struct seedLoopCase *test)
+{
+	struct scriptBatch batch = {0};
+	struct scriptSpan model;
+	char line[1024];
+	FILE *fhandle = NULL;
+	size_t i;
+	int ret = 1;
+
+	for (i = 0; i < SEED_LOOP_LEN; i++)
+	{
+		char seed[32];
+
+		sprintf(seed, "%lu", (unsigned long) (5 + i * 4));
+
+		if (addCommand(&batch, "noext", seed, test->name) != 0)
+		{
+			scriptBatchFree(&batch);
+
+			return 1;
+		}
+	}
+
+	if ((scriptBatchCollapseSeeds(&batch, 0) != 0) || (batch.len != 1) 
+	|| ((fhandle = tmpfile()) == NULL))
+	{
+		fprintf(stderr, "%s: Unable to collapse\n", test->name);
+		scriptBatchFree(&batch);
+
+		return 1;
+	}
+
+	model = batch.entries[0].keys[SCRIPT_KEY_MODEL];
+
+	if ((model.start + model.len > batch.entries[0].command_len)
+	|| (model.len != 1) || (batch.entries[0].command[model.start] != 'm'))
+	{
+		fprintf(stderr, "%s: Lost track of the model\n", test->name);
+		fclose(fhandle);
+		scriptBatchFree(&batch);
+
+		return 1;
+	}
+
+	scriptBatchPrint(&batch, fhandle);
+	rewind(fhandle);
+
+	while (fgets(line, sizeof(line), fhandle) != NULL)
+	{
+		const char *output = strstr(line, "--output ");
+
+		if (output != NULL)
+		{
+			output += strlen("--output ");
+			line[strcspn(line, "\n")] = '\0';
+			ret = (strcmp(output, test->expect) != 0);
+
+			if (ret != 0)
+			{
+				fprintf(stderr, "%s: Got %s, expected %s\n",
+					test->name, output, test->expect);
+			}
+		}
+	}
+
+	fclose(fhandle);
+	scriptBatchFree(&batch);
+
+	return ret;
+}
+
+int main(void)
+{
+	static const struct seedLoopCase cases[] =
+	{
+		{"\"$SDPD_OUT_DIR\"/'noext'",
+			"\"$SDPD_OUT_DIR\"/'noext'_${seed}''"},
+		{"\"$SDPD_OUT_DIR\"/\"noext\"",
+			"\"$SDPD_OUT_DIR\"/\"noext\"_${seed}\"\""},
+		{"\"$SDPD_OUT_DIR\"/'a.png'",
+			"\"$SDPD_OUT_DIR\"/'a'_${seed}'.png'"}
+	};
+	size_t i;
+	int ret = 0;
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		ret |= runCase(&cases[i]);
+	}
+
+	return ret;
+}
@@ -0,0 +1,217 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else  /* POSIX */
+#include <time.h>
+#endif /* Platform Check */
+
+#include "traceEvents.h"
+
+struct traceEvent
+{
+	const char *file;
+	uint64_t begin; /* Nanoseconds since traceStart */
+	uint64_t end;
+	enum traceStage stage;
+};
+
+static const char *const trace_names[TRACE_NUM_STAGES] =
+{
+	"file", "open", "validate", "chunk search", "read", "tokenize", 
+	"format", "write"
+};
+
+static struct
+{
+	char *path;
+	struct traceEvent *ring;
+	uint64_t len;   /* Every span ever added, the ring keeps the last ones */
+	uint64_t epoch;
+	size_t worker;
+	const char *file;
+} trace_state = {NULL, NULL, 0, 0, 0, NULL};
+
+static uint64_t traceClock(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER now, freq;
+
+	QueryPerformanceCounter(&now);
+	QueryPerformanceFrequency(&freq);
+
+	return (uint64_t) ((double) now.QuadPart * 1e9 
+		/ (double) freq.QuadPart);
+#else  /* POSIX */
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000000000ull 
+		+ (uint64_t) now.tv_nsec;
+#endif /* Platform Check */
+}
+
+/* The worker becomes the trace's process id so the traces of several 
+ * shards can be told apart when opened together */
+int traceStart(const char *path, const size_t worker)
+{
+	const size_t len = strlen(path) + 1;
+
+	if (((trace_state.ring = malloc(sizeof(struct traceEvent) 
+		* TRACE_RING_LEN)) == NULL)
+	|| ((trace_state.path = malloc(len)) == NULL))
+	{
+		free(trace_state.ring);
+		trace_state.ring = NULL;
+
+		return 1;
+	}
+
+	memcpy(trace_state.path, path, len);
+	trace_state.len    = 0;
+	trace_state.worker = worker;
+	trace_state.file   = NULL;
+	trace_state.epoch  = traceClock();
+
+	return 0;
+}
+
+/* Never 0 while tracing, the clock is read after the epoch */
+uint64_t traceNow(void)
+{
+	return (trace_state.ring == NULL) 
+		? 0 : traceClock() - trace_state.epoch + 1;
+}
+
+/* The file later spans are about, it has to outlive the trace */
+void traceFile(const char *file)
+{
+	trace_state.file = file;
+}
+
+void traceSpan(const enum traceStage stage, const uint64_t begin)
+{
+	struct traceEvent *event;
+
+	if ((trace_state.ring == NULL) || (begin == 0))
+	{
+		return;
+	}
+
+	event = &trace_state.ring[trace_state.len++ % TRACE_RING_LEN];
+	event->file  = trace_state.file;
+	event->begin = begin - 1;
+	event->end   = traceNow() - 1;
+	event->stage = stage;
+}
+
+static void traceString(FILE *fhandle, const char *str)
+{
+	fputc('"', fhandle);
+
+	for (; *str != '\0'; str++)
+	{
+		if ((*str == '"') || (*str == '\\'))
+		{
+			fputc('\\', fhandle);
+			fputc(*str, fhandle);
+		}
+		else if ((unsigned char) *str < 0x20)
+		{
+			fprintf(fhandle, "\\u%04x", (unsigned char) *str);
+		}
+		else
+		{
+			fputc(*str, fhandle);
+		}
+	}
+
+	fputc('"', fhandle);
+}
+
+/* Timestamps are in microseconds as the format wants, kept fractional so
+ * short stages don't all round to nothing */
+int traceFinish(void)
+{
+	const uint64_t first = (trace_state.len > TRACE_RING_LEN)
+		? trace_state.len - TRACE_RING_LEN : 0;
+	const unsigned long pid = (unsigned long) trace_state.worker + 1;
+	FILE *fhandle = NULL;
+	uint64_t i;
+	int ret;
+
+	if (trace_state.ring == NULL)
+	{
+		return 0;
+	}
+
+	if ((fhandle = fopen(trace_state.path, "wb")) == NULL)
+	{
+		fprintf(stderr, "Unable to open %s for writing\n", 
+			trace_state.path);
+		ret = 1;
+	}
+	else
+	{
+		fprintf(fhandle, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":"
+			"[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%lu,"
+			"\"tid\":1,\"args\":{\"name\":\"sdPromptDumper %lu\"}},"
+			"\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%lu,"
+			"\"tid\":1,\"args\":{\"name\":\"scan\"}}", pid, 
+			(unsigned long) trace_state.worker, pid);
+
+		for (i = first; i < trace_state.len; i++)
+		{
+			const struct traceEvent *event 
+				= &trace_state.ring[i % TRACE_RING_LEN];
+
+			fprintf(fhandle, ",\n{\"name\":\"%s\",\"cat\":\"scan\","
+				"\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+				"\"pid\":%lu,\"tid\":1", 
+				trace_names[event->stage], 
+				(double) event->begin / 1000.0,
+				(double) (event->end - event->begin) / 1000.0,
+				pid);
+
+			if (event->file != NULL)
+			{
+				fputs(",\"args\":{\"file\":", fhandle);
+				traceString(fhandle, event->file);
+				fputc('}', fhandle);
+			}
+
+			fputc('}', fhandle);
+		}
+
+		fputs("\n]}\n", fhandle);
+		ret = (fclose(fhandle) != 0);
+
+		if (ret != 0)
+		{
+			fprintf(stderr, "Error finishing %s\n", 
+				trace_state.path);
+		}
+	}
+
+	if (first != 0)
+	{
+		fprintf(stderr, "Trace only kept the last %lu of %llu spans\n",
+			(unsigned long) TRACE_RING_LEN, 
+			(unsigned long long) trace_state.len);
+	}
+
+	free(trace_state.ring);
+	free(trace_state.path);
+	trace_state.ring = NULL;
+	trace_state.path = NULL;
+
+	return ret;
+}
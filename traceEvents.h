@@ -0,0 +1,35 @@
+#ifndef TRACE_EVENTS_H
+#define TRACE_EVENTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Optional timeline of where each file's time goes, written out at exit in
+ * Chrome's trace event JSON so it can be opened in Perfetto or 
+ * chrome://tracing. Spans go into a fixed ring that overwrites the oldest
+ * once full, so tracing a huge scan never grows without bound, and nothing
+ * is formatted until the end. When tracing is off traceNow is 0 and every
+ * call returns straight away */
+
+#define TRACE_RING_LEN ((size_t) 1 << 17)
+
+enum traceStage
+{
+	TRACE_FILE = 0, /* The whole file, the rest nest inside it */
+	TRACE_OPEN,
+	TRACE_VALIDATE,
+	TRACE_CHUNKS,
+	TRACE_READ,
+	TRACE_TOKENIZE,
+	TRACE_FORMAT,
+	TRACE_WRITE,
+	TRACE_NUM_STAGES
+};
+
+int traceStart(const char *path, const size_t worker);
+uint64_t traceNow(void);
+void traceFile(const char *file);
+void traceSpan(const enum traceStage stage, const uint64_t begin);
+int traceFinish(void);
+
+#endif /* TRACE_EVENTS_H */